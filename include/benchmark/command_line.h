@@ -0,0 +1,160 @@
+#ifndef BENCHMARK_COMMAND_LINE_H
+#define BENCHMARK_COMMAND_LINE_H
+
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/*
+ * The command line and the CSV output shared by the standalone (ROS-free) benchmarks - the options are given as "--key value" pairs, and the results are printed as one CSV row per measurement
+ */
+
+namespace uvdar {
+  namespace benchmark {
+
+    /* CommandLine //{ */
+    /**
+     * @brief The "--key value" options of a tool. The options are taken out one by one, so that any left over are reported as unknown
+     */
+    class CommandLine {
+      public:
+
+        /**
+         * @brief The constructor of the class
+         *
+         * @param i_name The name prefixed to the error messages, e.g. "UVDARDetectorBenchmark"
+         * @param i_usage The description of the options, printed with -h, --help and on errors
+         */
+        CommandLine(const std::string& i_name, const std::string& i_usage) : name_(i_name), usage_(i_usage) {
+        }
+
+        /**
+         * @brief Splits the arguments into the options
+         *
+         * @return False if the usage was requested or an argument is not a "--key value" pair
+         */
+        bool parse(int argc, char** argv) {
+          for (int i = 1; i < argc; i++) {
+            std::string key = argv[i];
+            if ((key == "-h") || (key == "--help")) {
+              std::cout << usage_;
+              return false;
+            }
+            if ((key.rfind("--", 0) != 0) || ((i + 1) >= argc)) {
+              std::cerr << "[" << name_ << "]: Invalid argument " << key << "!" << std::endl;
+              std::cout << usage_;
+              return false;
+            }
+            values_[key.substr(2)] = argv[++i];
+          }
+          return true;
+        }
+
+        /**
+         * @brief Takes out the option of the given key, if it was given
+         *
+         * @param o_value Output - the value of the option, left unchanged if the option was not given. Strings are taken whole, other types are read by the stream operator
+         */
+        template <typename T>
+        void take(const std::string& key, T& o_value) {
+          auto it = values_.find(key);
+          if (it == values_.end()) {
+            return;
+          }
+          if constexpr (std::is_same<T, std::string>::value) {
+            o_value = it->second;
+          } else {
+            std::istringstream stream(it->second);
+            stream >> o_value;
+          }
+          values_.erase(it);
+        }
+
+        /**
+         * @brief Takes out the comma separated list of the given key, if it was given
+         *
+         * @param o_values Output - the values of the list, replacing the defaults. Left unchanged if the option was not given
+         */
+        template <typename T>
+        void takeList(const std::string& key, std::vector<T>& o_values) {
+          std::string list;
+          if (values_.count(key) == 0) {
+            return;
+          }
+          take(key, list);
+          o_values.clear();
+          std::istringstream stream(list);
+          std::string token;
+          while (std::getline(stream, token, ',')) {
+            T value;
+            std::istringstream(token) >> value;
+            o_values.push_back(value);
+          }
+        }
+
+        /**
+         * @brief Checks that all the given options were taken
+         *
+         * @return False if an unknown option was given
+         */
+        bool finish() const {
+          if (!values_.empty()) {
+            std::cerr << "[" << name_ << "]: Unknown option --" << values_.begin()->first << "!" << std::endl;
+            std::cout << usage_;
+            return false;
+          }
+          return true;
+        }
+
+        /**
+         * @brief Reports invalid options
+         *
+         * @return False, to be returned by the option parsing of the tool
+         */
+        bool fail(const std::string& i_message) const {
+          std::cerr << "[" << name_ << "]: " << i_message << std::endl;
+          return false;
+        }
+
+      private:
+        std::string name_;
+        std::string usage_;
+        std::map<std::string, std::string> values_;
+    };
+    //}
+
+    /* CsvWriter //{ */
+    /**
+     * @brief Prints the results as CSV - the header on construction, then one row per measurement
+     */
+    class CsvWriter {
+      public:
+        CsvWriter(std::ostream& i_out, const std::vector<std::string>& i_columns) : out_(i_out) {
+          for (size_t c = 0; c < i_columns.size(); c++) {
+            out_ << ((c > 0) ? "," : "") << i_columns[c];
+          }
+          out_ << std::endl;
+        }
+
+        /**
+         * @brief Prints a row - the values have to follow the order of the columns
+         */
+        template <typename... Values>
+        void row(const Values&... i_values) {
+          const char* separator = "";
+          ((out_ << separator << i_values, separator = ","), ...);
+          out_ << std::endl;
+        }
+
+      private:
+        std::ostream& out_;
+    };
+    //}
+
+  }
+}
+
+#endif  // BENCHMARK_COMMAND_LINE_H
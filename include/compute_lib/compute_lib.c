@@ -29,33 +29,164 @@ static void compute_lib_gl_callback(GLenum source, GLenum type, GLuint id, GLenu
     }
 }
 
-int compute_lib_init(compute_lib_instance_t* inst)
+static bool compute_lib_has_client_extension(const char* name)
 {
-    if (inst->initialised == true) {
-        return COMPUTE_LIB_ERROR_ALREADY_INITIALISED;
-    }
+    // client extensions are queried without a display, the query fails on EGL 1.4 without EGL_EXT_client_extensions
+    const char* egl_client_extension_st = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    return egl_client_extension_st != NULL && strstr(egl_client_extension_st, name) != NULL;
+}
 
-    inst->fd = open(COMPUTE_LIB_GPU_DRI_PATH, O_RDWR);
+static int compute_lib_open_gbm_display(compute_lib_instance_t* inst)
+{
+    const char* path = (inst->device_path != NULL) ? inst->device_path : COMPUTE_LIB_GPU_DRI_PATH;
+    inst->fd = open(path, O_RDWR);
     if (inst->fd <= 0) {
-        compute_lib_deinit(inst);
         return COMPUTE_LIB_ERROR_GPU_DRI_PATH;
     }
 
     inst->gbm = gbm_create_device(inst->fd);
     if (inst->gbm == NULL) {
-        compute_lib_deinit(inst);
         return COMPUTE_LIB_ERROR_CREATE_GBM_CTX;
     }
 
     inst->dpy = eglGetPlatformDisplay(EGL_PLATFORM_GBM_MESA, inst->gbm, NULL);
     if (inst->dpy == NULL) {
-        compute_lib_deinit(inst);
         return COMPUTE_LIB_ERROR_EGL_PLATFORM_DISPLAY;
     }
+    return COMPUTE_LIB_ERROR_NO_ERROR;
+}
+
+static int compute_lib_open_device_display(compute_lib_instance_t* inst)
+{
+    if (!compute_lib_has_client_extension("EGL_EXT_device_enumeration") || !compute_lib_has_client_extension("EGL_EXT_platform_device")) {
+        return COMPUTE_LIB_ERROR_EGL_EXTENSION_PLATFORM;
+    }
+
+    PFNEGLQUERYDEVICESEXTPROC query_devices = (PFNEGLQUERYDEVICESEXTPROC) eglGetProcAddress("eglQueryDevicesEXT");
+    PFNEGLQUERYDEVICESTRINGEXTPROC query_device_string = (PFNEGLQUERYDEVICESTRINGEXTPROC) eglGetProcAddress("eglQueryDeviceStringEXT");
+    if (query_devices == NULL || query_device_string == NULL) {
+        return COMPUTE_LIB_ERROR_EGL_EXTENSION_PLATFORM;
+    }
+
+    EGLDeviceEXT devices[16];
+    EGLint device_cnt = 0;
+    if (!query_devices(16, devices, &device_cnt) || device_cnt <= 0) {
+        return COMPUTE_LIB_ERROR_EGL_NO_DEVICE;
+    }
+
+    // with a path, the device with that DRM (primary or render) node is used, otherwise the first DRM device, or the first device if none of them is one
+    EGLDeviceEXT selected = EGL_NO_DEVICE_EXT;
+    for (EGLint i = 0; i < device_cnt && selected == EGL_NO_DEVICE_EXT; i++) {
+        const char* device_extension_st = query_device_string(devices[i], EGL_EXTENSIONS);
+        if (device_extension_st == NULL || strstr(device_extension_st, "EGL_EXT_device_drm") == NULL) {
+            continue;
+        }
+        const char* drm_file = query_device_string(devices[i], EGL_DRM_DEVICE_FILE_EXT);
+        const char* render_file = NULL;
+#ifdef EGL_DRM_RENDER_NODE_FILE_EXT
+        if (strstr(device_extension_st, "EGL_EXT_device_drm_render_node") != NULL) {
+            render_file = query_device_string(devices[i], EGL_DRM_RENDER_NODE_FILE_EXT);
+        }
+#endif
+        if (inst->device_path == NULL || (drm_file != NULL && strcmp(drm_file, inst->device_path) == 0) || (render_file != NULL && strcmp(render_file, inst->device_path) == 0)) {
+            selected = devices[i];
+        }
+    }
+    if (selected == EGL_NO_DEVICE_EXT && inst->device_path == NULL) {
+        selected = devices[0];
+    }
+    if (selected == EGL_NO_DEVICE_EXT) {
+        return COMPUTE_LIB_ERROR_EGL_NO_DEVICE;
+    }
+
+    inst->dpy = eglGetPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, selected, NULL);
+    if (inst->dpy == NULL) {
+        return COMPUTE_LIB_ERROR_EGL_PLATFORM_DISPLAY;
+    }
+    return COMPUTE_LIB_ERROR_NO_ERROR;
+}
+
+static int compute_lib_open_surfaceless_display(compute_lib_instance_t* inst)
+{
+    if (!compute_lib_has_client_extension("EGL_MESA_platform_surfaceless")) {
+        return COMPUTE_LIB_ERROR_EGL_EXTENSION_PLATFORM;
+    }
+
+    inst->dpy = eglGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (inst->dpy == NULL) {
+        return COMPUTE_LIB_ERROR_EGL_PLATFORM_DISPLAY;
+    }
+    return COMPUTE_LIB_ERROR_NO_ERROR;
+}
+
+static int compute_lib_open_display(compute_lib_instance_t* inst, compute_lib_platform_t platform)
+{
+    int code;
+    switch (platform) {
+        case COMPUTE_LIB_PLATFORM_GBM:
+            code = compute_lib_open_gbm_display(inst);
+            break;
+        case COMPUTE_LIB_PLATFORM_DEVICE:
+            code = compute_lib_open_device_display(inst);
+            break;
+        case COMPUTE_LIB_PLATFORM_SURFACELESS:
+            code = compute_lib_open_surfaceless_display(inst);
+            break;
+        default:
+            code = COMPUTE_LIB_ERROR_EGL_PLATFORM_DISPLAY;
+            break;
+    }
 
-    if (!eglInitialize(inst->dpy, NULL, NULL)) {
+    if (code == COMPUTE_LIB_ERROR_NO_ERROR && !eglInitialize(inst->dpy, NULL, NULL)) {
+        code = COMPUTE_LIB_ERROR_EGL_INIT;
+    }
+
+    if (code != COMPUTE_LIB_ERROR_NO_ERROR) {
+        // release the partially opened display, so that another platform can be tried
         compute_lib_deinit(inst);
-        return COMPUTE_LIB_ERROR_EGL_INIT;
+        return code;
+    }
+    inst->active_platform = platform;
+    return COMPUTE_LIB_ERROR_NO_ERROR;
+}
+
+const char* compute_lib_platform_name(compute_lib_platform_t platform)
+{
+    switch (platform) {
+        case COMPUTE_LIB_PLATFORM_GBM:
+            return "gbm";
+        case COMPUTE_LIB_PLATFORM_DEVICE:
+            return "device";
+        case COMPUTE_LIB_PLATFORM_SURFACELESS:
+            return "surfaceless";
+        case COMPUTE_LIB_PLATFORM_AUTO:
+            return "auto";
+        default:
+            return "unknown";
+    }
+}
+
+int compute_lib_init(compute_lib_instance_t* inst)
+{
+    if (inst->initialised == true) {
+        return COMPUTE_LIB_ERROR_ALREADY_INITIALISED;
+    }
+
+    int code;
+    if (inst->platform == COMPUTE_LIB_PLATFORM_AUTO) {
+        // the error of the GBM platform is reported if none of them works, as that is the one expected on a machine with a GPU
+        code = compute_lib_open_display(inst, COMPUTE_LIB_PLATFORM_GBM);
+        if (code != COMPUTE_LIB_ERROR_NO_ERROR && compute_lib_open_display(inst, COMPUTE_LIB_PLATFORM_DEVICE) == COMPUTE_LIB_ERROR_NO_ERROR) {
+            code = COMPUTE_LIB_ERROR_NO_ERROR;
+        }
+        if (code != COMPUTE_LIB_ERROR_NO_ERROR && compute_lib_open_display(inst, COMPUTE_LIB_PLATFORM_SURFACELESS) == COMPUTE_LIB_ERROR_NO_ERROR) {
+            code = COMPUTE_LIB_ERROR_NO_ERROR;
+        }
+    } else {
+        code = compute_lib_open_display(inst, inst->platform);
+    }
+    if (code != COMPUTE_LIB_ERROR_NO_ERROR) {
+        return code;
     }
 
     const char* egl_extension_st = eglQueryString(inst->dpy, EGL_EXTENSIONS);
@@ -68,12 +199,20 @@ int compute_lib_init(compute_lib_instance_t* inst)
         return COMPUTE_LIB_ERROR_EGL_EXTENSION_KHR_CTX;
     }
 
-    EGLConfig egl_cfg;
-    EGLint egl_count;
+    EGLConfig egl_cfg = EGL_NO_CONFIG_KHR;
+    EGLint egl_count = 0;
     if (!eglChooseConfig(inst->dpy, egl_config_attribs, &egl_cfg, 1, &egl_count)) {
         compute_lib_deinit(inst);
         return COMPUTE_LIB_ERROR_EGL_CONFIG;
     }
+    if (egl_count == 0) {
+        // surfaceless displays have no configs, the context is only used for compute so none is needed
+        if (strstr(egl_extension_st, "EGL_KHR_no_config_context") == NULL) {
+            compute_lib_deinit(inst);
+            return COMPUTE_LIB_ERROR_EGL_CONFIG;
+        }
+        egl_cfg = EGL_NO_CONFIG_KHR;
+    }
     if (!eglBindAPI(EGL_OPENGL_ES_API)) {
         compute_lib_deinit(inst);
         return COMPUTE_LIB_ERROR_EGL_BIND_API;
@@ -125,8 +264,11 @@ void compute_lib_deinit(compute_lib_instance_t* inst)
     }
     inst->fd = 0;
 
-    compute_lib_error_queue_flush(inst, NULL);
-    queue_delete(inst->error_queue);
+    if (inst->error_queue != NULL) {
+        compute_lib_error_queue_flush(inst, NULL);
+        queue_delete(inst->error_queue);
+    }
+    inst->error_queue = NULL;
 
     inst->initialised = false;
 }
@@ -160,7 +302,7 @@ void compute_lib_error_str(int err_code, char* target_str, int* len)
             *len += sprintf(target_str, "compute_lib_init error: already initialised!\r\n");
             break;
         case COMPUTE_LIB_ERROR_GPU_DRI_PATH:
-            *len += sprintf(target_str, "compute_lib_init error: could not open '%s'!\r\n", COMPUTE_LIB_GPU_DRI_PATH);
+            *len += sprintf(target_str, "compute_lib_init error: could not open the DRM device (default '%s')!\r\n", COMPUTE_LIB_GPU_DRI_PATH);
             break;
         case COMPUTE_LIB_ERROR_CREATE_GBM_CTX:
             *len += sprintf(target_str, "compute_lib_init: error: could not create GBM context!\r\n");
@@ -189,6 +331,12 @@ void compute_lib_error_str(int err_code, char* target_str, int* len)
         case COMPUTE_LIB_ERROR_EGL_MAKE_CURRENT:
             *len += sprintf(target_str, "compute_lib_init error: could not make current EGL context!\r\n");
             break;
+        case COMPUTE_LIB_ERROR_EGL_EXTENSION_PLATFORM:
+            *len += sprintf(target_str, "compute_lib_init error: the EGL platform is not supported (EGL_EXT_device_enumeration / EGL_EXT_platform_device / EGL_MESA_platform_surfaceless missing)!\r\n");
+            break;
+        case COMPUTE_LIB_ERROR_EGL_NO_DEVICE:
+            *len += sprintf(target_str, "compute_lib_init error: no matching EGL device found!\r\n");
+            break;
         case COMPUTE_LIB_ERROR_GROUP_GL_ERROR:
             *len += sprintf(target_str, "compute_lib error: occured at GL library, see inst->error_queue!\r\n");
             break;
@@ -388,6 +536,10 @@ bool compute_lib_image2d_init(compute_lib_program_t* program, compute_lib_image2
 {
     
     image2d->location = glGetUniformLocation(program->handle, image2d->uniform_name);
+    // the value of an image uniform is its image unit (set by layout(binding)) - the location only matches it while the images are the only uniforms of the program
+    GLint unit = 0;
+    glGetUniformiv(program->handle, image2d->location, &unit);
+    image2d->unit = unit;
     glGenTextures(1, &(image2d->handle));
     glActiveTexture(image2d->texture);
     glBindTexture(GL_TEXTURE_2D, image2d->handle);
@@ -397,7 +549,7 @@ bool compute_lib_image2d_init(compute_lib_program_t* program, compute_lib_image2
     glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, image2d->texture_filter);
     glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, image2d->texture_filter);
     glTexStorage2D(GL_TEXTURE_2D, 1, image2d->internal_format, image2d->width, image2d->height);
-    glBindImageTexture(image2d->location, image2d->handle, 0, GL_FALSE, 0, image2d->access, image2d->internal_format);
+    glBindImageTexture(image2d->unit, image2d->handle, 0, GL_FALSE, 0, image2d->access, image2d->internal_format);
     size_t type_size = gl32_get_type_size(image2d->type);
     uint32_t num_ch = gl32_get_image_format_num_components(image2d->format);
     image2d->px_size = type_size * num_ch;
@@ -469,6 +621,24 @@ bool compute_lib_image2d_write(compute_lib_program_t* program, compute_lib_image
     return compute_lib_gl_error_occured();
 }
 
+bool compute_lib_image2d_write_pbo(compute_lib_program_t* program, compute_lib_image2d_t* image2d, compute_lib_pbo_t* pbo)
+{
+    // the data are taken from the pixel buffer, so the call returns without waiting for the transfer
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo->handle);
+    glBindTexture(GL_TEXTURE_2D, image2d->handle);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image2d->width, image2d->height, image2d->format, image2d->type, (void*) 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    
+    return compute_lib_gl_error_occured();
+}
+
+bool compute_lib_image2d_bind(compute_lib_program_t* program, compute_lib_image2d_t* image2d)
+{
+    glBindImageTexture(image2d->unit, image2d->handle, 0, GL_FALSE, 0, image2d->access, image2d->internal_format);
+
+    return compute_lib_gl_error_occured();
+}
+
 bool compute_lib_image2d_read(compute_lib_program_t* program, compute_lib_image2d_t* image2d, void* image_data)
 {
     if (image2d->framebuffer != NULL) {
@@ -505,8 +675,15 @@ bool compute_lib_image2d_read_patch(compute_lib_program_t* program, compute_lib_
 bool compute_lib_acbo_init(compute_lib_program_t* program, compute_lib_acbo_t* acb, void* data, int len)
 {
      
+    GLenum buffer_index_prop = GL_ATOMIC_COUNTER_BUFFER_INDEX;
+    GLenum binding_prop = GL_BUFFER_BINDING;
+    GLint buffer_index = 0;
+
     glGenBuffers(1, &(acb->handle));
     acb->index = glGetProgramResourceIndex(program->handle, GL_UNIFORM, acb->name);
+    // the counter is bound by the binding point of its buffer - the resource index of the uniform changes with the other uniforms of the program
+    glGetProgramResourceiv(program->handle, GL_UNIFORM, acb->index, 1, &buffer_index_prop, sizeof(buffer_index), NULL, &buffer_index);
+    glGetProgramResourceiv(program->handle, GL_ATOMIC_COUNTER_BUFFER, buffer_index, 1, &binding_prop, sizeof(acb->binding), NULL, &(acb->binding));
     if (len > 0) compute_lib_acbo_write(program, acb, data, len);
     
     return compute_lib_gl_error_occured();
@@ -525,7 +702,7 @@ bool compute_lib_acbo_write(compute_lib_program_t* program, compute_lib_acbo_t*
      
     glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, acb->handle);
     glBufferData(GL_ATOMIC_COUNTER_BUFFER, gl32_get_type_size(acb->type)*len, data, acb->usage);
-    glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, acb->index, acb->handle);
+    glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, acb->binding, acb->handle);
     //glBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 0, gl32_get_type_size(acb->type)*len, data);
     
     return compute_lib_gl_error_occured();
@@ -596,6 +773,45 @@ bool compute_lib_ssbo_read(compute_lib_program_t* program, compute_lib_ssbo_t* s
     return compute_lib_gl_error_occured();
 }
 
+bool compute_lib_ssbo_bind(compute_lib_program_t* program, compute_lib_ssbo_t* ssbo)
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ssbo->binding, ssbo->handle);
+    
+    return compute_lib_gl_error_occured();
+}
+
+bool compute_lib_pbo_init(compute_lib_program_t* program, compute_lib_pbo_t* pbo)
+{
+    glGenBuffers(1, &(pbo->handle));
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo->handle);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, pbo->size, NULL, pbo->usage);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    
+    return compute_lib_gl_error_occured();
+}
+
+bool compute_lib_pbo_destroy(compute_lib_program_t* program, compute_lib_pbo_t* pbo)
+{
+    glDeleteBuffers(1, &(pbo->handle));
+    
+    return compute_lib_gl_error_occured();
+}
+
+bool compute_lib_pbo_write(compute_lib_program_t* program, compute_lib_pbo_t* pbo, void* data)
+{
+    void* mapped;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo->handle);
+    // the old content is invalidated, so the driver does not have to wait for the transfers still reading it
+    mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, pbo->size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (mapped != NULL) {
+        memcpy(mapped, data, pbo->size);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    
+    return compute_lib_gl_error_occured() || (mapped == NULL);
+}
+
 bool compute_lib_uniform_init(compute_lib_program_t* program, compute_lib_uniform_t* uniform)
 {
     glGetUniformIndices(program->handle, 1, (const GLchar **) &(uniform->name), &(uniform->index));
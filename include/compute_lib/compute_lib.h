@@ -30,8 +30,18 @@ typedef struct {
     GLenum severity;
 } compute_lib_error_t;
 
+typedef enum {
+    COMPUTE_LIB_PLATFORM_GBM = 0,       // GBM device on a DRM render node
+    COMPUTE_LIB_PLATFORM_DEVICE,        // EGL device from EGL_EXT_device_enumeration - a DRM device or a software one (Mesa llvmpipe)
+    COMPUTE_LIB_PLATFORM_SURFACELESS,   // EGL_MESA_platform_surfaceless - picks the device itself, falls back to software rendering
+    COMPUTE_LIB_PLATFORM_AUTO           // the platforms above in this order, the first one that initialises is used
+} compute_lib_platform_t;
+
 typedef struct {
     bool initialised;
+    compute_lib_platform_t platform;        // requested platform, set before compute_lib_init
+    const char* device_path;                // DRM device used by the GBM and device platforms, NULL for COMPUTE_LIB_GPU_DRI_PATH (GBM) or the first device (device platform)
+    compute_lib_platform_t active_platform; // platform actually used, valid after compute_lib_init
     int32_t fd;
     struct gbm_device* gbm;
     EGLDisplay dpy;
@@ -66,6 +76,7 @@ typedef struct {
     GLenum type;
     GLuint handle;
     GLuint location;
+    GLuint unit;
     uint32_t data_size;
     uint32_t px_size;
     compute_lib_framebuffer_t* framebuffer;
@@ -77,6 +88,7 @@ typedef struct {
     GLenum usage;
     GLuint handle;
     GLuint index;
+    GLint binding;
 } compute_lib_acbo_t;
 
 typedef struct {
@@ -88,6 +100,12 @@ typedef struct {
     GLuint binding;
 } compute_lib_ssbo_t;
 
+typedef struct {
+    GLenum usage;
+    GLuint handle;
+    GLsizeiptr size;
+} compute_lib_pbo_t;
+
 typedef struct {
     const char* name;
     GLuint location;
@@ -97,11 +115,12 @@ typedef struct {
 } compute_lib_uniform_t;
 
 
-#define COMPUTE_LIB_INSTANCE_NEW ((compute_lib_instance_t) {.initialised = false, .fd = 0, .gbm = NULL, .dpy = NULL, .ctx = EGL_NO_CONTEXT, .last_error = 0, .error_total_cnt = 0, .error_queue = NULL})
+#define COMPUTE_LIB_INSTANCE_NEW ((compute_lib_instance_t) {.initialised = false, .platform = COMPUTE_LIB_PLATFORM_GBM, .device_path = NULL, .active_platform = COMPUTE_LIB_PLATFORM_GBM, .fd = 0, .gbm = NULL, .dpy = NULL, .ctx = EGL_NO_CONTEXT, .last_error = 0, .error_total_cnt = 0, .error_queue = NULL})
 #define COMPUTE_LIB_PROGRAM_NEW(lib_inst_, source_) ((compute_lib_program_t) {.lib_inst = (lib_inst_), .source = (source_), .handle = 0, .shader_handle = 0})
-#define COMPUTE_LIB_IMAGE2D_NEW(uniform_name_, texture_, width_, height_, internal_format_, access_, texture_wrap_, texture_filter_, format_, type_) ((compute_lib_image2d_t) {.uniform_name = (uniform_name_), .texture = (texture_), .width = (width_), .height = (height_), .internal_format = (internal_format_), .access = (access_), .texture_wrap = (texture_wrap_), .texture_filter = (texture_filter_), .format = (format_), .type = (type_), .handle = 0, .location = 0, .data_size = 0, .px_size = 0, .framebuffer = NULL})
+#define COMPUTE_LIB_IMAGE2D_NEW(uniform_name_, texture_, width_, height_, internal_format_, access_, texture_wrap_, texture_filter_, format_, type_) ((compute_lib_image2d_t) {.uniform_name = (uniform_name_), .texture = (texture_), .width = (width_), .height = (height_), .internal_format = (internal_format_), .access = (access_), .texture_wrap = (texture_wrap_), .texture_filter = (texture_filter_), .format = (format_), .type = (type_), .handle = 0, .location = 0, .unit = 0, .data_size = 0, .px_size = 0, .framebuffer = NULL})
 #define COMPUTE_LIB_SSBO_NEW(name_, type_, usage_) ((compute_lib_ssbo_t) {.name = (name_), .type = (type_), .usage = (usage_), .handle = 0, .index = 0, .binding = 0})
-#define COMPUTE_LIB_ACBO_NEW(name_, type_, usage_) ((compute_lib_acbo_t) {.name = (name_), .type = (type_), .usage = (usage_), .handle = 0, .index = 0})
+#define COMPUTE_LIB_PBO_NEW(size_, usage_) ((compute_lib_pbo_t) {.usage = (usage_), .handle = 0, .size = (size_)})
+#define COMPUTE_LIB_ACBO_NEW(name_, type_, usage_) ((compute_lib_acbo_t) {.name = (name_), .type = (type_), .usage = (usage_), .handle = 0, .index = 0, .binding = 0})
 #define COMPUTE_LIB_UNIFORM_NEW(name_) ((compute_lib_uniform_t) {.name = (name_), .location = 0, .size = 0, .type = 0, .index = 0})
 
 
@@ -125,10 +144,13 @@ enum {
     COMPUTE_LIB_ERROR_EGL_BIND_API                      = -109,
     COMPUTE_LIB_ERROR_EGL_CREATE_CTX                    = -110,
     COMPUTE_LIB_ERROR_EGL_MAKE_CURRENT                  = -111,
+    COMPUTE_LIB_ERROR_EGL_EXTENSION_PLATFORM            = -112,
+    COMPUTE_LIB_ERROR_EGL_NO_DEVICE                     = -113,
     COMPUTE_LIB_ERROR_GROUP_GL_ERROR                    = 0x0500
 };
 
 int compute_lib_init(compute_lib_instance_t* inst);
+const char* compute_lib_platform_name(compute_lib_platform_t platform);
 void compute_lib_deinit(compute_lib_instance_t* inst);
 int compute_lib_error_queue_flush(compute_lib_instance_t* inst, FILE* out);
 
@@ -151,6 +173,8 @@ void* compute_lib_image2d_alloc(compute_lib_image2d_t* image2d);
 bool compute_lib_image2d_reset(compute_lib_program_t* program, compute_lib_image2d_t* image2d, void* px_data);
 bool compute_lib_image2d_reset_patch(compute_lib_program_t* program, compute_lib_image2d_t* image2d, void* px_data, int x_min, int x_max, int y_min, int y_max);
 bool compute_lib_image2d_write(compute_lib_program_t* program, compute_lib_image2d_t* image2d, void* image_data);
+bool compute_lib_image2d_write_pbo(compute_lib_program_t* program, compute_lib_image2d_t* image2d, compute_lib_pbo_t* pbo);
+bool compute_lib_image2d_bind(compute_lib_program_t* program, compute_lib_image2d_t* image2d);
 bool compute_lib_image2d_read(compute_lib_program_t* program, compute_lib_image2d_t* image2d, void* image_data);
 bool compute_lib_image2d_read_patch(compute_lib_program_t* program, compute_lib_image2d_t* image2d, void* image_data, int x_min, int x_max, int y_min, int y_max, bool render);
 
@@ -165,6 +189,11 @@ bool compute_lib_ssbo_init(compute_lib_program_t* program, compute_lib_ssbo_t* s
 bool compute_lib_ssbo_destroy(compute_lib_program_t* program, compute_lib_ssbo_t* ssbo);
 bool compute_lib_ssbo_write(compute_lib_program_t* program, compute_lib_ssbo_t* ssbo, void* data, int len);
 bool compute_lib_ssbo_read(compute_lib_program_t* program, compute_lib_ssbo_t* ssbo, void* data, int len);
+bool compute_lib_ssbo_bind(compute_lib_program_t* program, compute_lib_ssbo_t* ssbo);
+
+bool compute_lib_pbo_init(compute_lib_program_t* program, compute_lib_pbo_t* pbo);
+bool compute_lib_pbo_destroy(compute_lib_program_t* program, compute_lib_pbo_t* pbo);
+bool compute_lib_pbo_write(compute_lib_program_t* program, compute_lib_pbo_t* pbo, void* data);
 
 bool compute_lib_uniform_init(compute_lib_program_t* program, compute_lib_uniform_t* uniform);
 bool compute_lib_uniform_write(compute_lib_program_t* program, compute_lib_uniform_t* uniform, void* data);
@@ -0,0 +1,134 @@
+#ifndef BAND_WORKER_POOL_H
+#define BAND_WORKER_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace uvdar {
+
+  /**
+   * @brief A minimal pool of persistent threads for running a fixed number of independent tasks (e.g. image bands) and waiting for all of them to finish
+   */
+  class BandWorkerPool {
+    public:
+
+      /**
+       * @brief The constructor of the class
+       *
+       * @param i_thread_count The total number of threads working on the tasks, including the thread calling run() - the pool itself spawns one less
+       */
+      BandWorkerPool(int i_thread_count) {
+        for (int i = 1; i < i_thread_count; i++) {
+          threads_.emplace_back(&BandWorkerPool::workerLoop, this);
+        }
+      }
+
+      ~BandWorkerPool() {
+        {
+          std::scoped_lock lock(mutex_);
+          stop_ = true;
+        }
+        cv_start_.notify_all();
+        for (auto& thread : threads_) {
+          thread.join();
+        }
+      }
+
+      BandWorkerPool(const BandWorkerPool&) = delete;
+      BandWorkerPool& operator=(const BandWorkerPool&) = delete;
+
+      /**
+       * @brief Runs task(k) for every k in [0, task_count) and blocks until all of them are finished. The calling thread takes part in the work
+       *
+       * @param task_count The number of tasks
+       * @param task The task to run, receives the task index
+       */
+      void run(int task_count, const std::function<void(int)>& task) {
+        {
+          std::scoped_lock lock(mutex_);
+          task_       = &task;
+          next_task_  = 0;
+          task_count_ = task_count;
+          pending_    = task_count;
+        }
+        cv_start_.notify_all();
+
+        while (runNextTask()) {
+        }
+
+        std::unique_lock lock(mutex_);
+        cv_done_.wait(lock, [this] { return pending_ == 0; });
+        task_       = nullptr;
+        next_task_  = 0;
+        task_count_ = 0;
+      }
+
+      /**
+       * @brief Retrieves the total number of threads working on the tasks, including the calling one
+       *
+       * @return The number of threads
+       */
+      int getThreadCount() const {
+        return (int)(threads_.size()) + 1;
+      }
+
+    private:
+
+      /**
+       * @brief Takes the next unclaimed task, if any, and runs it
+       *
+       * @return False if no tasks were left
+       */
+      bool runNextTask() {
+        int k;
+        const std::function<void(int)>* task;
+        {
+          std::scoped_lock lock(mutex_);
+          if (next_task_ >= task_count_) {
+            return false;
+          }
+          k    = next_task_++;
+          task = task_;
+        }
+
+        (*task)(k);
+
+        {
+          std::scoped_lock lock(mutex_);
+          if (--pending_ == 0) {
+            cv_done_.notify_all();
+          }
+        }
+        return true;
+      }
+
+      void workerLoop() {
+        while (true) {
+          {
+            std::unique_lock lock(mutex_);
+            cv_start_.wait(lock, [this] { return stop_ || (next_task_ < task_count_); });
+            if (stop_) {
+              return;
+            }
+          }
+          runNextTask();
+        }
+      }
+
+      std::vector<std::thread> threads_;
+      std::mutex mutex_;
+      std::condition_variable cv_start_;
+      std::condition_variable cv_done_;
+
+      const std::function<void(int)>* task_ = nullptr;
+      int next_task_  = 0;
+      int task_count_ = 0;
+      int pending_    = 0;
+      bool stop_      = false;
+  };
+}
+
+#endif  // BAND_WORKER_POOL_H
@@ -0,0 +1,11 @@
+#ifndef DETECTOR_DEFAULTS_H
+#define DETECTOR_DEFAULTS_H
+
+/*
+ * The fixed settings of the marker detection, shared by the detector node and the tools measuring it, so that both run the backends the same way
+ */
+
+#define MAX_POINTS_PER_IMAGE 200 //images with more marker points are not usable
+#define THRESHOLD_SUN 150        //pixels brighter than this may be a part of the sun
+
+#endif  // DETECTOR_DEFAULTS_H
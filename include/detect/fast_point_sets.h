@@ -0,0 +1,87 @@
+#ifndef FAST_POINT_SETS_H
+#define FAST_POINT_SETS_H
+
+#include <array>
+#include <cstddef>
+
+namespace uvdar {
+
+  /**
+   * @brief Compile-time point sets used in the FAST-like bright point detection
+   */
+  namespace fast_point_sets {
+
+    /**
+     * @brief Offset of a point relative to the tested pixel
+     */
+    struct FastOffset {
+      int x;
+      int y;
+    };
+
+    /**
+     * @brief Points of the FAST ring of the given radius. Only the radii used by the detector are defined
+     *
+     * @tparam R The radius of the ring
+     */
+    template <int R>
+    struct FastRing;
+
+    template <>
+    struct FastRing<3> {
+      static constexpr std::array<FastOffset, 16> points = {{
+        {0, -3}, {0, 3}, {3, 0}, {-3, 0},
+        {2, -2}, {-2, 2}, {-2, -2}, {2, 2},
+        {-1, -3}, {1, 3}, {3, -1}, {-3, 1},
+        {1, -3}, {-1, 3}, {3, 1}, {-3, -1}
+      }};
+    };
+
+    template <>
+    struct FastRing<4> {
+      static constexpr std::array<FastOffset, 24> points = {{
+        {0, -4}, {0, 4}, {4, 0}, {-4, 0},
+        {3, -3}, {-3, 3}, {-3, -3}, {3, 3},
+        {-1, -4}, {1, 4}, {4, -1}, {-4, 1},
+        {1, -4}, {-1, 4}, {4, 1}, {-4, -1},
+        {-2, -4}, {2, 4}, {4, -2}, {-4, 2},
+        {2, -4}, {-2, 4}, {4, 2}, {-4, -2}
+      }};
+    };
+
+    /**
+     * @brief Subset of points inside of the FAST neighborhood of the largest ring - lower right corner only, since the image is iterated over in this direction. Used for the non-maxima suppression
+     */
+    static constexpr std::array<FastOffset, 23> fast_interior = {{
+      {0, 0}, {1, 0}, {2, 0}, {3, 0},
+      {-3, 1}, {-2, 1}, {-1, 1}, {0, 1}, {1, 1}, {2, 1}, {3, 1},
+      {-3, 2}, {-2, 2}, {-1, 2}, {0, 2}, {1, 2}, {2, 2}, {3, 2},
+      {-2, 3}, {-1, 3}, {0, 3}, {1, 3}, {2, 3}
+    }};
+
+    /**
+     * @brief The largest coordinate of a point set along either axis - a pixel at least this far from every image border can be tested without border checks
+     */
+    template <size_t N>
+    constexpr int reach(const std::array<FastOffset, N>& points) {
+      int result = 0;
+      for (auto& point : points) {
+        int x = (point.x < 0) ? -point.x : point.x;
+        int y = (point.y < 0) ? -point.y : point.y;
+        result = (x > result) ? x : result;
+        result = (y > result) ? y : result;
+      }
+      return result;
+    }
+
+    static_assert(reach(FastRing<3>::points) == 3, "The FAST ring of radius 3 has points outside of its radius");
+    static_assert(reach(FastRing<4>::points) == 4, "The FAST ring of radius 4 has points outside of its radius");
+
+    /**
+     * @brief The number of image rows above and below a tested pixel that the FAST test reads
+     */
+    static constexpr int fast_halo = reach(FastRing<4>::points);
+  }
+}
+
+#endif  // FAST_POINT_SETS_H
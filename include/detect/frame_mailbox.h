@@ -0,0 +1,103 @@
+#ifndef FRAME_MAILBOX_H
+#define FRAME_MAILBOX_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <utility>
+
+namespace uvdar {
+
+  /**
+   * @brief Single-slot mailbox handing frames from a single producer thread to a single consumer thread. A new frame replaces the one not yet taken, so the consumer always gets the latest frame
+   *        The frames are passed through a triple buffer of preallocated slots - the producer writes into its own slot and swaps it with the shared one, the consumer swaps its own slot with the shared one if that holds a new frame. Neither side allocates or locks while the other keeps up
+   *        The mutex and the condition variable are only used when the consumer finds the mailbox empty and goes to sleep - the producer only takes the mutex to wake the consumer if it is sleeping
+   *
+   * @tparam T The type of the frame - typically a shared pointer. Must be default constructible and move assignable
+   */
+  template <typename T>
+  class FrameMailbox {
+    public:
+      FrameMailbox() = default;
+
+      FrameMailbox(const FrameMailbox&) = delete;
+      FrameMailbox& operator=(const FrameMailbox&) = delete;
+
+      /**
+       * @brief Puts a frame into the mailbox. Must not be called concurrently with itself
+       *
+       * @param i_frame The frame
+       *
+       * @return True if a frame that was not taken yet had to be dropped
+       */
+      bool put(T i_frame) {
+        slots_[write_slot_] = std::move(i_frame);
+        unsigned int previous = shared_.exchange(write_slot_ | fresh_flag); //the sequentially consistent exchange and the load of sleeping_ below pair with the store of sleeping_ and the predicate check in take
+        write_slot_ = previous & slot_mask;
+        bool dropped = ((previous & fresh_flag) != 0);
+        if (dropped) { //the dropped frame is released right away, not only when the slot is written again
+          slots_[write_slot_] = T();
+        }
+
+        if (sleeping_.load()) {
+          {
+            std::scoped_lock lock(mutex_); //the consumer holds the mutex from setting sleeping_ until it sleeps, so the wake-up can not come between its check and its sleep
+          }
+          cv_.notify_one();
+        }
+        return dropped;
+      }
+
+      /**
+       * @brief Waits for a frame and takes it out of the mailbox. Must not be called concurrently with itself
+       *
+       * @param o_frame Output - the latest frame
+       *
+       * @return False if the mailbox was closed, true if a frame was taken
+       */
+      bool take(T& o_frame) {
+        while (!closed_.load()) {
+          if ((shared_.load() & fresh_flag) != 0) {
+            read_slot_ = shared_.exchange(read_slot_) & slot_mask;
+            o_frame = std::move(slots_[read_slot_]);
+            slots_[read_slot_] = T(); //the slot does not keep a reference to the frame while it is processed
+            return true;
+          }
+
+          std::unique_lock lock(mutex_);
+          sleeping_.store(true);
+          cv_.wait(lock, [&] {
+            return closed_.load() || ((shared_.load() & fresh_flag) != 0);
+          });
+          sleeping_.store(false);
+        }
+        return false;
+      }
+
+      /**
+       * @brief Wakes the consumer up and makes all the further calls of take return false
+       */
+      void close() {
+        {
+          std::scoped_lock lock(mutex_);
+          closed_ = true;
+        }
+        cv_.notify_all();
+      }
+
+    private:
+      static constexpr unsigned int slot_mask  = 3; //the index of the shared slot
+      static constexpr unsigned int fresh_flag = 4; //set if the shared slot holds a frame not taken yet
+
+      T slots_[3];
+      unsigned int write_slot_ = 0;        //owned by the producer
+      unsigned int read_slot_  = 1;        //owned by the consumer
+      std::atomic_uint shared_{2};         //the slot passed between the two, with fresh_flag
+      std::atomic_bool sleeping_{false};
+      std::atomic_bool closed_{false};
+      std::mutex mutex_;
+      std::condition_variable cv_;
+  };
+}
+
+#endif  // FRAME_MAILBOX_H
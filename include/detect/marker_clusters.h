@@ -0,0 +1,166 @@
+#ifndef MARKER_CLUSTERS_H
+#define MARKER_CLUSTERS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+typedef struct {
+    uint16_t y;
+    uint16_t x;
+} fast_det_pt_t;
+
+namespace uvdar {
+
+  /**
+   * @brief Merges the raw marker points found by the GPU detector into clusters. The clusters are binned by their current means into a grid, so the merging is linear in the number of the points. Kept apart from the detector, so that it can be checked without a GPU
+   */
+  class MarkerClusters {
+    public:
+
+      /**
+       * @brief Merges the raw points of the markers closer than distance_px to the mean of a cluster into it, and retrieves the means of the clusters. The buffers are reused between calls
+       *
+       * @param markers The raw points, in any order
+       * @param init_cnt The number of the raw points
+       * @param distance_px The merging distance
+       * @param image_size The size of the image the points lie in
+       * @param detected_points The means of the clusters are appended to this, in the order of the first points of the clusters by rows and columns
+       *
+       * @return The number of the clusters
+       */
+      uint32_t findCentroids(const fast_det_pt_t* markers, uint32_t init_cnt, uint32_t distance_px, cv::Size image_size, std::vector<cv::Point2i>& detected_points) {
+        int32_t cell_size = std::max((int32_t)(distance_px), 1);
+        int32_t max_dist2 = (int32_t)(distance_px * distance_px);
+        int32_t grid_width = (image_size.width / cell_size) + 1;
+        int32_t grid_height = (image_size.height / cell_size) + 1;
+
+        // each point joins the closest cluster near to it at that moment - the points are ordered by rows and columns first, so that the result does not depend on the order the GPU found them in
+        sortMarkers(markers, init_cnt, image_size);
+
+        // the clusters are binned by their current means into cells of distance_px, so only the neighbouring cells can contain a cluster near to a point
+        cell_heads_.assign(grid_width * grid_height, -1);
+        clusters_.clear();
+
+        for (uint32_t i = 0; i < init_cnt; i++) {
+          const fast_det_pt_t& pt = sorted_markers_[i];
+          int32_t cell_x = pt.x / cell_size;
+          int32_t cell_y = pt.y / cell_size;
+
+          int32_t closest_marker = -1;
+          int32_t min_dist2 = max_dist2;
+          for (int32_t gy = std::max(cell_y - 1, 0); gy <= std::min(cell_y + 1, grid_height - 1); gy++) {
+            for (int32_t gx = std::max(cell_x - 1, 0); gx <= std::min(cell_x + 1, grid_width - 1); gx++) {
+              for (int32_t j = cell_heads_[(gy * grid_width) + gx]; j >= 0; j = clusters_[j].next) {
+                const Cluster& cluster = clusters_[j];
+                int32_t dx = (cluster.sum_x / cluster.count) - pt.x;
+                int32_t dy = (cluster.sum_y / cluster.count) - pt.y;
+                int32_t dist2 = (dx * dx) + (dy * dy);
+                if ((dist2 < min_dist2) || ((dist2 == min_dist2) && (closest_marker > j))) { //on a tie, the older cluster is kept
+                  min_dist2 = dist2;
+                  closest_marker = j;
+                }
+              }
+            }
+          }
+
+          if (closest_marker != -1) {
+            Cluster& cluster = clusters_[closest_marker];
+            cluster.sum_x += pt.x;
+            cluster.sum_y += pt.y;
+            cluster.count += 1;
+            int32_t cell = ((cluster.sum_y / cluster.count / cell_size) * grid_width) + (cluster.sum_x / cluster.count / cell_size);
+            if (cell != cluster.cell) {
+              unlinkCluster(closest_marker);
+              linkCluster(closest_marker, cell);
+            }
+          } else {
+            clusters_.push_back({pt.x, pt.y, 1, -1, -1, -1});
+            linkCluster((int32_t)(clusters_.size()) - 1, (cell_y * grid_width) + cell_x);
+          }
+        }
+
+        detected_points.reserve(detected_points.size() + clusters_.size());
+        for (auto& cluster : clusters_) {
+          detected_points.push_back(cv::Point(cluster.sum_x / cluster.count, cluster.sum_y / cluster.count));
+        }
+        return (uint32_t)(clusters_.size());
+      }
+
+    private:
+
+      /**
+       * @brief A cluster of raw marker points, kept in a doubly linked list of the grid cell of its mean
+       */
+      struct Cluster {
+        int32_t sum_x;
+        int32_t sum_y;
+        int32_t count;
+        int32_t prev; ///< the previous cluster in the same cell, -1 if none
+        int32_t next; ///< the next cluster in the same cell, -1 if none
+        int32_t cell;
+      };
+
+      /**
+       * @brief Orders the raw points of the markers by rows and columns into sorted_markers_
+       */
+      void sortMarkers(const fast_det_pt_t* markers, uint32_t init_cnt, cv::Size image_size) {
+        // LSD radix sort with one counting pass per coordinate - the columns first, then stably the rows
+        sort_tmp_.resize(init_cnt);
+        sorted_markers_.resize(init_cnt);
+
+        sort_counts_.assign(image_size.width + 1, 0);
+        for (uint32_t i = 0; i < init_cnt; i++) {
+          sort_counts_[markers[i].x + 1]++;
+        }
+        for (int c = 1; c <= image_size.width; c++) {
+          sort_counts_[c] += sort_counts_[c - 1];
+        }
+        for (uint32_t i = 0; i < init_cnt; i++) {
+          sort_tmp_[sort_counts_[markers[i].x]++] = markers[i];
+        }
+
+        sort_counts_.assign(image_size.height + 1, 0);
+        for (uint32_t i = 0; i < init_cnt; i++) {
+          sort_counts_[sort_tmp_[i].y + 1]++;
+        }
+        for (int r = 1; r <= image_size.height; r++) {
+          sort_counts_[r] += sort_counts_[r - 1];
+        }
+        for (uint32_t i = 0; i < init_cnt; i++) {
+          sorted_markers_[sort_counts_[sort_tmp_[i].y]++] = sort_tmp_[i];
+        }
+      }
+
+      void linkCluster(int32_t index, int32_t cell) {
+        Cluster& cluster = clusters_[index];
+        cluster.cell = cell;
+        cluster.prev = -1;
+        cluster.next = cell_heads_[cell];
+        if (cluster.next >= 0) {
+          clusters_[cluster.next].prev = index;
+        }
+        cell_heads_[cell] = index;
+      }
+
+      void unlinkCluster(int32_t index) {
+        Cluster& cluster = clusters_[index];
+        if (cluster.prev >= 0) {
+          clusters_[cluster.prev].next = cluster.next;
+        } else {
+          cell_heads_[cluster.cell] = cluster.next;
+        }
+        if (cluster.next >= 0) {
+          clusters_[cluster.next].prev = cluster.prev;
+        }
+      }
+
+      std::vector<fast_det_pt_t> sort_tmp_, sorted_markers_;
+      std::vector<uint32_t> sort_counts_;
+      std::vector<Cluster> clusters_;
+      std::vector<int32_t> cell_heads_; //the first cluster in each grid cell, -1 if none
+  };
+}
+
+#endif  // MARKER_CLUSTERS_H
@@ -0,0 +1,111 @@
+#ifndef POINT_GRID_H
+#define POINT_GRID_H
+
+#include <algorithm>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+namespace uvdar {
+
+  /**
+   * @brief Uniform grid over the image plane for finding points close to a query point. If the cell size is at least the search radius, only the 3x3 cells around the query point can contain points within the radius
+   */
+  class PointGrid {
+    public:
+
+      /**
+       * @brief Removes all points and prepares the grid for the given image. Allocations are kept if the layout does not change
+       *
+       * @param i_size The size of the image
+       * @param i_cell_size The size of the grid cells in pixels - should be at least the largest search radius
+       */
+      void reset(cv::Size i_size, int i_cell_size) {
+        int cols = (i_size.width + i_cell_size - 1) / i_cell_size;
+        int rows = (i_size.height + i_cell_size - 1) / i_cell_size;
+        if ((i_cell_size != cell_size_) || (cols != cols_) || (rows != rows_)) {
+          cell_size_ = i_cell_size;
+          cols_      = std::max(cols, 1);
+          rows_      = std::max(rows, 1);
+          cells_.assign(cols_ * rows_, std::vector<int>());
+          used_cells_.clear();
+          return;
+        }
+        for (auto c : used_cells_) { //only the cells filled since the last reset are emptied
+          cells_[c].clear();
+        }
+        used_cells_.clear();
+      }
+
+      /**
+       * @brief Inserts a point into the grid
+       *
+       * @param i_id The identifier reported for this point by forEachNear
+       * @param i_point The position of the point
+       */
+      void insert(int i_id, cv::Point i_point) {
+        int c = cellIndex(i_point);
+        if (cells_[c].empty()) {
+          used_cells_.push_back(c);
+        }
+        cells_[c].push_back(i_id);
+      }
+
+      /**
+       * @brief Updates the position of a previously inserted point
+       *
+       * @param i_id The identifier of the point
+       * @param i_from The position the point was inserted with
+       * @param i_to The new position
+       */
+      void move(int i_id, cv::Point i_from, cv::Point i_to) {
+        int c_from = cellIndex(i_from);
+        int c_to   = cellIndex(i_to);
+        if (c_from == c_to) {
+          return;
+        }
+        auto& ids = cells_[c_from];
+        ids.erase(std::find(ids.begin(), ids.end(), i_id));
+        if (cells_[c_to].empty()) {
+          used_cells_.push_back(c_to);
+        }
+        cells_[c_to].push_back(i_id);
+      }
+
+      /**
+       * @brief Calls a function for every point in the 3x3 cells around the query point, in no particular order
+       *
+       * @param i_point The query point
+       * @param f The function, receives the identifier of the point
+       */
+      template <typename F>
+      void forEachNear(cv::Point i_point, F&& f) const {
+        int cx = cellCoordinate(i_point.x, cols_);
+        int cy = cellCoordinate(i_point.y, rows_);
+        for (int y = std::max(cy - 1, 0); y <= std::min(cy + 1, rows_ - 1); y++) {
+          for (int x = std::max(cx - 1, 0); x <= std::min(cx + 1, cols_ - 1); x++) {
+            for (auto id : cells_[(y * cols_) + x]) {
+              f(id);
+            }
+          }
+        }
+      }
+
+    private:
+
+      int cellCoordinate(int v, int count) const {
+        return std::clamp((v >= 0) ? (v / cell_size_) : -1, 0, count - 1); //points outside of the image are kept in the border cells
+      }
+
+      int cellIndex(cv::Point i_point) const {
+        return (cellCoordinate(i_point.y, rows_) * cols_) + cellCoordinate(i_point.x, cols_);
+      }
+
+      int cell_size_ = 0;
+      int cols_      = 0;
+      int rows_      = 0;
+      std::vector<std::vector<int>> cells_;
+      std::vector<int> used_cells_;
+  };
+}
+
+#endif  // POINT_GRID_H
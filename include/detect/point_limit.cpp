@@ -0,0 +1,150 @@
+#include <algorithm>
+
+#include "point_limit.h"
+
+void uvdar::PointLimit::setLimit(int i_max_points, bool i_tile_budget) {
+  max_points_  = std::max(i_max_points, 0);
+  tile_budget_ = i_tile_budget;
+}
+
+void uvdar::PointLimit::start(cv::Size i_size) {
+  overload_ = DetectionOverload();
+  size_     = i_size;
+  tile_dropped_.assign(tile_grid * tile_grid, false);
+}
+
+bool uvdar::PointLimit::check(std::vector<cv::Point2i>& detected_points, const std::vector<cv::Point2i>& sun_points, const std::vector<cv::Point2i>* potential_sun, int potential_sun_reach) {
+  if ((max_points_ == 0) || (((int)(detected_points.size()) <= max_points_) && !overload_.degraded)) {
+    return false;
+  }
+
+  //count the points that would survive the glare filtering against the sun points known so far, for each tile
+  tile_counts_.assign(tile_grid * tile_grid, 0);
+  int count = 0;
+  prepareGlareGrid(sun_points);
+  if (potential_sun != nullptr) {
+    preparePotentialSun(*potential_sun, glare_radius + potential_sun_reach);
+  }
+  for (auto& point : detected_points) {
+    if (isGlare(point, sun_points) || ((potential_sun != nullptr) && nearPotentialSun(point))) {
+      continue;
+    }
+    tile_counts_[tileIndex(point)]++;
+    count++;
+  }
+  if (!overload_.degraded && (count <= max_points_)) {
+    return false;
+  }
+
+  if (!overload_.overloaded) {
+    int worst = (int)(std::max_element(tile_counts_.begin(), tile_counts_.end()) - tile_counts_.begin());
+    overload_.overloaded       = true;
+    overload_.point_count      = count;
+    overload_.tile             = tileRect(worst);
+    overload_.tile_point_count = tile_counts_[worst];
+  }
+  if (!tile_budget_) {
+    return true;
+  }
+
+  overload_.degraded = true;
+  int budget = std::max(max_points_ / (tile_grid * tile_grid), 1);
+  bool dropped = false;
+  for (int t = 0; t < (int)(tile_counts_.size()); t++) {
+    if (!tile_dropped_[t] && (tile_counts_[t] > budget)) {
+      tile_dropped_[t] = true;
+      overload_.dropped_tiles.push_back(tileRect(t));
+      dropped = true;
+    }
+  }
+  if (dropped) {
+    detected_points.erase(std::remove_if(detected_points.begin(), detected_points.end(), [&](const cv::Point2i& point) { return tile_dropped_[tileIndex(point)]; }), detected_points.end());
+  }
+  return false;
+}
+
+void uvdar::PointLimit::buildBudgetSpans(RowSpans& o_spans) const {
+  std::vector<cv::Rect> kept;
+  for (int t = 0; t < (int)(tile_dropped_.size()); t++) {
+    if (!tile_dropped_[t]) {
+      kept.push_back(tileRect(t));
+    }
+  }
+  o_spans.buildFromRegions(kept, size_);
+}
+
+void uvdar::PointLimit::filterGlare(std::vector<cv::Point2i>& detected_points, const std::vector<cv::Point2i>& sun_points, cv::Size i_size) {
+  if (sun_points.empty()) {
+    return;
+  }
+
+  size_ = i_size;
+  prepareGlareGrid(sun_points);
+
+  size_t kept = 0;
+  for (auto& point : detected_points) {
+    if (!isGlare(point, sun_points)) {
+      detected_points[kept++] = point; //stable compaction instead of erasing in the loop
+    }
+  }
+  detected_points.resize(kept);
+}
+
+void uvdar::PointLimit::prepareGlareGrid(const std::vector<cv::Point2i>& sun_points) {
+  glare_grid_.reset(size_, glare_radius);
+  for (int k = 0; k < (int)(sun_points.size()); k++) {
+    glare_grid_.insert(k, sun_points[k]);
+  }
+}
+
+bool uvdar::PointLimit::isGlare(const cv::Point2i& point, const std::vector<cv::Point2i>& sun_points) const {
+  bool glare = false;
+  glare_grid_.forEachNear(point, [&](int k) {
+    if (cv::norm(point - sun_points[k]) < glare_radius) {
+      glare = true;
+    }
+  });
+  return glare;
+}
+
+void uvdar::PointLimit::preparePotentialSun(const std::vector<cv::Point2i>& potential_sun, int distance) {
+  potential_sun_cols_ = (size_.width + potential_sun_cell - 1) / potential_sun_cell;
+  potential_sun_rows_ = (size_.height + potential_sun_cell - 1) / potential_sun_cell;
+  potential_sun_range_ = (distance / potential_sun_cell) + 1;
+  potential_sun_cells_.assign(potential_sun_cols_ * potential_sun_rows_, 0);
+  for (auto& point : potential_sun) {
+    int cx = std::clamp(point.x / potential_sun_cell, 0, potential_sun_cols_ - 1);
+    int cy = std::clamp(point.y / potential_sun_cell, 0, potential_sun_rows_ - 1);
+    potential_sun_cells_[(cy * potential_sun_cols_) + cx] = 1;
+  }
+}
+
+bool uvdar::PointLimit::nearPotentialSun(const cv::Point2i& point) const { //checks whole cells, so some points farther than the distance are reported as well - these are merely not counted
+  int cx = std::clamp(point.x / potential_sun_cell, 0, potential_sun_cols_ - 1);
+  int cy = std::clamp(point.y / potential_sun_cell, 0, potential_sun_rows_ - 1);
+  for (int y = std::max(cy - potential_sun_range_, 0); y <= std::min(cy + potential_sun_range_, potential_sun_rows_ - 1); y++) {
+    for (int x = std::max(cx - potential_sun_range_, 0); x <= std::min(cx + potential_sun_range_, potential_sun_cols_ - 1); x++) {
+      if (potential_sun_cells_[(y * potential_sun_cols_) + x] != 0) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+int uvdar::PointLimit::tileIndex(const cv::Point2i& point) const {
+  int tx = std::clamp((point.x * tile_grid) / std::max(size_.width, 1), 0, tile_grid - 1);
+  int ty = std::clamp((point.y * tile_grid) / std::max(size_.height, 1), 0, tile_grid - 1);
+  return (ty * tile_grid) + tx;
+}
+
+cv::Rect uvdar::PointLimit::tileRect(int t) const {
+  int tx = t % tile_grid;
+  int ty = t / tile_grid;
+  //rounded up, so that the tiles contain exactly the pixels assigned to them by tileIndex
+  int x_begin = ((size_.width * tx) + tile_grid - 1) / tile_grid;
+  int y_begin = ((size_.height * ty) + tile_grid - 1) / tile_grid;
+  int x_end   = ((size_.width * (tx + 1)) + tile_grid - 1) / tile_grid;
+  int y_end   = ((size_.height * (ty + 1)) + tile_grid - 1) / tile_grid;
+  return cv::Rect(x_begin, y_begin, x_end - x_begin, y_end - y_begin);
+}
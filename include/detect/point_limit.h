@@ -0,0 +1,126 @@
+#ifndef POINT_LIMIT_H
+#define POINT_LIMIT_H
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include "point_grid.h"
+#include "row_spans.h"
+
+namespace uvdar {
+
+  /**
+   * @brief Description of an image that contained more marker points than the set limit
+   */
+  struct DetectionOverload {
+    bool overloaded = false;           ///< the limit was exceeded in the last processed image
+    bool degraded = false;             ///< the tiles exceeding their share of the limit were dropped and the points of the other tiles were kept. Otherwise the detection was stopped and no points were retrieved
+    int point_count = 0;               ///< the number of points found at the moment the limit was exceeded
+    cv::Rect tile;                     ///< the tile with the most points at that moment
+    int tile_point_count = 0;          ///< the number of points in that tile
+    std::vector<cv::Rect> dropped_tiles; ///< the tiles dropped in the degraded mode
+  };
+
+  /**
+   * @brief The post-processing of the marker points shared by the detector backends - the glare filtering around the sun, and the limit of the number of points per image with the optional budget of the image tiles
+   */
+  class PointLimit {
+    public:
+
+      /**
+       * @brief Sets the limit of the number of marker points retrieved from a single image. Images with more points are not usable, so the detection may stop as soon as the limit is exceeded instead of processing the rest of the image
+       *        The points closer than glare_radius to a sun point are not counted, since the glare filtering would discard them. While the sun is not known completely, the points that may still turn out to be glare are not counted either, so an image is only abandoned early if it would exceed the limit after the glare filtering as well
+       *
+       * @param i_max_points The largest usable number of marker points, 0 for no limit
+       * @param i_tile_budget If true, the image is not abandoned when the limit is exceeded - instead, each of the tile_grid x tile_grid tiles of the image may only contribute its share of the limit, and the tiles exceeding it are dropped
+       */
+      void setLimit(int i_max_points, bool i_tile_budget);
+
+      /**
+       * @brief The largest usable number of marker points, 0 for no limit
+       */
+      int maxPoints() const {
+        return max_points_;
+      }
+
+      /**
+       * @brief Retrieves the overload information of the last processed image
+       *
+       * @return The overload of the last image - its member overloaded is false if the limit was not exceeded
+       */
+      const DetectionOverload& overload() const {
+        return overload_;
+      }
+
+      /**
+       * @brief Prepares the overload checking for a new image. Must be called before check is used on the image
+       *
+       * @param i_size The size of the image
+       */
+      void start(cv::Size i_size);
+
+      /**
+       * @brief Checks the points retrieved so far against the limit. May be called repeatedly while processing the image, to stop early
+       *        If the limit is exceeded, the overload is recorded. In the tile budget mode, the points of the tiles exceeding their share are then removed and the tiles are listed in the overload
+       *
+       * @param detected_points The marker points retrieved so far - the points of the dropped tiles are removed in place. The points must not change anymore, apart from the glare filtering
+       * @param sun_points The sun points retrieved so far
+       * @param potential_sun If the search for the sun is not complete yet, the pixels that may still become a part of the sun - nullptr if sun_points is complete. The points closer than glare_radius + potential_sun_reach to any of these are not counted, since the glare filtering may still discard them
+       * @param potential_sun_reach The largest distance of a final sun point from the nearest pixel that is a part of the sun
+       *
+       * @return True if the detection should stop - the limit was exceeded and the tile budget mode is not active
+       */
+      bool check(std::vector<cv::Point2i>& detected_points, const std::vector<cv::Point2i>& sun_points, const std::vector<cv::Point2i>* potential_sun = nullptr, int potential_sun_reach = 0);
+
+      /**
+       * @brief Builds the spans of the pixels outside of the tiles dropped by check
+       *
+       * @param o_spans Output - the spans of the pixels of the tiles that were not dropped
+       */
+      void buildBudgetSpans(RowSpans& o_spans) const;
+
+      /**
+       * @brief Discards the detected marker points closer than glare_radius to any sun point - if a marker point is close to the sun, it might be merely glare, so we discard it rather than to have numerous false detections there
+       *
+       * @param detected_points The marker points, filtered in place without changing their order
+       * @param sun_points The sun points
+       * @param i_size The size of the image the points were retrieved from
+       */
+      void filterGlare(std::vector<cv::Point2i>& detected_points, const std::vector<cv::Point2i>& sun_points, cv::Size i_size);
+
+      /**
+       * @brief The number of tiles along each axis of the image used for reporting and budgeting the overloads
+       */
+      static constexpr int tile_grid = 4;
+
+      /**
+       * @brief Marker points closer than this to a sun point are discarded as glare, in pixels
+       */
+      static constexpr int glare_radius = 25;
+
+    private:
+
+      void prepareGlareGrid(const std::vector<cv::Point2i>& sun_points);
+      bool isGlare(const cv::Point2i& point, const std::vector<cv::Point2i>& sun_points) const;
+      void preparePotentialSun(const std::vector<cv::Point2i>& potential_sun, int distance);
+      bool nearPotentialSun(const cv::Point2i& point) const;
+      int tileIndex(const cv::Point2i& point) const;
+      cv::Rect tileRect(int t) const;
+
+      int max_points_ = 0;
+      bool tile_budget_ = false;
+      DetectionOverload overload_;
+      std::vector<bool> tile_dropped_;
+      std::vector<int> tile_counts_;
+
+      cv::Size size_;
+      PointGrid glare_grid_;
+
+      static constexpr int potential_sun_cell = 8; //the size of the cells of the occupancy grid of the potential sun pixels, in pixels
+      std::vector<unsigned char> potential_sun_cells_;
+      int potential_sun_cols_ = 0;
+      int potential_sun_rows_ = 0;
+      int potential_sun_range_ = 0; //the number of cells around a point that may contain a potential sun pixel within the distance
+  };
+}
+
+#endif  // POINT_LIMIT_H
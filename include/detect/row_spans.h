@@ -0,0 +1,224 @@
+#ifndef ROW_SPANS_H
+#define ROW_SPANS_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+namespace uvdar {
+
+  /**
+   * @brief A range of columns [begin, end) of a single image row
+   */
+  struct ColumnSpan {
+    int begin;
+    int end;
+  };
+
+  /**
+   * @brief Run-length representation of a set of image pixels - sorted, disjoint column spans of each image row
+   */
+  class RowSpans {
+    public:
+
+      /**
+       * @brief Builds the spans of the non-zero pixels of a mask
+       *
+       * @param i_mask Single channel 8-bit mask
+       */
+      void buildFromMask(const cv::Mat& i_mask) {
+        start(i_mask.size());
+        for (int j = 0; j < size_.height; j++) {
+          first_[j] = (int)(spans_.size());
+          const unsigned char* row = i_mask.data + (j * i_mask.cols);
+          int i = 0;
+          while (i < size_.width) {
+            while ((i < size_.width) && (row[i] == 0)) {
+              i++;
+            }
+            int begin = i;
+            while ((i < size_.width) && (row[i] != 0)) {
+              i++;
+            }
+            if (begin < i) {
+              spans_.push_back({begin, i});
+            }
+          }
+        }
+        first_[size_.height] = (int)(spans_.size());
+      }
+
+      /**
+       * @brief Builds the spans covering the given regions of an image
+       *
+       * @param i_regions The regions - may overlap and reach outside of the image
+       * @param i_size The size of the image
+       */
+      void buildFromRegions(const std::vector<cv::Rect>& i_regions, cv::Size i_size) {
+        //clip the regions to the image
+        regions_.clear();
+        for (auto& region : i_regions) {
+          int x_begin = std::max(region.x, 0);
+          int y_begin = std::max(region.y, 0);
+          int x_end   = std::min(region.x + region.width, i_size.width);
+          int y_end   = std::min(region.y + region.height, i_size.height);
+          if ((x_begin < x_end) && (y_begin < y_end)) {
+            regions_.push_back(cv::Rect(x_begin, y_begin, x_end - x_begin, y_end - y_begin));
+          }
+        }
+        std::sort(regions_.begin(), regions_.end(), [](const cv::Rect& a, const cv::Rect& b) { return a.x < b.x; });
+
+        start(i_size);
+        for (int j = 0; j < size_.height; j++) {
+          first_[j] = (int)(spans_.size());
+          for (auto& region : regions_) { //the regions are sorted by their left edge, so overlapping spans can be merged with the last one
+            if ((j < region.y) || (j >= (region.y + region.height))) {
+              continue;
+            }
+            if ((spans_.size() > (size_t)(first_[j])) && (region.x <= spans_.back().end)) {
+              spans_.back().end = std::max(spans_.back().end, region.x + region.width);
+            } else {
+              spans_.push_back({region.x, region.x + region.width});
+            }
+          }
+        }
+        first_[size_.height] = (int)(spans_.size());
+      }
+
+      /**
+       * @brief Builds the spans of the pixels contained in both of the inputs. The inputs must describe images of the same size
+       *
+       * @param a The first set of spans
+       * @param b The second set of spans
+       */
+      void buildIntersection(const RowSpans& a, const RowSpans& b) {
+        start(a.size_);
+        for (int j = 0; j < size_.height; j++) {
+          first_[j] = (int)(spans_.size());
+          const ColumnSpan* sa = a.begin(j);
+          const ColumnSpan* sb = b.begin(j);
+          while ((sa != a.end(j)) && (sb != b.end(j))) { //merge-like walk over two sorted lists
+            int begin = std::max(sa->begin, sb->begin);
+            int end   = std::min(sa->end, sb->end);
+            if (begin < end) {
+              spans_.push_back({begin, end});
+            }
+            if (sa->end < sb->end) {
+              sa++;
+            } else {
+              sb++;
+            }
+          }
+        }
+        first_[size_.height] = (int)(spans_.size());
+      }
+
+      /**
+       * @brief Builds the spans of the pixels contained in the first input but not in the second one. The inputs must describe images of the same size
+       *
+       * @param a The set of spans to subtract from
+       * @param b The set of spans to subtract
+       */
+      void buildDifference(const RowSpans& a, const RowSpans& b) {
+        start(a.size_);
+        for (int j = 0; j < size_.height; j++) {
+          first_[j] = (int)(spans_.size());
+          const ColumnSpan* sb = b.begin(j);
+          for (const ColumnSpan* sa = a.begin(j); sa != a.end(j); sa++) {
+            int begin = sa->begin;
+            while ((sb != b.end(j)) && (sb->end <= begin)) {
+              sb++;
+            }
+            for (const ColumnSpan* cut = sb; (cut != b.end(j)) && (cut->begin < sa->end); cut++) { //the spans of b overlapping this span of a split it
+              if (begin < cut->begin) {
+                spans_.push_back({begin, cut->begin});
+              }
+              begin = std::max(begin, cut->end);
+            }
+            if (begin < sa->end) {
+              spans_.push_back({begin, sa->end});
+            }
+          }
+        }
+        first_[size_.height] = (int)(spans_.size());
+      }
+
+      /**
+       * @brief Builds the spans of the pixels closer than a radius to any of the given centers
+       *
+       * @param i_centers The centers - may lie outside of the image
+       * @param i_radius The radius, the pixels at exactly this distance are not included
+       * @param i_size The size of the image
+       */
+      void buildFromDiscs(const std::vector<cv::Point2i>& i_centers, int i_radius, cv::Size i_size) {
+        start(i_size);
+        std::vector<ColumnSpan> row_spans;
+        for (int j = 0; j < size_.height; j++) {
+          first_[j] = (int)(spans_.size());
+          row_spans.clear();
+          for (auto& center : i_centers) {
+            int dy = j - center.y;
+            int rest = (i_radius * i_radius) - (dy * dy);
+            if (rest <= 0) {
+              continue;
+            }
+            int half = (int)(std::sqrt((double)(rest)));
+            if ((half * half) >= rest) { //strictly closer than the radius
+              half--;
+            }
+            int begin = std::max(center.x - half, 0);
+            int end   = std::min(center.x + half + 1, size_.width);
+            if (begin < end) {
+              row_spans.push_back({begin, end});
+            }
+          }
+          std::sort(row_spans.begin(), row_spans.end(), [](const ColumnSpan& a, const ColumnSpan& b) { return a.begin < b.begin; });
+          for (auto& span : row_spans) { //merge the overlapping discs
+            if ((spans_.size() > (size_t)(first_[j])) && (span.begin <= spans_.back().end)) {
+              spans_.back().end = std::max(spans_.back().end, span.end);
+            } else {
+              spans_.push_back(span);
+            }
+          }
+        }
+        first_[size_.height] = (int)(spans_.size());
+      }
+
+      /**
+       * @brief The first span of an image row
+       */
+      const ColumnSpan* begin(int row) const {
+        return spans_.data() + first_[row];
+      }
+
+      /**
+       * @brief One past the last span of an image row
+       */
+      const ColumnSpan* end(int row) const {
+        return spans_.data() + first_[row + 1];
+      }
+
+      /**
+       * @brief The size of the image described by the spans
+       */
+      cv::Size size() const {
+        return size_;
+      }
+
+    private:
+
+      void start(cv::Size i_size) {
+        size_ = i_size;
+        spans_.clear();
+        first_.resize(size_.height + 1);
+      }
+
+      cv::Size size_;
+      std::vector<ColumnSpan> spans_;
+      std::vector<int> first_; //index of the first span of each row in spans_, with one extra element marking the end of the last row
+      std::vector<cv::Rect> regions_;
+  };
+}
+
+#endif  // ROW_SPANS_H
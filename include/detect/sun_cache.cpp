@@ -0,0 +1,42 @@
+#include <algorithm>
+#include <cstdlib>
+
+#include "sun_cache.h"
+
+void uvdar::SunCache::configure(int i_refresh_period, double i_max_change) {
+  period_     = std::max(i_refresh_period, 0);
+  max_change_ = std::max(i_max_change, 0.0);
+  valid_      = false;
+  stats_      = SunCacheStats();
+  full_time_  = -1.0;
+}
+
+bool uvdar::SunCache::usable(cv::Size i_size, int mask_id) const {
+  return (period_ > 0) && valid_ && (size_ == i_size) && (mask_id_ == mask_id) && (age_ < period_);
+}
+
+bool uvdar::SunCache::changed(int i_saturated) const {
+  return std::abs(i_saturated - saturated_) > (max_change_ * std::max(saturated_, 1));
+}
+
+void uvdar::SunCache::store(const std::vector<cv::Point2i>& sun_points, int i_saturated, cv::Size i_size, int mask_id) {
+  points_    = sun_points;
+  saturated_ = i_saturated;
+  size_      = i_size;
+  mask_id_   = mask_id;
+  age_       = 0;
+  valid_     = true;
+}
+
+void uvdar::SunCache::record(bool i_hit, double i_time) {
+  stats_.images++;
+  if (!i_hit) { //the mean time of the full searches, smoothed so that a single slow image does not skew the estimate
+    full_time_ = (full_time_ < 0.0) ? i_time : ((0.9 * full_time_) + (0.1 * i_time));
+    return;
+  }
+  age_++;
+  stats_.hits++;
+  if (full_time_ > i_time) {
+    stats_.time_saved += full_time_ - i_time;
+  }
+}
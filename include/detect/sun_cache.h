@@ -0,0 +1,108 @@
+#ifndef SUN_CACHE_H
+#define SUN_CACHE_H
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+namespace uvdar {
+
+  /**
+   * @brief Statistics of reusing the sun found in an earlier image
+   */
+  struct SunCacheStats {
+    unsigned long images = 0; ///< the images processed with the sun caching enabled
+    unsigned long hits = 0;   ///< the images that reused the cached sun instead of searching for it
+    double time_saved = 0.0;  ///< the estimated processing time saved by the hits, in milliseconds - the difference of each hit from the mean time of the images with a full search
+  };
+
+  /**
+   * @brief The bookkeeping of the sun caching shared by the detector backends - the sun points of the last full search, the conditions for reusing them and the statistics of the reuse
+   */
+  class SunCache {
+    public:
+
+      /**
+       * @brief Sets the parameters of the caching, drops the cache and resets the statistics
+       *
+       * @param i_refresh_period The number of images a cached sun may be used for, 0 to disable the caching
+       * @param i_max_change The largest relative change of the number of saturated pixels of the cached sun before it is refreshed
+       */
+      void configure(int i_refresh_period, double i_max_change);
+
+      /**
+       * @brief True if the caching is enabled
+       */
+      bool enabled() const {
+        return (period_ > 0);
+      }
+
+      /**
+       * @brief Drops the cached sun, so that the next image is searched fully - e.g. when the thresholds change and the sun found with the old ones may differ
+       */
+      void invalidate() {
+        valid_ = false;
+      }
+
+      /**
+       * @brief Checks whether the cached sun may be used for the current image - i.e. it was found in an image of the same size and with the same mask at most the refresh period of images ago
+       *
+       * @param i_size The size of the current image
+       * @param mask_id The mask used for the current image
+       */
+      bool usable(cv::Size i_size, int mask_id) const;
+
+      /**
+       * @brief Checks whether the number of saturated pixels of the cached sun changed too much for the cache to be used
+       *
+       * @param i_saturated The number of saturated pixels counted in the current image the same way as for store
+       */
+      bool changed(int i_saturated) const;
+
+      /**
+       * @brief Stores the sun found by a full search
+       *
+       * @param sun_points The sun points of the image
+       * @param i_saturated The number of saturated pixels of the sun, compared by changed in the following images
+       * @param i_size The size of the image
+       * @param mask_id The mask used for the image
+       */
+      void store(const std::vector<cv::Point2i>& sun_points, int i_saturated, cv::Size i_size, int mask_id);
+
+      /**
+       * @brief The sun points of the last full search
+       */
+      const std::vector<cv::Point2i>& points() const {
+        return points_;
+      }
+
+      /**
+       * @brief Updates the statistics with a processed image
+       *
+       * @param i_hit True if the cached sun was used
+       * @param i_time The processing time of the image, in milliseconds
+       */
+      void record(bool i_hit, double i_time);
+
+      /**
+       * @brief The statistics of the caching since it was configured
+       */
+      const SunCacheStats& stats() const {
+        return stats_;
+      }
+
+    private:
+
+      int period_ = 0;
+      double max_change_ = 0.0;
+      bool valid_ = false;
+      std::vector<cv::Point2i> points_;
+      int saturated_ = 0;
+      cv::Size size_;
+      int mask_id_ = -1;
+      int age_ = 0; //the number of images that used the cache since the last full search
+      double full_time_ = -1.0;
+      SunCacheStats stats_;
+  };
+}
+
+#endif  // SUN_CACHE_H
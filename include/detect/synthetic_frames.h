@@ -0,0 +1,149 @@
+#ifndef SYNTHETIC_FRAMES_H
+#define SYNTHETIC_FRAMES_H
+
+#include <opencv2/core/core.hpp>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "marker_clusters.h"
+
+/*
+ * Building blocks of synthetic UV camera frames - the markers and sun discs drawn by the detector tests and by uvdar_detector_benchmark, and the raw marker points of the GPU detector
+ */
+
+namespace uvdar {
+  namespace synthetic {
+
+    /**
+     * @brief A uniform background with uniform noise of the given amplitude
+     */
+    inline cv::Mat background(cv::Size size, int level, int noise, std::mt19937& rng) {
+      cv::Mat frame(size, CV_8UC1);
+      std::uniform_int_distribution<int> offset(0, std::max(noise, 0));
+      for (size_t i = 0; i < frame.total(); i++) {
+        frame.data[i] = (unsigned char)(std::clamp(level + offset(rng), 0, 255));
+      }
+      return frame;
+    }
+
+    /**
+     * @brief Draws a small Gaussian spot, as a marker appears in the image - a radius of 0 draws a single pixel
+     */
+    inline void drawMarker(cv::Mat& frame, cv::Point center, int peak, int radius) {
+      double sigma = 0.5 + (radius / 2.0);
+      int reach = (radius > 0) ? (radius + 1) : 0;
+      for (int dy = -reach; dy <= reach; dy++) {
+        for (int dx = -reach; dx <= reach; dx++) {
+          int x = center.x + dx;
+          int y = center.y + dy;
+          if ((x < 0) || (x >= frame.cols) || (y < 0) || (y >= frame.rows)) {
+            continue;
+          }
+          int value = (int)(peak * std::exp(-((dx * dx) + (dy * dy)) / (2.0 * sigma * sigma)));
+          unsigned char& pixel = frame.data[(y * frame.cols) + x];
+          pixel = (unsigned char)(std::max((int)(pixel), value));
+        }
+      }
+    }
+
+    /**
+     * @brief Draws a saturated disc with glare fading out to 1.5 times its radius, as the sun appears in the image
+     */
+    inline void drawSun(cv::Mat& frame, cv::Point center, int radius) {
+      double glare = radius * 1.5;
+      int reach = (int)(std::ceil(glare));
+      for (int dy = -reach; dy <= reach; dy++) {
+        for (int dx = -reach; dx <= reach; dx++) {
+          int x = center.x + dx;
+          int y = center.y + dy;
+          if ((x < 0) || (x >= frame.cols) || (y < 0) || (y >= frame.rows)) {
+            continue;
+          }
+          double distance = std::sqrt((double)((dx * dx) + (dy * dy)));
+          if (distance > glare) {
+            continue;
+          }
+          int value = (distance <= radius) ? 255 : (int)(255.0 * (glare - distance) / (glare - radius));
+          unsigned char& pixel = frame.data[(y * frame.cols) + x];
+          pixel = (unsigned char)(std::max((int)(pixel), value));
+        }
+      }
+    }
+
+    /**
+     * @brief A mask with the given fraction of randomly invalid pixels, and optionally an invalid left third of the image
+     */
+    inline cv::Mat mask(cv::Size size, double invalid, bool left_third, std::mt19937& rng) {
+      cv::Mat result(size, CV_8UC1);
+      std::bernoulli_distribution drop(invalid);
+      for (int j = 0; j < size.height; j++) {
+        for (int i = 0; i < size.width; i++) {
+          result.data[(j * size.width) + i] = ((left_third && (i < (size.width / 3))) || drop(rng)) ? 0 : 255;
+        }
+      }
+      return result;
+    }
+
+    /**
+     * @brief Generates raw marker points as the GPU detector finds them - the pixels of markers of various sizes, closely packed groups of markers, points on the image borders and repeated points, all in a random order
+     *
+     * @param hit_count The number of the points
+     * @param size The size of the image
+     * @param distance The merging distance - the markers of a group lie closer than this to each other
+     * @param o_hits Output - the points
+     */
+    inline void markerHits(int hit_count, cv::Size size, int distance, std::mt19937& rng, std::vector<fast_det_pt_t>& o_hits) {
+      std::uniform_int_distribution<int> x_dist(0, size.width - 1);
+      std::uniform_int_distribution<int> y_dist(0, size.height - 1);
+      std::uniform_int_distribution<int> kind_dist(0, 9);
+      std::uniform_int_distribution<int> radius_dist(0, 3);
+      std::uniform_int_distribution<int> shift_dist(-distance, distance);
+
+      auto add = [&](int x, int y) {
+        if (((int)(o_hits.size()) < hit_count) && (x >= 0) && (x < size.width) && (y >= 0) && (y < size.height)) {
+          o_hits.push_back({(uint16_t)(y), (uint16_t)(x)});
+        }
+      };
+
+      o_hits.clear();
+      while ((int)(o_hits.size()) < hit_count) {
+        int kind = kind_dist(rng);
+        cv::Point center(x_dist(rng), y_dist(rng));
+        if (kind == 0) { //on a border of the image
+          if ((rng() % 2) == 0) {
+            center.x = ((rng() % 2) == 0) ? 0 : (size.width - 1);
+          } else {
+            center.y = ((rng() % 2) == 0) ? 0 : (size.height - 1);
+          }
+        }
+        int markers = (kind <= 2) ? 1 : ((kind <= 5) ? 2 : 1 + (int)(rng() % 5)); //groups of markers closer than the merging distance
+        for (int m = 0; m < markers; m++) {
+          cv::Point marker = (m == 0) ? center : cv::Point(center.x + shift_dist(rng), center.y + shift_dist(rng));
+          int radius = radius_dist(rng);
+          for (int dy = -radius; dy <= radius; dy++) {
+            for (int dx = -radius; dx <= radius; dx++) {
+              if (((dx * dx) + (dy * dy)) <= (radius * radius)) {
+                add(marker.x + dx, marker.y + dy);
+              }
+            }
+          }
+          if (kind == 9) { //the same point found repeatedly
+            add(marker.x, marker.y);
+          }
+        }
+      }
+      std::shuffle(o_hits.begin(), o_hits.end(), rng); //the GPU appends the points in no particular order
+    }
+
+    /**
+     * @brief Sorts points in the raster order, for comparing the outputs of detectors that may list them differently
+     */
+    inline std::vector<cv::Point2i> sorted(std::vector<cv::Point2i> points) {
+      std::sort(points.begin(), points.end(), [](const cv::Point2i& a, const cv::Point2i& b) { return (a.y < b.y) || ((a.y == b.y) && (a.x < b.x)); });
+      return points;
+    }
+  }
+}
+
+#endif  // SYNTHETIC_FRAMES_H
@@ -0,0 +1,100 @@
+#ifndef THRESHOLD_CONTROLLER_H
+#define THRESHOLD_CONTROLLER_H
+
+#include <algorithm>
+
+namespace uvdar {
+
+  /**
+   * @brief Adjusts the detection thresholds of a single camera to keep the number of retrieved points and the processing time within a budget
+   *        The thresholds are raised by a step after a number of consecutive images over the budget, and lowered back towards their nominal values after the same number of consecutive images below half of the budget. Between these, the thresholds are kept, so that they do not oscillate and make the markers flicker
+   */
+  class ThresholdController {
+    public:
+
+      /**
+       * @brief Configuration of the controller
+       */
+      struct Params {
+        int threshold;          ///< the nominal threshold for considering a pixel for a FAST test - also the lowest one used
+        int threshold_max;      ///< the highest threshold used
+        int threshold_diff;     ///< the nominal threshold difference between a bright point and its surroundings - also the lowest one used
+        int threshold_diff_max; ///< the highest threshold difference used
+        int step;               ///< the change of the thresholds in a single adjustment
+        int max_points;         ///< the largest number of points per image within the budget
+        double max_time;        ///< the longest processing time per image within the budget, in milliseconds
+        int hysteresis_images;  ///< the number of consecutive images outside of the budget needed for an adjustment
+      };
+
+      /**
+       * @brief The direction of the last adjustment
+       */
+      enum class Adjustment {
+        NONE,
+        RAISED,
+        LOWERED
+      };
+
+      explicit ThresholdController(const Params& i_params) : params_(i_params) {
+        params_.threshold_max      = std::max(params_.threshold_max, params_.threshold);
+        params_.threshold_diff_max = std::max(params_.threshold_diff_max, params_.threshold_diff);
+        params_.step               = std::max(params_.step, 1);
+        params_.hysteresis_images  = std::max(params_.hysteresis_images, 1);
+      }
+
+      /**
+       * @brief Updates the controller with the outcome of an image
+       *
+       * @param i_point_count The number of points retrieved from the image, including the ones not published due to an overload
+       * @param i_time The time spent on the detection, in milliseconds
+       *
+       * @return The adjustment of the thresholds made due to this image
+       */
+      Adjustment update(int i_point_count, double i_time) {
+        bool over  = (i_point_count > params_.max_points) || (i_time > params_.max_time);
+        bool under = (i_point_count < (params_.max_points / 2)) && (i_time < (params_.max_time / 2));
+
+        images_over_  = over ? (images_over_ + 1) : 0;
+        images_under_ = under ? (images_under_ + 1) : 0;
+
+        if ((images_over_ >= params_.hysteresis_images) && !atMaximum()) {
+          level_++;
+          images_over_ = 0;
+          return Adjustment::RAISED;
+        }
+        if ((images_under_ >= params_.hysteresis_images) && (level_ > 0)) {
+          level_--;
+          images_under_ = 0;
+          return Adjustment::LOWERED;
+        }
+        return Adjustment::NONE;
+      }
+
+      /**
+       * @brief The current threshold for considering a pixel for a FAST test
+       */
+      int getThreshold() const {
+        return std::min(params_.threshold + (level_ * params_.step), params_.threshold_max);
+      }
+
+      /**
+       * @brief The current threshold difference between a bright point and its surroundings
+       */
+      int getThresholdDiff() const {
+        return std::min(params_.threshold_diff + (level_ * params_.step), params_.threshold_diff_max);
+      }
+
+    private:
+
+      bool atMaximum() const {
+        return (getThreshold() >= params_.threshold_max) && (getThresholdDiff() >= params_.threshold_diff_max);
+      }
+
+      Params params_;
+      int level_        = 0; //the number of steps above the nominal thresholds
+      int images_over_  = 0;
+      int images_under_ = 0;
+  };
+}
+
+#endif  // THRESHOLD_CONTROLLER_H
@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "uv_led_detect_blob.h"
+
+//the distance of the points sampled around a component from its bounding box - the same as the radius of the smaller FAST ring
+#define RING_MARGIN 3
+//the spacing of the points retrieved from a component considered to be the sun - small enough for the glare filtering to cover the whole component
+#define SUN_POINT_SPACING 15
+
+/* anyBright //{ */
+//checks 8 pixels at once whether any of them is brighter than the threshold. For thresholds over 127, only the top bits are checked, so the result may be a false positive - the caller checks the pixels one by one then
+static inline bool anyBright(const unsigned char* pixels, unsigned char threshold) {
+  const uint64_t ones = 0x0101010101010101ull;
+  const uint64_t tops = 0x8080808080808080ull;
+  uint64_t word;
+  std::memcpy(&word, pixels, sizeof(word));
+  if (threshold > 127) {
+    return (word & tops) != 0;
+  }
+  //if no byte has its top bit set, adding (127 - threshold) to each of them cannot carry over to the next byte, and sets the top bit exactly where the byte was brighter than the threshold
+  return (((word + (ones * (uint64_t)(127 - threshold))) | word) & tops) != 0;
+}
+//}
+
+uvdar::UVDARLedDetectBlob::UVDARLedDetectBlob(bool i_gui, bool i_debug, int i_threshold, int i_threshold_diff, int i_threshold_sun, std::vector<cv::Mat> i_masks) : UVDARLedDetectFAST(i_gui, i_debug, i_threshold, i_threshold_diff, i_threshold_sun, i_masks) {
+}
+
+void uvdar::UVDARLedDetectBlob::setAreaLimits(int i_max_marker_area, int i_min_sun_area) {
+  max_marker_area_ = std::max(i_max_marker_area, 1);
+  min_sun_area_    = std::max(i_min_sun_area, 1);
+  if (_debug_) {
+    std::cout << "[UVDARDetectorBlob]: Largest marker: " << max_marker_area_ << " px, smallest sun: " << min_sun_area_ << " px" << std::endl;
+  }
+}
+
+bool uvdar::UVDARLedDetectBlob::processImage(const cv::Mat i_image, std::vector<cv::Point2i>& detected_points, std::vector<cv::Point2i>& sun_points, int mask_id) {
+  detected_points = std::vector<cv::Point2i>();
+  sun_points      = std::vector<cv::Point2i>();
+  image_curr_     = i_image;
+
+  const RowSpans* spans = nullptr;
+  if (mask_id >= 0) {
+    if (mask_id >= (int)(masks_.size())) {
+      std::cerr << "[UVDARDetectorBlob]: Mask index " << mask_id << " is greater than the current number of loaded masks!" << std::endl;
+      return false;
+    }
+    if (image_curr_.size() != masks_[mask_id].size()) {
+      std::cerr << "[UVDARDetectorBlob]: The size of the selected mask does not match the current image!" << std::endl;
+      return false;
+    }
+    spans = &mask_spans_[mask_id];
+  }
+
+  runs_.clear();
+  parent_.clear();
+  stats_.clear();
+
+  //single pass labelling - the runs of each row are connected to the overlapping (8-connected) runs of the previous row as soon as they are found, and the properties of the components are accumulated on the way
+  int prev_begin = 0;
+  int prev_end   = 0;
+  for (int j = 0; j < image_curr_.rows; j++) {
+    const unsigned char* row = image_curr_.data + (j * image_curr_.cols);
+    int row_begin = (int)(runs_.size());
+    if (spans != nullptr) {
+      for (const ColumnSpan* span = spans->begin(j); span != spans->end(j); span++) {
+        findRuns(row, j, span->begin, span->end);
+      }
+    } else {
+      findRuns(row, j, 0, image_curr_.cols);
+    }
+
+    //both lists of runs are sorted, so the previous row is walked only once
+    int p = prev_begin;
+    for (int c = row_begin; c < (int)(runs_.size()); c++) {
+      Run& run = runs_[c];
+      while ((p < prev_end) && (runs_[p].end < run.begin)) {
+        p++;
+      }
+      int label = -1;
+      for (int q = p; (q < prev_end) && (runs_[q].begin <= run.end); q++) {
+        label = (label < 0) ? findRoot(runs_[q].label) : merge(label, runs_[q].label);
+      }
+      if (label < 0) {
+        run.label = newLabel(row, run);
+      } else {
+        run.label = label;
+        addRun(label, row, run);
+      }
+    }
+    prev_begin = row_begin;
+    prev_end   = (int)(runs_.size());
+  }
+
+  //classify the components - the labels are created in the raster order, so the points are retrieved in the order of the top left pixels of the components
+  is_sun_.assign(parent_.size(), 0);
+  candidate_count_ = 0;
+  for (int l = 0; l < (int)(parent_.size()); l++) {
+    if (parent_[l] != l) {
+      continue;
+    }
+    const BlobStats& blob = stats_[l];
+    if ((blob.area >= min_sun_area_) && ((2 * blob.saturated) >= blob.area)) {
+      is_sun_[l] = 1;
+      continue;
+    }
+    candidate_count_++;
+    if ((blob.area > max_marker_area_) || !isConcentrated(blob)) {
+      continue;
+    }
+    detected_points.push_back(cv::Point2i((int)(std::lround(blob.sum_weight_x / blob.sum_weight)), (int)(std::lround(blob.sum_weight_y / blob.sum_weight))));
+  }
+
+  //the sun is represented by points sampled over its whole area, so that the glare filtering covers all of it
+  for (auto& run : runs_) {
+    int root = findRoot(run.label);
+    if (!is_sun_[root] || (((run.row - stats_[root].y_min) % SUN_POINT_SPACING) != 0)) {
+      continue;
+    }
+    for (int i = run.begin; i < run.end; i += SUN_POINT_SPACING) {
+      sun_points.push_back(cv::Point2i(i, run.row));
+    }
+  }
+
+  point_limit_.filterGlare(detected_points, sun_points, image_curr_.size());
+
+  point_limit_.start(image_curr_.size());
+  if (point_limit_.check(detected_points, sun_points)) {
+    detected_points.clear();
+  }
+
+  return true;
+}
+
+void uvdar::UVDARLedDetectBlob::findRuns(const unsigned char* row, int j, int begin, int end) {
+  int i = begin;
+  while (i < end) {
+    if (((i + 8) <= end) && !anyBright(row + i, _threshold_)) { //most of the image is dark, so it is skipped by whole words
+      i += 8;
+      continue;
+    }
+    if (row[i] <= _threshold_) {
+      i++;
+      continue;
+    }
+    int run_begin = i;
+    while ((i < end) && (row[i] > _threshold_)) {
+      i++;
+    }
+    runs_.push_back({j, run_begin, i, -1});
+  }
+}
+
+int uvdar::UVDARLedDetectBlob::newLabel(const unsigned char* row, const Run& run) {
+  int label = (int)(parent_.size());
+  parent_.push_back(label);
+  stats_.push_back({0.0, 0.0, 0.0, 0, 0, 0, run.begin, run.end - 1, run.row, run.row});
+  addRun(label, row, run);
+  return label;
+}
+
+void uvdar::UVDARLedDetectBlob::addRun(int label, const unsigned char* row, const Run& run) {
+  BlobStats& blob = stats_[label];
+  for (int i = run.begin; i < run.end; i++) {
+    double weight = row[i] - _threshold_; //brighter pixels pull the centroid more
+    blob.sum_weight   += weight;
+    blob.sum_weight_x += weight * i;
+    blob.sum_weight_y += weight * run.row;
+    blob.peak = std::max(blob.peak, row[i]);
+    if (row[i] > _threshold_sun_) {
+      blob.saturated++;
+    }
+  }
+  blob.area += run.end - run.begin;
+  blob.x_min = std::min(blob.x_min, run.begin);
+  blob.x_max = std::max(blob.x_max, run.end - 1);
+  blob.y_min = std::min(blob.y_min, run.row);
+  blob.y_max = std::max(blob.y_max, run.row);
+}
+
+int uvdar::UVDARLedDetectBlob::findRoot(int label) {
+  int root = label;
+  while (parent_[root] != root) {
+    root = parent_[root];
+  }
+  while (parent_[label] != root) {
+    int next = parent_[label];
+    parent_[label] = root;
+    label = next;
+  }
+  return root;
+}
+
+int uvdar::UVDARLedDetectBlob::merge(int a, int b) {
+  a = findRoot(a);
+  b = findRoot(b);
+  if (a == b) {
+    return a;
+  }
+  if (b < a) { //the older label is kept, so that the order of the components follows their top left pixels
+    std::swap(a, b);
+  }
+  parent_[b] = a;
+  BlobStats& target = stats_[a];
+  const BlobStats& source = stats_[b];
+  target.sum_weight   += source.sum_weight;
+  target.sum_weight_x += source.sum_weight_x;
+  target.sum_weight_y += source.sum_weight_y;
+  target.area         += source.area;
+  target.saturated    += source.saturated;
+  target.peak          = std::max(target.peak, source.peak);
+  target.x_min         = std::min(target.x_min, source.x_min);
+  target.x_max         = std::max(target.x_max, source.x_max);
+  target.y_min         = std::min(target.y_min, source.y_min);
+  target.y_max         = std::max(target.y_max, source.y_max);
+  return a;
+}
+
+bool uvdar::UVDARLedDetectBlob::isConcentrated(const BlobStats& blob) const {
+  //eight points around the bounding box - its corners and the middles of its sides, moved out by RING_MARGIN. Points outside of the image are skipped
+  int xs[3] = {blob.x_min - RING_MARGIN, (blob.x_min + blob.x_max) / 2, blob.x_max + RING_MARGIN};
+  int ys[3] = {blob.y_min - RING_MARGIN, (blob.y_min + blob.y_max) / 2, blob.y_max + RING_MARGIN};
+  int tested = 0;
+  for (int m = 0; m < 3; m++) {
+    for (int n = 0; n < 3; n++) {
+      if ((m == 1) && (n == 1)) {
+        continue;
+      }
+      int x = xs[n];
+      int y = ys[m];
+      if ((x < 0) || (x >= image_curr_.cols) || (y < 0) || (y >= image_curr_.rows)) {
+        continue;
+      }
+      if ((blob.peak - image_curr_.data[(y * image_curr_.cols) + x]) < _threshold_diff_) {
+        return false;
+      }
+      tested++;
+    }
+  }
+  return tested > 0;
+}
@@ -0,0 +1,101 @@
+#ifndef UV_LED_DETECT_BLOB_H
+#define UV_LED_DETECT_BLOB_H
+
+#include "uv_led_detect_fast.h"
+
+namespace uvdar {
+
+  /**
+   * @brief Marker detection based on connected components of bright pixels instead of the FAST test. The image is labelled in a single pass over run-length encoded rows, so the cost depends on the number of bright pixels only, not on the size of the markers
+   *        A component is a marker if its brightest pixel is brighter than the surroundings of the component by the threshold difference - the surroundings are sampled just outside of the bounding box of the component, so large (close) markers are found as well as single-pixel (distant) ones
+   *        Large components with mostly saturated pixels are considered to be the sun
+   */
+  class UVDARLedDetectBlob : public UVDARLedDetectFAST {
+    public:
+      UVDARLedDetectBlob(bool i_gui, bool i_debug, int i_threshold, int i_threshold_diff, int i_threshold_sun, std::vector<cv::Mat> i_masks);
+      bool processImage(const cv::Mat i_image, std::vector<cv::Point2i>& detected_points, std::vector<cv::Point2i>& sun_points, int mask_id=-1);
+      void setPointLimit(int i_max_points, bool i_tile_budget) { point_limit_.setLimit(i_max_points, i_tile_budget); }
+      const DetectionOverload& getOverload() const { return point_limit_.overload(); }
+      int getCandidateCount() const { return candidate_count_; }
+
+      /**
+       * @brief Sets the size limits of the components
+       *
+       * @param i_max_marker_area Components with more pixels than this are not considered to be markers
+       * @param i_min_sun_area Components with at least this many pixels, mostly brighter than the sun threshold, are considered to be the sun
+       */
+      void setAreaLimits(int i_max_marker_area, int i_min_sun_area);
+
+    private:
+
+      /**
+       * @brief A run of bright pixels within a single image row
+       */
+      struct Run {
+        int row;
+        int begin; ///< the first column
+        int end;   ///< one past the last column
+        int label; ///< the component the run was assigned to when it was found - may have been merged into another one since
+      };
+
+      /**
+       * @brief Accumulated properties of a component
+       */
+      struct BlobStats {
+        double sum_weight;
+        double sum_weight_x;
+        double sum_weight_y;
+        int area;
+        int saturated;     ///< the number of pixels brighter than the sun threshold
+        unsigned char peak;
+        int x_min, x_max, y_min, y_max;
+      };
+
+      /**
+       * @brief Appends the runs of bright pixels of a row within the columns [begin, end)
+       */
+      void findRuns(const unsigned char* row, int j, int begin, int end);
+
+      /**
+       * @brief Creates a new component from a run
+       */
+      int newLabel(const unsigned char* row, const Run& run);
+
+      /**
+       * @brief Adds the pixels of a run to an existing component
+       */
+      void addRun(int label, const unsigned char* row, const Run& run);
+
+      /**
+       * @brief Finds the component a label was merged into, with path compression
+       */
+      int findRoot(int label);
+
+      /**
+       * @brief Merges two components
+       *
+       * @return The label of the merged component
+       */
+      int merge(int a, int b);
+
+      /**
+       * @brief Checks whether the brightest pixel of a component is brighter than its surroundings by the threshold difference
+       */
+      bool isConcentrated(const BlobStats& blob) const;
+
+      cv::Mat image_curr_;
+
+      std::vector<Run> runs_;
+      std::vector<int> parent_;
+      std::vector<BlobStats> stats_;
+      std::vector<unsigned char> is_sun_;
+
+      int max_marker_area_ = 400;
+      int min_sun_area_    = 100;
+
+      PointLimit point_limit_;
+      int candidate_count_ = 0; //the components of the last image that were not the sun, before the marker tests
+  };
+}
+
+#endif  // UV_LED_DETECT_BLOB_H
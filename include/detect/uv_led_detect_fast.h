@@ -2,7 +2,12 @@
 #define UV_LED_FAST_H
 
 #include <opencv2/core/core.hpp>
+#include <algorithm>
+#include <cstdlib>
 #include <memory>
+#include "point_limit.h"
+#include "sun_cache.h"
+#include "row_spans.h"
 /* #include <opencv2/features2d/features2d.hpp> */
 /* #include <opencv2/video/tracking.hpp> */
 
@@ -37,6 +42,8 @@ namespace uvdar {
           }
       };
 
+      virtual ~UVDARLedDetectFAST() = default;
+
       /**
        * @brief Adds an image matrix used for masking out portions of the input stream
        *
@@ -45,6 +52,8 @@ namespace uvdar {
       void addMask(cv::Mat i_mask)
       {
          masks_.push_back(i_mask);
+         mask_spans_.emplace_back();
+         mask_spans_.back().buildFromMask(i_mask); //the run-length form is prepared once here, so that the detection can skip the masked out sections entirely
       }
 
       /**
@@ -59,15 +68,136 @@ namespace uvdar {
        * @return 
        */
       virtual bool processImage(const cv::Mat i_image, std::vector<cv::Point2i>& detected_points, std::vector<cv::Point2i>& sun_points, int mask_id=-1) = 0;
+
+      /**
+       * @brief Retrieves bright, concentrated points only from the given regions of the input image. The surroundings of the regions are still used for the tests, so points inside the regions are retrieved the same as by processImage
+       *        Inheriting classes that cannot restrict the search process the whole image instead
+       *
+       * @param i_image The input image
+       * @param i_regions The regions to search in - may overlap and reach outside of the image
+       * @param detected_points The retrieved bright points
+       * @param sun_points Points presumed to correspond with directly observed sun in the image - searched in the whole image, so that the glare filtering and the published sun are the same as with processImage. Only bright pixels hidden by the non-maxima suppression of the markers outside of the regions (which are not searched for) may additionally join the sun
+       * @param mask_id The index of the mask (previously added) to use for discarding sections of the input image
+       *
+       * @return Success
+       */
+      virtual bool processImageRegions(const cv::Mat i_image, const std::vector<cv::Rect>& i_regions, std::vector<cv::Point2i>& detected_points, std::vector<cv::Point2i>& sun_points, int mask_id=-1) {
+        (void)(i_regions);
+        return processImage(i_image, detected_points, sun_points, mask_id);
+      }
+
+      /**
+       * @brief Enables or disables the temporal mode. In this mode, the brightest and the darkest recent value of each pixel are kept, both decaying towards the current value with each image. Marker points are then only retrieved from the pixels with a large enough difference between these - i.e. pixels that recently changed their brightness, such as blinking or moving markers. Static bright objects, such as lamps or reflections, are left out. The sun points are retrieved as in the normal mode
+       *        Inheriting classes that do not support the temporal mode keep the normal mode
+       *
+       * @param i_enabled If true, the temporal mode is used. Enabling it starts a new history
+       * @param i_decay The decay of the brightest and the darkest values with each image - a change of brightness is remembered for about (change / i_decay) images
+       * @param i_min_change The smallest difference between the brightest and the darkest value of a pixel for it to be considered changing
+       *
+       * @return True if the mode is supported
+       */
+      virtual bool setTemporalMode(bool i_enabled, int i_decay, int i_min_change) {
+        (void)(i_decay);
+        (void)(i_min_change);
+        return !i_enabled;
+      }
+
+      /**
+       * @brief Enables or disables the sun caching. The sun (and its glare) moves slowly compared to the camera rate, so the sun points of an image are kept and reused for the following images instead of searching for them again. The cache is refreshed by a full search after i_refresh_period images, or sooner if the number of saturated pixels of the cached sun changes by more than i_max_change of its original value
+       *        Inheriting classes that do not support the caching search for the sun in every image
+       *
+       * @param i_refresh_period The number of images a cached sun may be used for, 0 to disable the caching
+       * @param i_max_change The largest relative change of the number of saturated pixels of the cached sun before it is refreshed
+       *
+       * @return True if the caching is supported
+       */
+      virtual bool setSunCache(int i_refresh_period, double i_max_change) {
+        (void)(i_max_change);
+        return (i_refresh_period <= 0);
+      }
+
+      /**
+       * @brief Sets the number of images being processed at once. With more than one, processImage only starts the processing of the given image and retrieves the points of the image given (i_depth - 1) calls earlier - the processing of each image then overlaps with the transfer of the following ones, at the cost of this latency. The images still being processed are discarded
+       *        Inheriting classes that do not support the pipelining process each image before returning
+       *
+       * @param i_depth The number of images being processed at once, 1 to retrieve the points of each image right away
+       *
+       * @return True if the depth is supported
+       */
+      virtual bool setPipelineDepth(int i_depth) {
+        return (i_depth <= 1);
+      }
+
+      /**
+       * @brief The number of processImage calls by which the retrieved points lag behind the input images. The calls before the pipeline is filled retrieve no points
+       *
+       * @return The latency, in images
+       */
+      virtual int getResultDelay() const {
+        return 0;
+      }
+
+      /**
+       * @brief Retrieves the statistics of the sun caching since it was enabled
+       *        Inheriting classes that do not support the caching report no images
+       *
+       * @return The statistics
+       */
+      virtual const SunCacheStats& getSunCacheStats() const {
+        static const SunCacheStats no_stats;
+        return no_stats;
+      }
+
+      /**
+       * @brief Changes the detection thresholds. Takes effect from the next processed image
+       *
+       * @param i_threshold The threshold for even considering a pixel for a FAST test
+       * @param i_threshold_diff The threshold difference between a bright point and its surroundings used in selecting pixels representing the markers
+       * @param i_threshold_sun The threshold for even considering a pixel to be a part of the sun
+       */
+      virtual void setThresholds(int i_threshold, int i_threshold_diff, int i_threshold_sun) {
+        _threshold_        = (unsigned char)(std::clamp(i_threshold, 0, 255));
+        _threshold_diff_   = (unsigned char)(std::clamp(i_threshold_diff, 0, 255));
+        _threshold_sun_    = (unsigned char)(std::clamp(i_threshold_sun, 0, 255));
+        thresholds_changed_ = true;
+      }
+
+      /**
+       * @brief Limits the number of marker points retrieved from a single image. Images with more points are not usable, so the detection may stop as soon as the limit is exceeded instead of processing the rest of the image - see PointLimit::setLimit
+       *        Must be overriden by inheriting class
+       *
+       * @param i_max_points The largest usable number of marker points, 0 for no limit
+       * @param i_tile_budget If true, the image is not abandoned when the limit is exceeded - instead, the tiles of the image exceeding their share of the limit are dropped
+       */
+      virtual void setPointLimit(int i_max_points, bool i_tile_budget) = 0;
+
+      /**
+       * @brief Retrieves the overload information of the last processed image
+       *        Must be overriden by inheriting class
+       *
+       * @return The overload of the last image - its member overloaded is false if the limit was not exceeded
+       */
+      virtual const DetectionOverload& getOverload() const = 0;
+
+      /**
+       * @brief Retrieves the number of raw marker candidates of the last processed image - the points that passed the test of the backend, before their merging, non-maxima suppression and glare filtering
+       *        Must be overriden by inheriting class
+       *
+       * @return The number of candidates - the ratio to the retrieved points shows how much of the work is spent on suppressed points
+       */
+      virtual int getCandidateCount() const = 0;
     
     protected:
+
       bool _debug_;
       bool _gui_;
       unsigned char _threshold_;
       unsigned char _threshold_diff_;
       unsigned char _threshold_sun_;
+      bool thresholds_changed_ = false; //set by setThresholds, for inheriting classes that need to pass the thresholds on
 
       std::vector<cv::Mat> masks_;
+      std::vector<RowSpans> mask_spans_; //spans of the valid (non-zero) pixels of each mask
   };
 }
 
@@ -1,6 +1,9 @@
 #include <dirent.h>
 #include <algorithm>
+#include <chrono>
+#include <functional>
 #include <iostream>
+#include <iterator>
 #include <mutex>
 #include <thread>
 #include <utility>
@@ -8,15 +11,235 @@
 
 #include "uv_led_detect_fast_cpu.h"
 
+#if defined(UVDAR_DETECT_SIMD) && (defined(__x86_64__) || defined(__i386__))
+#define UVDAR_DETECT_SIMD_X86
+#include <immintrin.h>
+#endif
+
 //addressing indices this way is noticeably faster than the "propper" way with .at method - numerous unnecessary checks are skipped. This of course means that we have to do necessary checks ourselves
 #define index2d(X, Y) (image_curr_.cols * (Y) + (X))
 
+/* row pre-scan kernels //{ */
+static int prescanRowScalar(const unsigned char* row, int begin, int end, unsigned char threshold, int* candidates) {
+  int count = 0;
+  for (int i = begin; i < end; i++) {
+    if (row[i] > threshold) {
+      candidates[count++] = i;
+    }
+  }
+  return count;
+}
+
+#ifdef UVDAR_DETECT_SIMD_X86
+static int prescanRowSSE2(const unsigned char* row, int begin, int end, unsigned char threshold, int* candidates) {
+  const __m128i thr  = _mm_set1_epi8((char)(threshold));
+  const __m128i zero = _mm_setzero_si128();
+  int count = 0;
+  int i = begin;
+  for (; i + 16 <= end; i += 16) {
+    __m128i pixels   = _mm_loadu_si128((const __m128i*)(row + i));
+    __m128i rejected = _mm_cmpeq_epi8(_mm_subs_epu8(pixels, thr), zero); //saturated subtraction yields zero exactly where the pixel is not brighter than the threshold
+    unsigned int bits = (~(unsigned int)(_mm_movemask_epi8(rejected))) & 0xFFFFu;
+    while (bits) { //emit the surviving columns in ascending order
+      candidates[count++] = i + __builtin_ctz(bits);
+      bits &= bits - 1;
+    }
+  }
+  return count + prescanRowScalar(row, i, end, threshold, candidates + count);
+}
+
+__attribute__((target("avx2")))
+static int prescanRowAVX2(const unsigned char* row, int begin, int end, unsigned char threshold, int* candidates) {
+  const __m256i thr  = _mm256_set1_epi8((char)(threshold));
+  const __m256i zero = _mm256_setzero_si256();
+  int count = 0;
+  int i = begin;
+  for (; i + 32 <= end; i += 32) {
+    __m256i pixels   = _mm256_loadu_si256((const __m256i*)(row + i));
+    __m256i rejected = _mm256_cmpeq_epi8(_mm256_subs_epu8(pixels, thr), zero);
+    unsigned int bits = ~(unsigned int)(_mm256_movemask_epi8(rejected));
+    while (bits) {
+      candidates[count++] = i + __builtin_ctz(bits);
+      bits &= bits - 1;
+    }
+  }
+  _mm256_zeroupper(); //the compiler does not clear the upper register halves in functions compiled for a different target - without this, the legacy SSE instructions of the tail kernel are heavily penalized
+  return count + prescanRowSSE2(row, i, end, threshold, candidates + count);
+}
+#endif
+//}
+
+/* row group pre-screen kernels //{ */
+//these store the columns in [begin, end) where at least one of the four rows is brighter than the threshold - the rows are max-pooled in the registers, so the pooled image is never written out
+static int prescreenRowsScalar(const unsigned char* const* rows, int begin, int end, unsigned char threshold, int* candidates) {
+  int count = 0;
+  for (int i = begin; i < end; i++) {
+    unsigned char pooled = std::max(std::max(rows[0][i], rows[1][i]), std::max(rows[2][i], rows[3][i]));
+    if (pooled > threshold) {
+      candidates[count++] = i;
+    }
+  }
+  return count;
+}
+
+#ifdef UVDAR_DETECT_SIMD_X86
+static int prescreenRowsSSE2(const unsigned char* const* rows, int begin, int end, unsigned char threshold, int* candidates) {
+  const __m128i thr  = _mm_set1_epi8((char)(threshold));
+  const __m128i zero = _mm_setzero_si128();
+  int count = 0;
+  int i = begin;
+  for (; i + 16 <= end; i += 16) {
+    __m128i pooled = _mm_max_epu8(
+        _mm_max_epu8(_mm_loadu_si128((const __m128i*)(rows[0] + i)), _mm_loadu_si128((const __m128i*)(rows[1] + i))),
+        _mm_max_epu8(_mm_loadu_si128((const __m128i*)(rows[2] + i)), _mm_loadu_si128((const __m128i*)(rows[3] + i))));
+    unsigned int bits = (~(unsigned int)(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_subs_epu8(pooled, thr), zero)))) & 0xFFFFu;
+    while (bits) {
+      candidates[count++] = i + __builtin_ctz(bits);
+      bits &= bits - 1;
+    }
+  }
+  return count + prescreenRowsScalar(rows, i, end, threshold, candidates + count);
+}
+
+__attribute__((target("avx2")))
+static int prescreenRowsAVX2(const unsigned char* const* rows, int begin, int end, unsigned char threshold, int* candidates) {
+  const __m256i thr  = _mm256_set1_epi8((char)(threshold));
+  const __m256i zero = _mm256_setzero_si256();
+  int count = 0;
+  int i = begin;
+  for (; i + 32 <= end; i += 32) {
+    __m256i pooled = _mm256_max_epu8(
+        _mm256_max_epu8(_mm256_loadu_si256((const __m256i*)(rows[0] + i)), _mm256_loadu_si256((const __m256i*)(rows[1] + i))),
+        _mm256_max_epu8(_mm256_loadu_si256((const __m256i*)(rows[2] + i)), _mm256_loadu_si256((const __m256i*)(rows[3] + i))));
+    unsigned int bits = ~(unsigned int)(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_subs_epu8(pooled, thr), zero)));
+    while (bits) {
+      candidates[count++] = i + __builtin_ctz(bits);
+      bits &= bits - 1;
+    }
+  }
+  _mm256_zeroupper();
+  return count + prescreenRowsSSE2(rows, i, end, threshold, candidates + count);
+}
+#endif
+//}
+
+/* brightness history kernels //{ */
+//these let the brightest and the darkest recent values of each pixel decay towards each other, and then extend them by the current value
+static void updateHistoryScalar(const unsigned char* image, unsigned char* history_max, unsigned char* history_min, int count, unsigned char decay) {
+  for (int i = 0; i < count; i++) {
+    history_max[i] = std::max(image[i], (unsigned char)(std::max(history_max[i] - decay, 0)));
+    history_min[i] = std::min(image[i], (unsigned char)(std::min(history_min[i] + decay, 255)));
+  }
+}
+
+#ifdef UVDAR_DETECT_SIMD_X86
+static void updateHistorySSE2(const unsigned char* image, unsigned char* history_max, unsigned char* history_min, int count, unsigned char decay) {
+  const __m128i dec = _mm_set1_epi8((char)(decay));
+  int i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i pixels = _mm_loadu_si128((const __m128i*)(image + i));
+    __m128i maxima = _mm_loadu_si128((const __m128i*)(history_max + i));
+    __m128i minima = _mm_loadu_si128((const __m128i*)(history_min + i));
+    _mm_storeu_si128((__m128i*)(history_max + i), _mm_max_epu8(pixels, _mm_subs_epu8(maxima, dec)));
+    _mm_storeu_si128((__m128i*)(history_min + i), _mm_min_epu8(pixels, _mm_adds_epu8(minima, dec)));
+  }
+  updateHistoryScalar(image + i, history_max + i, history_min + i, count - i, decay);
+}
+
+__attribute__((target("avx2")))
+static void updateHistoryAVX2(const unsigned char* image, unsigned char* history_max, unsigned char* history_min, int count, unsigned char decay) {
+  const __m256i dec = _mm256_set1_epi8((char)(decay));
+  int i = 0;
+  for (; i + 32 <= count; i += 32) {
+    __m256i pixels = _mm256_loadu_si256((const __m256i*)(image + i));
+    __m256i maxima = _mm256_loadu_si256((const __m256i*)(history_max + i));
+    __m256i minima = _mm256_loadu_si256((const __m256i*)(history_min + i));
+    _mm256_storeu_si256((__m256i*)(history_max + i), _mm256_max_epu8(pixels, _mm256_subs_epu8(maxima, dec)));
+    _mm256_storeu_si256((__m256i*)(history_min + i), _mm256_min_epu8(pixels, _mm256_adds_epu8(minima, dec)));
+  }
+  _mm256_zeroupper();
+  updateHistorySSE2(image + i, history_max + i, history_min + i, count - i, decay);
+}
+#endif
+//}
+
 uvdar::UVDARLedDetectFASTCPU::UVDARLedDetectFASTCPU(bool i_gui, bool i_debug, int i_threshold, int i_threshold_diff, int i_threshold_sun, std::vector<cv::Mat> i_masks) : UVDARLedDetectFAST(i_gui, i_debug, i_threshold, i_threshold_diff, i_threshold_sun, i_masks) {
-  initFAST();
+  setPrescanKernel(PrescanKernel::AUTO);
+}
+
+uvdar::UVDARLedDetectFASTCPU::PrescanKernel uvdar::UVDARLedDetectFASTCPU::setPrescanKernel(PrescanKernel i_kernel) {
+  prescan_kernel_ = PrescanKernel::SCALAR;
+  prescan_fn_     = prescanRowScalar;
+  prescreen_fn_   = prescreenRowsScalar;
+  history_fn_     = updateHistoryScalar;
+
+#ifdef UVDAR_DETECT_SIMD_X86
+  bool has_avx2 = __builtin_cpu_supports("avx2");
+  bool has_sse2 = __builtin_cpu_supports("sse2");
+  if (i_kernel == PrescanKernel::AUTO) {
+    i_kernel = has_avx2 ? PrescanKernel::AVX2 : (has_sse2 ? PrescanKernel::SSE2 : PrescanKernel::SCALAR);
+  }
+  if ((i_kernel == PrescanKernel::AVX2) && has_avx2) {
+    prescan_kernel_ = PrescanKernel::AVX2;
+    prescan_fn_     = prescanRowAVX2;
+    prescreen_fn_   = prescreenRowsAVX2;
+    history_fn_     = updateHistoryAVX2;
+  }
+  else if ((i_kernel == PrescanKernel::SSE2) && has_sse2) {
+    prescan_kernel_ = PrescanKernel::SSE2;
+    prescan_fn_     = prescanRowSSE2;
+    prescreen_fn_   = prescreenRowsSSE2;
+    history_fn_     = updateHistorySSE2;
+  }
+#endif
+
+  if ((i_kernel != PrescanKernel::AUTO) && (i_kernel != prescan_kernel_)) {
+    std::cerr << "[UVDARDetectorFASTCPU]: The requested pre-scan kernel is not available in this build or on this CPU, using the scalar kernel instead." << std::endl;
+  }
+  if (_debug_) {
+    const char* names[] = {"auto", "scalar", "SSE2", "AVX2"};
+    std::cout << "[UVDARDetectorFASTCPU]: Pre-scan kernel: " << names[(int)(prescan_kernel_)] << std::endl;
+  }
+
+  return prescan_kernel_;
 }
 
 bool uvdar::UVDARLedDetectFASTCPU::processImage(const cv::Mat i_image, std::vector<cv::Point2i>& detected_points, std::vector<cv::Point2i>& sun_points, int mask_id) {
+  return detectPoints(i_image, detected_points, sun_points, mask_id, false);
+}
+
+bool uvdar::UVDARLedDetectFASTCPU::processImageRegions(const cv::Mat i_image, const std::vector<cv::Rect>& i_regions, std::vector<cv::Point2i>& detected_points, std::vector<cv::Point2i>& sun_points, int mask_id) {
+  region_spans_.buildFromRegions(i_regions, i_image.size());
+  return detectPoints(i_image, detected_points, sun_points, mask_id, true);
+}
+
+bool uvdar::UVDARLedDetectFASTCPU::setSunCache(int i_refresh_period, double i_max_change) {
+  sun_cache_.configure(i_refresh_period, i_max_change);
+  return true;
+}
+
+void uvdar::UVDARLedDetectFASTCPU::setThresholds(int i_threshold, int i_threshold_diff, int i_threshold_sun) {
+  UVDARLedDetectFAST::setThresholds(i_threshold, i_threshold_diff, i_threshold_sun);
+  sun_cache_.invalidate(); //the sun found with other thresholds may differ
+}
+
+int uvdar::UVDARLedDetectFASTCPU::countSaturated(const RowSpans& spans) const {
+  int count = 0;
+  for (int j = 0; j < image_curr_.rows; j++) {
+    const unsigned char* row = image_curr_.data + (j * image_curr_.cols);
+    for (const ColumnSpan* span = spans.begin(j); span != spans.end(j); span++) {
+      for (int i = span->begin; i < span->end; i++) {
+        count += (row[i] > _threshold_sun_);
+      }
+    }
+  }
+  return count;
+}
+
+bool uvdar::UVDARLedDetectFASTCPU::detectPoints(const cv::Mat i_image, std::vector<cv::Point2i>& detected_points, std::vector<cv::Point2i>& sun_points, int mask_id, bool use_regions) {
+  auto detection_start = std::chrono::steady_clock::now();
   detected_points = std::vector<cv::Point2i>();
+  sun_points      = std::vector<cv::Point2i>();
   image_curr_     = i_image;
 
   if (mask_id >= 0) {
@@ -34,296 +257,447 @@ bool uvdar::UVDARLedDetectFASTCPU::processImage(const cv::Mat i_image, std::vect
     (image_curr_).copyTo(image_view_);
   }
 
-  if (first_) {
+  if (first_ || (image_check_.size() != image_curr_.size())) {
     first_       = false;
     roi_         = cv::Rect(cv::Point(0, 0), image_curr_.size());
     image_check_ = cv::Mat(image_curr_.size(), CV_8UC1);
     image_check_ = cv::Scalar(0);
+    marked_indices_.clear();
+  }
+  if (fast_stride_ != image_curr_.cols) {
+    initFAST(image_curr_.cols);
   }
   clearMarks();
+  candidate_count_ = 0;
+
+  if (temporal_) {
+    if (history_max_.size() != image_curr_.size()) { //the darkest values start at zero, so everything bright is considered changing until the history fills up
+      history_max_ = image_curr_.clone();
+      history_min_ = cv::Mat(image_curr_.size(), CV_8UC1);
+      history_min_ = cv::Scalar(0);
+    } else {
+      history_fn_(image_curr_.data, history_max_.data, history_min_.data, (int)(image_curr_.total()), temporal_decay_);
+    }
+  }
+
+  //the FAST test depends only on the image, so the bands can be tested concurrently. The non-maxima suppression and the sun point clustering depend on the order of the pixels, so these are done afterwards in a single pass over all bands in the raster order - this way the results do not depend on the placement of the band borders
+  //only the valid pixels of the mask (and of the requested regions) are searched, so masked out sections are skipped without reading them
+  const RowSpans* spans = nullptr;
+  if (mask_id >= 0) {
+    spans = &mask_spans_[mask_id];
+  }
+  if (use_regions) {
+    if (spans != nullptr) {
+      combined_spans_.buildIntersection(region_spans_, *spans);
+      spans = &combined_spans_;
+    } else {
+      spans = &region_spans_;
+    }
+  }
+  bool prescreen = prescreen_ && !use_regions; //the regions are small and scattered, so pooling the rows across them would read more than the regions themselves
+
+  //with the sun caching, the surroundings of the cached sun are left out of the search, since any marker found there would be discarded as glare. Only the saturated pixels there are counted, to find out whether the sun changed
+  bool sun_cache = sun_cache_.enabled();
+  bool sun_cache_hit = sun_cache && sun_cache_.usable(image_curr_.size(), mask_id) && !sun_cache_.changed(countSaturated(sun_cache_spans_));
+  const RowSpans* search_spans = (mask_id >= 0) ? &mask_spans_[mask_id] : nullptr; //the pixels searched in a full search, for refreshing the cache
+  if (sun_cache_hit) {
+    sun_points = sun_cache_.points();
+    if (use_regions) { //the search spans of the cache are already restricted to the mask
+      combined_spans_.buildIntersection(region_spans_, sun_cache_search_spans_);
+      spans = &combined_spans_;
+    } else {
+      spans = &sun_cache_search_spans_;
+    }
+  }
+
+  //the sun is needed complete for the glare filtering and for its publishing, but its image mostly lies outside of the regions. The rest of the image is therefore searched for the sun points only - the FAST test only declares pixels brighter than the sun threshold a part of the sun, so the pre-scan rejects nearly all of it
+  const RowSpans* sun_spans = nullptr;
+  if (use_regions && !sun_cache_hit) {
+    if (search_spans == nullptr) {
+      full_spans_.buildFromRegions({cv::Rect(cv::Point(0, 0), image_curr_.size())}, image_curr_.size());
+      search_spans = &full_spans_;
+    }
+    sun_search_spans_.buildDifference(*search_spans, region_spans_);
+    sun_spans = &sun_search_spans_;
+  }
+  size_t sun_offset = sun_points.size(); //the sun points found in this image follow the cached ones
+
+  //with a point limit, the image is processed in stripes of rows, so that the detection can stop (or leave out the overflowing tiles) as soon as the limit is exceeded. The events are still processed in the raster order, so the results do not depend on the stripes either
+  point_limit_.start(image_curr_.size());
+  int stripe_count = (point_limit_.maxPoints() > 0) ? std::max(1, std::min(point_limit_stripes, image_curr_.rows / fast_point_sets::fast_halo)) : 1;
+  const RowSpans* base_spans = spans;
+  int band_count = std::max(1, std::min(thread_count_, (image_curr_.rows / stripe_count) / fast_point_sets::fast_halo)); //bands thinner than the reach of the FAST rings would mostly read rows of their neighbors
+  band_events_.resize(band_count);
+  band_scratch_.resize(band_count);
+  band_timings_.assign(band_count, 0.0);
 
   cv::Point peak_point;
+  sun_grid_.reset(image_curr_.size(), sun_cluster_radius);
+  bool potential_sun_found = false;
 
   int x, y;
-  /* begin = std::clock(); */
-  bool marker_potential = false;
-  /* bool          gotOne     = false; */
-  bool sun_point_potential = false;
   std::vector<std::pair<cv::Point,int>> sun_points_tent;
-  for (int j = 0; j < image_curr_.rows; j++) { for (int i = 0; i < image_curr_.cols; i++) { //iterate over the image points 
-    if (mask_id >= 0) {
-      if (masks_[mask_id].data[index2d(i, j)] == 0) { //skip over masked out points
-        continue;
+  for (int s = 0; s < stripe_count; s++) {
+    int stripe_begin = (image_curr_.rows * s) / stripe_count;
+    int stripe_rows  = ((image_curr_.rows * (s + 1)) / stripe_count) - stripe_begin;
+    std::function<void(int)> test_band = [&](int b) {
+      auto start = std::chrono::steady_clock::now();
+      int band_begin = stripe_begin + ((stripe_rows * b) / band_count);
+      int band_end   = stripe_begin + ((stripe_rows * (b + 1)) / band_count);
+      testRows(band_begin, band_end, spans, prescreen, _threshold_, false, band_events_[b], band_scratch_[b]);
+      if (sun_spans != nullptr) { //both searches yield their events in raster order, so these are merged to keep the order of the event processing
+        BandScratch& scratch = band_scratch_[b];
+        testRows(band_begin, band_end, sun_spans, prescreen_, _threshold_sun_, true, scratch.sun_events, scratch);
+        scratch.merged_events.clear();
+        std::merge(band_events_[b].begin(), band_events_[b].end(), scratch.sun_events.begin(), scratch.sun_events.end(), std::back_inserter(scratch.merged_events), [](const FastEvent& first, const FastEvent& second) {
+          return (first.y < second.y) || ((first.y == second.y) && (first.x < second.x));
+        });
+        band_events_[b].swap(scratch.merged_events);
       }
+      band_timings_[b] += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+    if (band_pool_) {
+      band_pool_->run(band_count, test_band);
+    } else {
+      test_band(0);
     }
-    sun_point_potential = false;
-    if (image_check_.data[index2d(i, j)] == 0) { // skip over marked points (suppresses clustered bright pixels)
-      if (image_curr_.data[index2d(i, j)] > _threshold_) { //if the point is bright
-        int sun_test_points = -1;
-        if (image_curr_.data[index2d(i, j)] > _threshold_sun_) { //if the point is "very bright" it might be a part of the image of directly observed sun
-          sun_point_potential = true;
-        }
 
-        int n = -1;
-        for (auto fast_points : fast_points_set_) { //iterate over the pre-selected sets of points for different sizes of the FAST radius
-          sun_test_points = 0;
-          marker_potential = true;
-          n++;
-          /* if (n>0){ */
-          /*   std::cout << "HERE A" << std::endl; */
-          /* } */
-          for (int m = 0; m < (int)(fast_points.size()); m++) { //iterate over the points in the current FAST radius
-            x = i + fast_points[m].x;
-            y = j + fast_points[m].y;
-
-            //check for image border breach
-            if (x < 0) {
-              marker_potential = false;
-              break;
-            }
-            if (x >= roi_.width) {
-              marker_potential = false;
-              break;
-            }
-            if (y < 0) {
-              marker_potential = false;
-              break;
-            }
-            if (y >= roi_.height) {
-              marker_potential = false;
-              break;
-            }
-
-            if ((image_curr_.data[index2d(i, j)] - image_curr_.data[index2d(x, y)]) < _threshold_diff_) { //if the difference between the current point and a surrounding point is smaller than desired
-              /* if (n>0){ */
-              /*     std::cout << "HERE B: broken at fast point " << m << " by: " << (int)(image_curr_.data[index2d(i, j)] - image_curr_.data[index2d(x, y)]) << std::endl; */
-              /* } */
-
-              marker_potential = false; //this is not a marker (not concentrated enough)
-              if (!sun_point_potential) //if we expected this to be a part of the sun, can still confirm this hypthesis
-                break;
-              else
-                sun_test_points++;
-            }
-            else { //if the difference is small, this is likely not a part of the sun, as the point is too concentrated (sun usually saturates bigger area in the image than our FAST neighborhood)
-              sun_point_potential = false;
-            }
-          }
-          /* if (n>0){ */
-          /*   std::cout << "HERE E: here? " << std::endl; */
-          /* } */
-          if (marker_potential) { //if the smaller radius check determines that this point is a marker, the larger radius is unnecessary
-              /* std::cout << "HERE C: passed" << std::endl; */
-            /* if (n>0){ */
-              /* std::cout << "HERE D: passed on second ring" << std::endl; */
-            /* } */
-            break;
-          }
+    for (auto& events : band_events_) {
+      for (auto& event : events) { //iterate over the points that passed the FAST test, in raster order
+        int i = event.x;
+        int j = event.y;
+        if (event.result == FAST_RESULT_MARKER) {
+          candidate_count_++;
+        }
+        if (image_check_.data[index2d(i, j)] != 0) { // skip over marked points (suppresses clustered bright pixels)
+          continue;
         }
-        /* if (n>0){ */
-        /*   /1* if (marker_potential){ *1/ */
-        /*   /1*   std::cout << "HERE B" << std::endl; *1/ */
-        /*   /1* } *1/ */
-        /* } */
+
         unsigned char maximum_val;
-        if (marker_potential) {
+        if (event.result == FAST_RESULT_MARKER) {
           maximum_val = 0;
-          n = (int)(fast_interior_set_.size())-1;
-          for (int m = 0; m < (int)(fast_interior_set_[n].size()); m++) { //iterate over a subset of points inside of the FAST neighborhood (lower right corner only, due to iterating over the image in this direction)
-            x = i + fast_interior_set_[n][m].x;
-            y = j + fast_interior_set_[n][m].y;
-
-            //check for image border breach
-            if (x < 0) {
-              continue;
-            }
-            if (x >= roi_.width) {
-              continue;
-            }
-            if (y < 0) {
-              continue;
-            }
-            if (y >= roi_.height) {
-              continue;
+          const unsigned char* center = image_curr_.data + index2d(i, j);
+          unsigned char* center_check = image_check_.data + index2d(i, j);
+          //the interior set reaches 3 pixels to the sides and 3 pixels down - only points closer to the image border need the border checks
+          bool inside = (i >= 3) && (i < (roi_.width - 3)) && (j < (roi_.height - 3));
+          for (int m = 0; m < (int)(fast_point_sets::fast_interior.size()); m++) { //iterate over a subset of points inside of the FAST neighborhood (lower right corner only, due to iterating over the image in this direction)
+            if (!inside) {
+              x = i + fast_point_sets::fast_interior[m].x;
+              y = j + fast_point_sets::fast_interior[m].y;
+
+              //check for image border breach
+              if ((x < 0) || (x >= roi_.width) || (y < 0) || (y >= roi_.height)) {
+                continue;
+              }
             }
 
-            if (image_check_.data[index2d(x, y)] == 0) {
-              if (image_curr_.data[index2d(x, y)] > maximum_val) { //non-maxima suppression - select the brightest point inside the FAST neighborhood
-                maximum_val = image_curr_.data[index2d(x, y)];
-                peak_point.x = x;
-                peak_point.y = y;
+            int offset = fast_interior_offsets_[m];
+            if (center_check[offset] == 0) {
+              if (center[offset] > maximum_val) { //non-maxima suppression - select the brightest point inside the FAST neighborhood
+                maximum_val = center[offset];
+                peak_point.x = i + fast_point_sets::fast_interior[m].x;
+                peak_point.y = j + fast_point_sets::fast_interior[m].y;
               }
-              image_check_.data[index2d(x, y)] = 255; //mark interior point to prevent additional detections in the same area
-            /* std::cout << "Setting point " << x << ":" << y << " as checked" << std::endl; */
+              center_check[offset] = 255; //mark interior point to prevent additional detections in the same area
+              marked_indices_.push_back(index2d(i, j) + offset);
             }
           }
           detected_points.push_back(peak_point); //store detected marker point
-            /* std::cout << "Outputting point " << peak_point.x << ":" << peak_point.y << " as checked" << std::endl; */
-        } else {
-          if (sun_point_potential) 
-            if (sun_test_points == (int)(fast_points_set_[n].size())){ //declare this pixel a part of the image of the sun if even its FAST neighborhood was bright
-              int it = 0;
-              bool found = false;
-              for (auto &pt : sun_points_tent){
-                if (cv::norm(cv::Point(i, j) - (pt.first/pt.second)) < 20){
-                  pt.first = pt.first+cv::Point(i, j);
-                  pt.second = pt.second+1;
-                  sun_points[it] = ((pt.first/pt.second));
-                  found = true;
-                  break;
-                }
-
-
-                
-                it++;
-              }
-
-              if (!found){
-                sun_points_tent.push_back({cv::Point(i, j),1});
-                sun_points.push_back(cv::Point(i, j));
-              }
-
+        } else { //declare this pixel a part of the image of the sun
+          //join the first (oldest) cluster with the centroid closer than sun_cluster_radius pixels - the grid holds the current centroids of the clusters, so only the clusters in the neighboring cells are compared
+          cv::Point point(i, j);
+          int found = -1;
+          sun_grid_.forEachNear(point, [&](int k) {
+            if (((found < 0) || (k < found)) && (cv::norm(point - (sun_points_tent[k].first/sun_points_tent[k].second)) < sun_cluster_radius)) {
+              found = k;
             }
+          });
+
+          if (found >= 0){
+            auto& pt = sun_points_tent[found];
+            cv::Point centroid_prev = pt.first/pt.second;
+            pt.first = pt.first+point;
+            pt.second = pt.second+1;
+            sun_points[sun_offset + found] = ((pt.first/pt.second));
+            sun_grid_.move(found, centroid_prev, sun_points[sun_offset + found]);
+          }
+          else {
+            sun_grid_.insert((int)(sun_points_tent.size()), point);
+            sun_points_tent.push_back({point,1});
+            sun_points.push_back(point);
+          }
         }
       }
     }
-  } }
-
-  for (int i = 0; i < (int)(detected_points.size()); i++) { //iterate over the detected marker points
-    for (int j = 0; j < (int)(sun_points.size()); j++) { //iterate over the detected sun points
-      if (cv::norm(detected_points[i] - (sun_points[j])) < 25) { //if the current detected marker point is close to the sun, it might be merely glare, so we discard it rather than to have numerous false detections here
-        detected_points.erase(detected_points.begin() + i);
-        i--;
-        break;
-      }
-    }
-  }
 
-  return true;
-}
+    //until the last stripe, the sun may still grow, and discard more of the points as glare. Before the limit can be checked, all the pixels of the image that may become a part of the sun are found - the detection then only stops if enough points lie too far from these to become glare
+    bool sun_complete = (s == (stripe_count - 1));
+    if (!sun_complete && !potential_sun_found && (((int)(detected_points.size()) > point_limit_.maxPoints()) || point_limit_.overload().degraded)) {
+      findPotentialSun(band_count);
+      potential_sun_found = true;
+    }
 
-void uvdar::UVDARLedDetectFASTCPU::clearMarks() {
-  for (int j = 0; j < image_curr_.rows; j++) {
-    for (int i = 0; i < image_curr_.cols; i++) {
-      if (image_check_.at<unsigned char>(j, i) == 255) {
-        image_check_.at<unsigned char>(j, i) = 0;
+    size_t dropped_tiles = point_limit_.overload().dropped_tiles.size();
+    if (point_limit_.check(detected_points, sun_points, sun_complete ? nullptr : &potential_sun_points_, sun_cluster_reach)) { //the image is not usable, the rest of it is not worth processing
+      detected_points.clear();
+      return true;
+    }
+    if (point_limit_.overload().dropped_tiles.size() != dropped_tiles) { //the dropped tiles are left out of the rest of the search
+      point_limit_.buildBudgetSpans(budget_spans_);
+      if (base_spans != nullptr) {
+        budget_combined_spans_.buildIntersection(budget_spans_, *base_spans);
+        spans = &budget_combined_spans_;
+      } else {
+        spans = &budget_spans_;
       }
     }
   }
-}
-
-
-void uvdar::UVDARLedDetectFASTCPU::initFAST() {
-  std::vector<cv::Point> fast_points;
-
-  fast_points.push_back(cv::Point(0, -3));
-  fast_points.push_back(cv::Point(0, 3));
-  fast_points.push_back(cv::Point(3, 0));
-  fast_points.push_back(cv::Point(-3, 0));
-
-  fast_points.push_back(cv::Point(2, -2));
-  fast_points.push_back(cv::Point(-2, 2));
-  fast_points.push_back(cv::Point(-2, -2));
-  fast_points.push_back(cv::Point(2, 2));
-
-  fast_points.push_back(cv::Point(-1, -3));
-  fast_points.push_back(cv::Point(1, 3));
-  fast_points.push_back(cv::Point(3, -1));
-  fast_points.push_back(cv::Point(-3, 1));
 
-  fast_points.push_back(cv::Point(1, -3));
-  fast_points.push_back(cv::Point(-1, 3));
-  fast_points.push_back(cv::Point(3, 1));
-  fast_points.push_back(cv::Point(-3, -1));
-
-  fast_points_set_.push_back(fast_points);
-
-  fast_points.clear();
-
-  fast_points.push_back(cv::Point(0, -4));
-  fast_points.push_back(cv::Point(0, 4));
-  fast_points.push_back(cv::Point(4, 0));
-  fast_points.push_back(cv::Point(-4, 0));
-
-  fast_points.push_back(cv::Point(3, -3));
-  fast_points.push_back(cv::Point(-3, 3));
-  fast_points.push_back(cv::Point(-3, -3));
-  fast_points.push_back(cv::Point(3, 3));
-
-  fast_points.push_back(cv::Point(-1, -4));
-  fast_points.push_back(cv::Point(1, 4));
-  fast_points.push_back(cv::Point(4, -1));
-  fast_points.push_back(cv::Point(-4, 1));
+  if (sun_cache && !sun_cache_hit && !point_limit_.overload().overloaded) { //the search for the sun covered the whole image, so the sun found is complete
+    //the FAST rings and the non-maxima suppression reach at most fast_halo pixels, so the markers found closer than this to the sun would lie within glare_radius of it anyway
+    sun_cache_spans_.buildFromDiscs(sun_points, PointLimit::glare_radius - fast_point_sets::fast_halo - 1, image_curr_.size());
+    if (search_spans == nullptr) {
+      full_spans_.buildFromRegions({cv::Rect(cv::Point(0, 0), image_curr_.size())}, image_curr_.size());
+      search_spans = &full_spans_;
+    }
+    sun_cache_search_spans_.buildDifference(*search_spans, sun_cache_spans_);
+    sun_cache_.store(sun_points, countSaturated(sun_cache_spans_), image_curr_.size(), mask_id);
+  }
 
-  fast_points.push_back(cv::Point(1, -4));
-  fast_points.push_back(cv::Point(-1, 4));
-  fast_points.push_back(cv::Point(4, 1));
-  fast_points.push_back(cv::Point(-4, -1));
+  point_limit_.filterGlare(detected_points, sun_points, image_curr_.size());
 
-  fast_points.push_back(cv::Point(-2, -4));
-  fast_points.push_back(cv::Point(2, 4));
-  fast_points.push_back(cv::Point(4, -2));
-  fast_points.push_back(cv::Point(-4, 2));
+  if (sun_cache) {
+    sun_cache_.record(sun_cache_hit, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - detection_start).count());
+  }
 
-  fast_points.push_back(cv::Point(2, -4));
-  fast_points.push_back(cv::Point(-2, 4));
-  fast_points.push_back(cv::Point(4, 2));
-  fast_points.push_back(cv::Point(-4, -2));
+  return true;
+}
 
-  fast_points_set_.push_back(fast_points);
+void uvdar::UVDARLedDetectFASTCPU::findPotentialSun(int band_count) {
+  //the FAST test depends only on the image, so the sun pixels of the whole image are a superset of the pixels any search can add to the sun
+  std::function<void(int)> test_band = [&](int b) {
+    testRows((image_curr_.rows * b) / band_count, (image_curr_.rows * (b + 1)) / band_count, nullptr, prescreen_, _threshold_sun_, true, band_events_[b], band_scratch_[b]);
+  };
+  if (band_pool_) {
+    band_pool_->run(band_count, test_band);
+  } else {
+    test_band(0);
+  }
 
+  potential_sun_points_.clear();
+  for (auto& events : band_events_) {
+    for (auto& event : events) {
+      potential_sun_points_.push_back(cv::Point2i(event.x, event.y));
+    }
+  }
+}
 
-  std::vector<cv::Point> fast_interior;
+void uvdar::UVDARLedDetectFASTCPU::testRows(int row_begin, int row_end, const RowSpans* spans, bool prescreen, int threshold, bool sun_only, std::vector<FastEvent>& events, BandScratch& scratch) const {
+  events.clear();
+  scratch.candidates.resize(image_curr_.cols);
+  scratch.pooled_candidates.resize(image_curr_.cols);
+
+  //the pre-scan only keeps bright points - all the other points are not worth testing
+  for (int group_begin = row_begin; group_begin < row_end; group_begin += prescreen_rows) {
+    int group_end = std::min(group_begin + prescreen_rows, row_end);
+
+    //with the pre-screen, the rows of the group are max-pooled first - only the columns bright in the pooled row can be bright in any of the rows, so the rows themselves are only checked at these columns. Most of the image is dark, so most of it is rejected at a fraction of the cost of the pre-scan of each row
+    //if too many columns are bright, checking them one by one would be slower than the pre-scan of each row, so the group is pre-scanned normally
+    int pooled_count = -1;
+    if (prescreen) {
+      const unsigned char* rows[prescreen_rows];
+      for (int k = 0; k < prescreen_rows; k++) { //a shorter group at the end of the band repeats its last row
+        rows[k] = image_curr_.data + index2d(0, std::min(group_begin + k, group_end - 1));
+      }
+      int begin = 0;
+      int end   = image_curr_.cols;
+      if (spans != nullptr) { //the spans of a mask mostly cover whole rows, so only their extent is used here - the candidates are matched with the spans below
+        begin = image_curr_.cols;
+        end   = 0;
+        for (int j = group_begin; j < group_end; j++) {
+          if (spans->begin(j) != spans->end(j)) {
+            begin = std::min(begin, spans->begin(j)->begin);
+            end   = std::max(end, (spans->end(j) - 1)->end);
+          }
+        }
+      }
+      pooled_count = (begin < end) ? prescreen_fn_(rows, begin, end, threshold, scratch.pooled_candidates.data()) : 0;
+      if (pooled_count > (image_curr_.cols / prescreen_dense_fraction)) {
+        pooled_count = -1;
+      }
+    }
 
-  fast_interior.push_back(cv::Point(0, 0));
-  fast_interior.push_back(cv::Point(1, 0));
-  fast_interior.push_back(cv::Point(2, 0));
+    for (int j = group_begin; j < group_end; j++) {
+      const unsigned char* row = image_curr_.data + index2d(0, j);
+
+      int candidate_count = 0;
+      if (pooled_count >= 0) { //the pooled candidates are sorted, so a merge-like walk with the sorted spans keeps only the ones searched in this row
+        const ColumnSpan* span     = (spans != nullptr) ? spans->begin(j) : nullptr;
+        const ColumnSpan* span_end = (spans != nullptr) ? spans->end(j) : nullptr;
+        for (int c = 0; c < pooled_count; c++) {
+          int i = scratch.pooled_candidates[c];
+          if (row[i] <= threshold) {
+            continue;
+          }
+          if (spans != nullptr) {
+            while ((span != span_end) && (span->end <= i)) {
+              span++;
+            }
+            if ((span == span_end) || (span->begin > i)) {
+              continue;
+            }
+          }
+          scratch.candidates[candidate_count++] = i;
+        }
+      } else if (spans != nullptr) { //the spans are sorted and disjoint, so the candidates stay in ascending order
+        for (const ColumnSpan* span = spans->begin(j); span != spans->end(j); span++) {
+          candidate_count += prescan_fn_(row, span->begin, span->end, threshold, scratch.candidates.data() + candidate_count);
+        }
+      } else {
+        candidate_count = prescan_fn_(row, 0, image_curr_.cols, threshold, scratch.candidates.data());
+      }
 
-  fast_interior.push_back(cv::Point(-2, 1));
-  fast_interior.push_back(cv::Point(-1, 1));
+      //points at least fast_halo pixels away from the image borders are tested without the border checks
+      bool row_inside = (j >= fast_point_sets::fast_halo) && (j < (image_curr_.rows - fast_point_sets::fast_halo));
+      for (int c = 0; c < candidate_count; c++) { //iterate over the candidate image points
+        int i = scratch.candidates[c];
+
+        //in the temporal mode, the markers are only searched among the pixels that recently changed their brightness - the static ones are still tested if they may be a part of the sun, since the sun points are needed for the glare filtering
+        bool changing = true;
+        if (temporal_ && !sun_only) {
+          int index = index2d(i, j);
+          changing = ((history_max_.data[index] - history_min_.data[index]) >= temporal_min_change_);
+          if (!changing && (row[i] <= _threshold_sun_)) {
+            continue;
+          }
+        }
 
-  fast_interior.push_back(cv::Point(0, 1));
-  fast_interior.push_back(cv::Point(1, 1));
-  fast_interior.push_back(cv::Point(2, 1));
+        FastResult result;
+        if (row_inside && (i >= fast_point_sets::fast_halo) && (i < (image_curr_.cols - fast_point_sets::fast_halo))) {
+          result = testFAST<false>(i, j);
+        } else {
+          result = testFAST<true>(i, j);
+        }
+        if ((result == FAST_RESULT_SUN) || ((result == FAST_RESULT_MARKER) && changing && !sun_only)) {
+          events.push_back({i, j, result});
+        }
+      }
+    }
+  }
+}
 
-  fast_interior.push_back(cv::Point(-1, 2));
+template <bool CHECKED>
+uvdar::UVDARLedDetectFASTCPU::FastResult uvdar::UVDARLedDetectFASTCPU::testFAST(int i, int j) const {
+  const unsigned char* center = image_curr_.data + index2d(i, j);
+  bool sun_point_potential = (*center > _threshold_sun_); //if the point is "very bright" it might be a part of the image of directly observed sun
 
-  fast_interior.push_back(cv::Point(0, 2));
-  fast_interior.push_back(cv::Point(1, 2));
+  //the rings are tested from the smallest radius - if the smaller radius check determines that this point is a marker, the larger radius is unnecessary
+  RingResult ring_3 = RING_OUTSIDE;
+  if (!CHECKED || ((i >= 3) && (i < (roi_.width - 3)) && (j >= 3) && (j < (roi_.height - 3)))) { //check for image border breach
+    ring_3 = testRing<3>(center, sun_point_potential);
+  }
+  if (ring_3 == RING_PASSED) {
+    return FAST_RESULT_MARKER;
+  }
 
-  fast_interior_set_.push_back(fast_interior);
+  RingResult ring_4 = RING_OUTSIDE;
+  if (!CHECKED || ((i >= 4) && (i < (roi_.width - 4)) && (j >= 4) && (j < (roi_.height - 4)))) {
+    ring_4 = testRing<4>(center, sun_point_potential && (ring_3 == RING_FAILED));
+  }
+  if (ring_4 == RING_PASSED) {
+    return FAST_RESULT_MARKER;
+  }
 
-  fast_interior.clear();
+  if (sun_point_potential && (ring_3 == RING_FAILED) && (ring_4 == RING_FAILED)) { //declare this pixel a part of the image of the sun if even its FAST neighborhood was bright
+    return FAST_RESULT_SUN;
+  }
+  return FAST_RESULT_NONE;
+}
 
-  fast_interior.push_back(cv::Point(0, 0));
-  fast_interior.push_back(cv::Point(1, 0));
-  fast_interior.push_back(cv::Point(2, 0));
-  fast_interior.push_back(cv::Point(3, 0));
+template <int R>
+uvdar::UVDARLedDetectFASTCPU::RingResult uvdar::UVDARLedDetectFASTCPU::testRing(const unsigned char* center, bool track_sun) const {
+  constexpr int point_count = (int)(fast_point_sets::FastRing<R>::points.size());
+  const int* offsets;
+  if constexpr (R == 3) {
+    offsets = fast_ring_3_offsets_.data();
+  } else {
+    offsets = fast_ring_4_offsets_.data();
+  }
 
-  fast_interior.push_back(cv::Point(-3, 1));
-  fast_interior.push_back(cv::Point(-2, 1));
-  fast_interior.push_back(cv::Point(-1, 1));
+  int failed = 0;
+  for (int m = 0; m < point_count; m++) { //iterate over the points in the current FAST radius
+    if ((*center - center[offsets[m]]) < _threshold_diff_) { //if the difference between the current point and a surrounding point is smaller than desired
+      if (!track_sun) { //this is not a marker (not concentrated enough) and we do not expect this to be a part of the sun
+        return RING_MIXED;
+      }
+      failed++;
+    }
+    else { //if the difference is large, this is likely not a part of the sun, as the point is too concentrated (sun usually saturates bigger area in the image than our FAST neighborhood)
+      if (failed > 0) {
+        return RING_MIXED;
+      }
+      track_sun = false;
+    }
+  }
+  return (failed == point_count) ? RING_FAILED : RING_PASSED;
+}
 
-  fast_interior.push_back(cv::Point(0, 1));
-  fast_interior.push_back(cv::Point(1, 1));
-  fast_interior.push_back(cv::Point(2, 1));
-  fast_interior.push_back(cv::Point(3, 1));
+void uvdar::UVDARLedDetectFASTCPU::setThreadCount(int i_thread_count) {
+  thread_count_ = std::max(1, i_thread_count);
+  if (thread_count_ > 1) {
+    if (!band_pool_ || (band_pool_->getThreadCount() != thread_count_)) {
+      band_pool_ = std::make_unique<BandWorkerPool>(thread_count_);
+    }
+  } else {
+    band_pool_.reset();
+  }
+  if (_debug_) {
+    std::cout << "[UVDARDetectorFASTCPU]: Using " << thread_count_ << " detection thread(s)." << std::endl;
+  }
+}
 
-  fast_interior.push_back(cv::Point(-3, 2));
-  fast_interior.push_back(cv::Point(-2, 2));
-  fast_interior.push_back(cv::Point(-1, 2));
+bool uvdar::UVDARLedDetectFASTCPU::setTemporalMode(bool i_enabled, int i_decay, int i_min_change) {
+  temporal_            = i_enabled;
+  temporal_decay_      = (unsigned char)(std::clamp(i_decay, 1, 255));
+  temporal_min_change_ = std::clamp(i_min_change, 1, 255);
+  history_max_ = cv::Mat(); //the history is started again with the next image
+  history_min_ = cv::Mat();
+  if (_debug_) {
+    std::cout << "[UVDARDetectorFASTCPU]: Temporal mode " << (temporal_ ? "enabled" : "disabled") << "." << std::endl;
+  }
+  return true;
+}
 
-  fast_interior.push_back(cv::Point(0, 2));
-  fast_interior.push_back(cv::Point(1, 2));
-  fast_interior.push_back(cv::Point(2, 2));
-  fast_interior.push_back(cv::Point(3, 2));
+void uvdar::UVDARLedDetectFASTCPU::clearMarks() {
+  if (mark_reset_ == MarkReset::FULL_SCAN) {
+    for (int j = 0; j < image_check_.rows; j++) {
+      for (int i = 0; i < image_check_.cols; i++) {
+        if (image_check_.at<unsigned char>(j, i) == 255) {
+          image_check_.at<unsigned char>(j, i) = 0;
+        }
+      }
+    }
+    marked_indices_.clear();
+    return;
+  }
 
-  fast_interior.push_back(cv::Point(-2, 3));
-  fast_interior.push_back(cv::Point(-1, 3));
+  //only the points marked in the previous image are reset, so the cost depends on the number of detections, not on the resolution
+  for (auto index : marked_indices_) {
+    image_check_.data[index] = 0;
+  }
+  marked_indices_.clear();
+}
 
-  fast_interior.push_back(cv::Point(0, 3));
-  fast_interior.push_back(cv::Point(1, 3));
-  fast_interior.push_back(cv::Point(2, 3));
 
-  fast_interior_set_.push_back(fast_interior);
+void uvdar::UVDARLedDetectFASTCPU::initFAST(int stride) {
+  fast_stride_ = stride;
+  for (int m = 0; m < (int)(fast_ring_3_offsets_.size()); m++) {
+    fast_ring_3_offsets_[m] = (stride * fast_point_sets::FastRing<3>::points[m].y) + fast_point_sets::FastRing<3>::points[m].x;
+  }
+  for (int m = 0; m < (int)(fast_ring_4_offsets_.size()); m++) {
+    fast_ring_4_offsets_[m] = (stride * fast_point_sets::FastRing<4>::points[m].y) + fast_point_sets::FastRing<4>::points[m].x;
+  }
+  for (int m = 0; m < (int)(fast_interior_offsets_.size()); m++) {
+    fast_interior_offsets_[m] = (stride * fast_point_sets::fast_interior[m].y) + fast_point_sets::fast_interior[m].x;
+  }
 }
@@ -2,28 +2,230 @@
 #define UV_LED_FAST_CPU_H
 
 #include "uv_led_detect_fast.h"
+#include "band_worker_pool.h"
+#include "fast_point_sets.h"
 
 namespace uvdar {
 
   class UVDARLedDetectFASTCPU : public UVDARLedDetectFAST {
     public:
+
+      /**
+       * @brief Kernels available for the row pre-scan that selects the pixels worth a FAST test
+       */
+      enum class PrescanKernel {
+        AUTO,   ///< the widest kernel supported by both the build and the running CPU
+        SCALAR, ///< one pixel at a time, always available
+        SSE2,   ///< 16 pixels at a time
+        AVX2    ///< 32 pixels at a time
+      };
+
+      /**
+       * @brief Ways of resetting the marks of the non-maxima suppression before each image
+       */
+      enum class MarkReset {
+        LISTED,   ///< only the points marked in the previous image are reset - the cost depends on the number of detections
+        FULL_SCAN ///< every point of the image is checked, as before the listed reset - kept for measuring the difference
+      };
+
       UVDARLedDetectFASTCPU(bool i_gui, bool i_debug, int i_threshold, int i_threshold_diff, int i_threshold_sun, std::vector<cv::Mat> i_masks);
       bool processImage(const cv::Mat i_image, std::vector<cv::Point2i>& detected_points, std::vector<cv::Point2i>& sun_points, int mask_id=-1);
+      bool processImageRegions(const cv::Mat i_image, const std::vector<cv::Rect>& i_regions, std::vector<cv::Point2i>& detected_points, std::vector<cv::Point2i>& sun_points, int mask_id=-1);
+      bool setTemporalMode(bool i_enabled, int i_decay, int i_min_change);
+      bool setSunCache(int i_refresh_period, double i_max_change);
+      const SunCacheStats& getSunCacheStats() const { return sun_cache_.stats(); }
+      void setThresholds(int i_threshold, int i_threshold_diff, int i_threshold_sun);
+      void setPointLimit(int i_max_points, bool i_tile_budget) { point_limit_.setLimit(i_max_points, i_tile_budget); }
+      const DetectionOverload& getOverload() const { return point_limit_.overload(); }
+      int getCandidateCount() const { return candidate_count_; }
+
+      /**
+       * @brief Selects the kernel used for the row pre-scan. If the requested kernel is not available in the current build or on the current CPU, the scalar kernel is used instead
+       *
+       * @param i_kernel The requested kernel
+       *
+       * @return The kernel that will actually be used
+       */
+      PrescanKernel setPrescanKernel(PrescanKernel i_kernel);
+
+      /**
+       * @brief Retrieves the kernel currently used for the row pre-scan
+       *
+       * @return The active kernel
+       */
+      PrescanKernel getPrescanKernel() const { return prescan_kernel_; }
+
+      /**
+       * @brief Enables or disables the pre-screen of the row pre-scan. With the pre-screen, groups of prescreen_rows rows are max-pooled into a single row first, and the rows of a group are only checked at the columns that are bright in the pooled row. In processImageRegions, it is only used for the search for the sun outside of the regions. The results are the same either way
+       *
+       * @param i_prescreen If true, the pre-screen is used
+       */
+      void setPrescreen(bool i_prescreen) { prescreen_ = i_prescreen; }
+
+      /**
+       * @brief Selects the way the marks of the non-maxima suppression are reset before each image. The results are the same either way
+       *
+       * @param i_mark_reset The reset to use
+       */
+      void setMarkReset(MarkReset i_mark_reset) { mark_reset_ = i_mark_reset; }
+
+
+      /**
+       * @brief Sets the number of threads used for detection. With more than one thread, the image is split into horizontal bands that are tested in parallel
+       *
+       * @param i_thread_count The number of threads (and bands), including the thread calling processImage
+       */
+      void setThreadCount(int i_thread_count);
+
+      /**
+       * @brief Retrieves the time spent on each band of the last processed image, in the order of the bands from the top of the image. The slowest band bounds the time of the parallel part of the detection, so bands much slower than the rest show that more threads would not help
+       *
+       * @return Durations in milliseconds - empty before the first image
+       */
+      const std::vector<double>& getBandTimings() const { return band_timings_; }
 
     private:
 
       /**
-       * @brief Resets a helper matrix used for suppression of clustered bright pixels
+       * @brief Outcome of the FAST test of a single pixel
+       */
+      enum FastResult : unsigned char {
+        FAST_RESULT_NONE,
+        FAST_RESULT_MARKER,
+        FAST_RESULT_SUN
+      };
+
+      /**
+       * @brief A pixel that passed the FAST test, waiting for the sequential non-maxima suppression
+       */
+      struct FastEvent {
+        int x;
+        int y;
+        FastResult result;
+      };
+
+      /**
+       * @brief Signature of the row pre-scan kernels - these store the columns in [begin, end) of a single image row where the pixel is brighter than the threshold
+       *
+       * @param row Pointer to the first pixel of the image row
+       * @param begin The first column to test
+       * @param end One past the last column to test
+       * @param threshold Only pixels brighter than this are selected
+       * @param candidates Output buffer for the selected column indices, must have space for (end - begin) elements
+       *
+       * @return The number of selected columns
+       */
+      using prescan_fn_t = int (*)(const unsigned char* row, int begin, int end, unsigned char threshold, int* candidates);
+
+      /**
+       * @brief Signature of the pre-screen kernels - these store the columns in [begin, end) where at least one of prescreen_rows image rows is brighter than the threshold
+       *
+       * @param rows Pointers to the first pixels of the image rows
+       * @param begin The first column to test
+       * @param end One past the last column to test
+       * @param threshold Only columns brighter than this in at least one row are selected
+       * @param candidates Output buffer for the selected column indices, must have space for (end - begin) elements
+       *
+       * @return The number of selected columns
+       */
+      using prescreen_fn_t = int (*)(const unsigned char* const* rows, int begin, int end, unsigned char threshold, int* candidates);
+
+      /**
+       * @brief Helper buffers of the row pre-scan, one set for each band
+       */
+      struct BandScratch {
+        std::vector<int> candidates;        ///< the columns of the current row worth a FAST test
+        std::vector<int> pooled_candidates; ///< the columns of the current group of rows bright in at least one of the rows
+        std::vector<FastEvent> sun_events;    ///< the sun points found outside of the regions
+        std::vector<FastEvent> merged_events; ///< the events of the regions merged with sun_events
+      };
+
+
+      /**
+       * @brief Shared implementation of processImage and processImageRegions
+       *
+       * @param use_regions If true, only the pixels in region_spans_ are searched, otherwise the whole image is
+       */
+      bool detectPoints(const cv::Mat i_image, std::vector<cv::Point2i>& detected_points, std::vector<cv::Point2i>& sun_points, int mask_id, bool use_regions);
+
+      /**
+       * @brief Counts the pixels of the current image brighter than the sun threshold
+       *
+       * @param spans The pixels to count in
+       */
+      int countSaturated(const RowSpans& spans) const;
+
+      /**
+       * @brief Resets a helper matrix used for suppression of clustered bright pixels. Unless the full scan is selected by setMarkReset, only the points listed in marked_indices_ are reset
        */
       void clearMarks();
 
       /**
-       * @brief Initializes points used in FAST-like bright point detection
+       * @brief Outcome of comparing a pixel with a single FAST ring
        */
-      void initFAST();
+      enum RingResult : unsigned char {
+        RING_PASSED,  ///< the pixel is brighter than every ring point by at least _threshold_diff_
+        RING_FAILED,  ///< the pixel is not brighter than any ring point by _threshold_diff_ (only reported if requested)
+        RING_MIXED,   ///< anything else
+        RING_OUTSIDE  ///< the ring reaches outside of the image
+      };
 
-      std::vector<std::vector< cv::Point >> fast_points_set_;
-      std::vector<std::vector< cv::Point >> fast_interior_set_;
+      /**
+       * @brief Converts the points used in FAST-like bright point detection to linear offsets for the given image row length
+       *
+       * @param stride The number of pixels in an image row
+       */
+      void initFAST(int stride);
+
+      /**
+       * @brief Runs the FAST test on a single pixel. Depends only on the input image, so it can run concurrently for different pixels
+       *
+       * @tparam CHECKED If false, the pixel must be at least fast_point_sets::fast_halo pixels away from every image border, which allows skipping the border checks
+       * @param i Column of the tested pixel
+       * @param j Row of the tested pixel
+       *
+       * @return Whether the pixel looks like a marker, like a part of the sun or like neither
+       */
+      template <bool CHECKED>
+      FastResult testFAST(int i, int j) const;
+
+      /**
+       * @brief Compares a pixel with the points of a FAST ring
+       *
+       * @tparam R The radius of the ring
+       * @param center Pointer to the tested pixel
+       * @param track_sun If true, the comparison continues after the first failed point to find out whether all of them fail
+       *
+       * @return The outcome of the comparison, never RING_OUTSIDE
+       */
+      template <int R>
+      RingResult testRing(const unsigned char* center, bool track_sun) const;
+
+      /**
+       * @brief Collects the pixels of a band of image rows that pass the FAST test. The FAST rings read up to fast_point_sets::fast_halo rows above and below the band
+       *
+       * @param row_begin The first row of the band
+       * @param row_end One past the last row of the band
+       * @param spans The pixels to test, or nullptr to test every pixel
+       * @param prescreen If true, the rows are pre-screened in groups of prescreen_rows
+       * @param threshold Only the pixels brighter than this are tested
+       * @param sun_only If true, only the pixels that are a part of the sun are kept
+       * @param events Output - the passing pixels in raster order
+       * @param scratch Helper buffers for the row pre-scan
+       */
+      void testRows(int row_begin, int row_end, const RowSpans* spans, bool prescreen, int threshold, bool sun_only, std::vector<FastEvent>& events, BandScratch& scratch) const;
+
+      /**
+       * @brief Collects all the pixels of the current image that are a part of the sun into potential_sun_points_, regardless of the searched pixels. Uses the buffers of the bands
+       *
+       * @param band_count The number of bands to split the image into
+       */
+      void findPotentialSun(int band_count);
+
+      int fast_stride_ = 0;
+      std::array<int, fast_point_sets::FastRing<3>::points.size()> fast_ring_3_offsets_;
+      std::array<int, fast_point_sets::FastRing<4>::points.size()> fast_ring_4_offsets_;
+      std::array<int, fast_point_sets::fast_interior.size()> fast_interior_offsets_;
       bool initialized_ = false;
       bool first_ = true;
 
@@ -32,11 +234,59 @@ namespace uvdar {
 
       cv::Mat image_curr_;
       cv::Mat image_check_;
+      std::vector<int> marked_indices_; //linear indices of the points of image_check_ marked while processing the current image
+      MarkReset mark_reset_ = MarkReset::LISTED;
       cv::Mat  image_view_;
       cv::Rect roi_;
 
       int step_in_period_ = 0;
 
+      PointLimit point_limit_;
+      SunCache sun_cache_;
+
+      PointGrid sun_grid_; //centroids of the sun point clusters of the current image
+
+      RowSpans region_spans_;   //the regions requested in processImageRegions
+      RowSpans combined_spans_; //the regions restricted to the valid pixels of the selected mask
+      RowSpans budget_spans_;          //the tiles not dropped due to the point limit
+      RowSpans budget_combined_spans_; //the tiles not dropped due to the point limit, restricted to the searched pixels
+      RowSpans full_spans_;              //the whole image
+      RowSpans sun_cache_spans_;         //the surroundings of the cached sun points
+      RowSpans sun_cache_search_spans_;  //the pixels searched while the cached sun is used
+      RowSpans sun_search_spans_;        //the pixels outside of the regions, searched only for the sun
+
+      static constexpr int point_limit_stripes = 8; //the number of stripes of rows after which the point limit is checked
+      static constexpr int sun_cluster_radius = 20; //sun pixels closer than this to the centroid of a sun point cluster join the cluster
+      static constexpr int sun_cluster_reach = sun_cluster_radius + 2; //a centroid lies within sun_cluster_radius of the last pixel that joined its cluster, up to the rounding of the centroids
+      std::vector<cv::Point2i> potential_sun_points_; //all the sun pixels of the current image, found once the point limit is exceeded before the sun is complete
+
+      PrescanKernel prescan_kernel_ = PrescanKernel::SCALAR;
+      prescan_fn_t prescan_fn_;
+      prescreen_fn_t prescreen_fn_;
+
+      /**
+       * @brief Signature of the brightness history kernels - these decay the brightest and the darkest values of count pixels towards each other by decay, and extend them by the current image
+       */
+      using history_fn_t = void (*)(const unsigned char* image, unsigned char* history_max, unsigned char* history_min, int count, unsigned char decay);
+      history_fn_t history_fn_;
+
+      bool temporal_ = false;
+      unsigned char temporal_decay_ = 8;
+      int temporal_min_change_ = 50;
+      cv::Mat history_max_; //the brightest recent values of each pixel
+      cv::Mat history_min_; //the darkest recent values of each pixel
+
+      bool prescreen_ = true;
+      static constexpr int prescreen_rows = 4;           //the number of rows max-pooled together by the pre-screen - the kernels assume this value
+      static constexpr int prescreen_dense_fraction = 8; //groups with more than this fraction of the columns bright are pre-scanned row by row
+
+      int thread_count_ = 1;
+      std::unique_ptr<BandWorkerPool> band_pool_;
+      std::vector<std::vector<FastEvent>> band_events_;
+      std::vector<BandScratch> band_scratch_;
+      std::vector<double> band_timings_;
+      int candidate_count_ = 0; //the marker events of the last image, including the suppressed ones
+
   };
 }
 
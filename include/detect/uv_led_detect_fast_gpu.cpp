@@ -1,7 +1,9 @@
 #include <dirent.h>
 #include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <mutex>
+#include <string>
 #include <thread>
 #include <utility>
 #include <vector>
@@ -14,13 +16,36 @@
 uvdar::UVDARLedDetectFASTGPU::UVDARLedDetectFASTGPU(bool i_gui, bool i_debug, int i_threshold, int i_threshold_diff, int i_threshold_sun, std::vector<cv::Mat> i_masks) : UVDARLedDetectFAST(i_gui, i_debug, i_threshold, i_threshold_diff, i_threshold_sun, i_masks) {
   local_size_x = 16;
   local_size_y = 16;
-  max_markers_count = 300;
+  max_markers_count = 4096;
   max_sun_pts_count = 50000;
 }
 
-void uvdar::UVDARLedDetectFASTGPU::init() {
+bool uvdar::UVDARLedDetectFASTGPU::probe(std::string& o_error, compute_lib_platform_t i_platform, const std::string& i_device_path) {
+  compute_lib_instance_t probe_inst = COMPUTE_LIB_INSTANCE_NEW;
+  probe_inst.platform = i_platform;
+  probe_inst.device_path = i_device_path.empty() ? NULL : i_device_path.c_str();
+  int code = compute_lib_init(&probe_inst);
+  if (code) {
+    char err_str[4096];
+    int err_str_len = 0;
+    compute_lib_error_str(code, err_str, &err_str_len);
+    o_error = std::string(err_str, err_str_len);
+    o_error.erase(o_error.find_last_not_of("\r\n") + 1);
+    return false;
+  }
+  compute_lib_deinit(&probe_inst);
+  o_error.clear();
+  return true;
+}
+
+void uvdar::UVDARLedDetectFASTGPU::setDevice(compute_lib_platform_t i_platform, const std::string& i_device_path) {
+  platform_    = i_platform;
+  device_path_ = i_device_path;
+}
+
+bool uvdar::UVDARLedDetectFASTGPU::init() {
   if (initialized_) {
-    return;
+    return true;
   }
 
   int code;
@@ -29,111 +54,236 @@ void uvdar::UVDARLedDetectFASTGPU::init() {
 
     // init compute lib instance
     compute_inst = COMPUTE_LIB_INSTANCE_NEW;
+    compute_inst.platform = platform_;
+    compute_inst.device_path = device_path_.empty() ? NULL : device_path_.c_str();
     if ((code = compute_lib_init(&compute_inst))) {
         compute_lib_error_str(code, err_str, &err_str_len);
         fprintf(stderr, "%.*s", err_str_len, err_str);
-        return;
+        return false;
+    }
+    if (_debug_) {
+        std::cout << "[UVDARDetectorFASTGPU]: Using the " << compute_lib_platform_name(compute_inst.active_platform) << " EGL platform, renderer: " << glGetString(GL_RENDERER) << std::endl;
     }
 
     // init compute program
     char* formatted_src;
-    if (asprintf(&formatted_src, fastlike_shader_src, local_size_x, local_size_y, _threshold_, _threshold_diff_, _threshold_sun_, max_markers_count, max_sun_pts_count) < 0)
+    if (asprintf(&formatted_src, fastlike_shader_src, local_size_x, local_size_y, max_markers_count, max_sun_pts_count) < 0)
     {
         fprintf(stderr, "Failed to format shader source!\r\n");
         compute_lib_error_str(code, err_str, &err_str_len);
-        return;
+        return false;
     }
     compute_prog = COMPUTE_LIB_PROGRAM_NEW(&compute_inst, formatted_src);
     if (compute_lib_program_init(&compute_prog)) {
         fprintf(stderr, "Failed to create program!\r\n");
         free(formatted_src);
         compute_lib_error_queue_flush(&compute_inst, stderr);
-        return;
+        return false;
     }
 
     //compute_lib_program_print_resources(&compute_prog);
 
-    // init image2d objects
-    texture_in = COMPUTE_LIB_IMAGE2D_NEW("image_in", GL_TEXTURE0, image_size.width, image_size.height, GL_R8UI, GL_READ_ONLY, GL_CLAMP_TO_EDGE, GL_LINEAR, GL_RED_INTEGER, GL_UNSIGNED_BYTE);
-    if (compute_lib_image2d_init(&compute_prog, &texture_in, 0)) {
-        fprintf(stderr, "Failed to create image2d '%s'!\r\n", texture_in.uniform_name);
+    // the thresholds are passed as a uniform, so that they can be changed without recompiling the shader
+    thresholds_uniform = COMPUTE_LIB_UNIFORM_NEW("thresholds");
+    if (compute_lib_uniform_init(&compute_prog, &thresholds_uniform)) {
+        fprintf(stderr, "Failed to create uniform '%s'!\r\n", thresholds_uniform.name);
         compute_lib_error_queue_flush(&compute_inst, stderr);
-        return;
+        return false;
+    }
+    thresholds_changed_ = true;
+
+    // the masks do not change, so each of them is uploaded only once and the selected one is bound before dispatch
+    for (auto& mask_mat : masks_) {
+      mask_textures_.push_back(COMPUTE_LIB_IMAGE2D_NEW("mask", GL_TEXTURE1, image_size.width, image_size.height, GL_R8UI, GL_READ_ONLY, GL_CLAMP_TO_EDGE, GL_LINEAR, GL_RED_INTEGER, GL_UNSIGNED_BYTE));
+      if (mask_mat.size() != image_size) { // never selected - processImage rejects masks of a different size
+        continue;
+      }
+      if (compute_lib_image2d_init(&compute_prog, &mask_textures_.back(), 0)) {
+        fprintf(stderr, "Failed to create image2d '%s'!\r\n", mask_textures_.back().uniform_name);
+        compute_lib_error_queue_flush(&compute_inst, stderr);
+        return false;
+      }
+      compute_lib_image2d_write(&compute_prog, &mask_textures_.back(), mask_mat.data);
     }
 
-    mask = COMPUTE_LIB_IMAGE2D_NEW("mask", GL_TEXTURE1, image_size.width, image_size.height, GL_R8UI, GL_READ_ONLY, GL_CLAMP_TO_EDGE, GL_LINEAR, GL_RED_INTEGER, GL_UNSIGNED_BYTE);
-    if (compute_lib_image2d_init(&compute_prog, &mask, 0)) {
-      fprintf(stderr, "Failed to create image2d '%s'!\r\n", mask.uniform_name);
+    // all-valid mask used if no mask is selected - initialized last, so it is the one bound initially
+    mask_none = COMPUTE_LIB_IMAGE2D_NEW("mask", GL_TEXTURE1, image_size.width, image_size.height, GL_R8UI, GL_READ_ONLY, GL_CLAMP_TO_EDGE, GL_LINEAR, GL_RED_INTEGER, GL_UNSIGNED_BYTE);
+    if (compute_lib_image2d_init(&compute_prog, &mask_none, 0)) {
+      fprintf(stderr, "Failed to create image2d '%s'!\r\n", mask_none.uniform_name);
       compute_lib_error_queue_flush(&compute_inst, stderr);
-      return;
+      return false;
     }
+    bound_mask_id_ = -1;
     
+    // the buffers the results are read back into - allocated only once, since they are too large for the stack
+    markers_buffer_.resize(max_markers_count);
+    sun_pts_buffer_.resize(max_sun_pts_count);
+
+    // fill the all-valid mask
+    uint32_t valid = 255;
+    compute_lib_image2d_reset(&compute_prog, &mask_none, &valid);
+
+    initialized_ = true;
+    return true;
+}
+
+uvdar::UVDARLedDetectFASTGPU::~UVDARLedDetectFASTGPU() {
+  if (initialized_) {
+    // destroy the objects of the images in flight
+    discardPending();
+    for (auto& slot : slots_) {
+      destroySlot(slot);
+    }
+
+    // destroy image2d objects
+    compute_lib_image2d_destroy(&compute_prog, &mask_none);
+    for (auto& mask_texture : mask_textures_) {
+      if (mask_texture.handle != 0) {
+        compute_lib_image2d_destroy(&compute_prog, &mask_texture);
+      }
+    }
+
+    // destroy compute program
+    compute_lib_program_destroy(&compute_prog, true);
+
+    // destroy compute lib instance
+    compute_lib_deinit(&compute_inst);
+  }
+}
+
+/* slots //{ */
+bool uvdar::UVDARLedDetectFASTGPU::initSlot(FrameSlot& slot) {
+    // init image2d object
+    slot.texture_in = COMPUTE_LIB_IMAGE2D_NEW("image_in", GL_TEXTURE0, image_size.width, image_size.height, GL_R8UI, GL_READ_ONLY, GL_CLAMP_TO_EDGE, GL_LINEAR, GL_RED_INTEGER, GL_UNSIGNED_BYTE);
+    if (compute_lib_image2d_init(&compute_prog, &slot.texture_in, 0)) {
+        fprintf(stderr, "Failed to create image2d '%s'!\r\n", slot.texture_in.uniform_name);
+        compute_lib_error_queue_flush(&compute_inst, stderr);
+        return false;
+    }
+
+    // init pixel buffer object - only used in the pipelined mode, where the image is copied into it and transferred to the texture asynchronously
+    slot.pbo = COMPUTE_LIB_PBO_NEW(image_size.width * image_size.height, GL_STREAM_DRAW);
+    if ((pipeline_depth_ > 1) && compute_lib_pbo_init(&compute_prog, &slot.pbo)) {
+        fprintf(stderr, "Failed to create pixel buffer!\r\n");
+        compute_lib_error_queue_flush(&compute_inst, stderr);
+        return false;
+    }
+
     // init SSBOs
-    markers_ssbo = COMPUTE_LIB_SSBO_NEW("markers_buffer", GL_UNSIGNED_INT, GL_DYNAMIC_DRAW);
-    if (compute_lib_ssbo_init(&compute_prog, &markers_ssbo, NULL, max_markers_count)) {
-        fprintf(stderr, "Failed to create shader storage buffer '%s'!\r\n", markers_ssbo.name);
+    slot.markers_ssbo = COMPUTE_LIB_SSBO_NEW("markers_buffer", GL_UNSIGNED_INT, GL_DYNAMIC_DRAW);
+    if (compute_lib_ssbo_init(&compute_prog, &slot.markers_ssbo, NULL, max_markers_count)) {
+        fprintf(stderr, "Failed to create shader storage buffer '%s'!\r\n", slot.markers_ssbo.name);
         compute_lib_error_queue_flush(&compute_inst, stderr);
-        return;
+        return false;
     }
 
-    sun_pts_ssbo = COMPUTE_LIB_SSBO_NEW("sun_pts_buffer", GL_UNSIGNED_INT, GL_DYNAMIC_DRAW);
-    if (compute_lib_ssbo_init(&compute_prog, &sun_pts_ssbo, NULL, max_sun_pts_count)) {
-        fprintf(stderr, "Failed to create shader storage buffer '%s'!\r\n", sun_pts_ssbo.name);
+    slot.sun_pts_ssbo = COMPUTE_LIB_SSBO_NEW("sun_pts_buffer", GL_UNSIGNED_INT, GL_DYNAMIC_DRAW);
+    if (compute_lib_ssbo_init(&compute_prog, &slot.sun_pts_ssbo, NULL, max_sun_pts_count)) {
+        fprintf(stderr, "Failed to create shader storage buffer '%s'!\r\n", slot.sun_pts_ssbo.name);
         compute_lib_error_queue_flush(&compute_inst, stderr);
-        return;
+        return false;
     }
 
     // init atomic counter buffer objects
-    markers_count_acbo = COMPUTE_LIB_ACBO_NEW("markers_count", GL_UNSIGNED_INT, GL_DYNAMIC_DRAW);
-    if (compute_lib_acbo_init(&compute_prog, &markers_count_acbo, NULL, 0)) {
-        fprintf(stderr, "Failed to create atomic counter '%s'!\r\n", markers_count_acbo.name);
+    slot.markers_count_acbo = COMPUTE_LIB_ACBO_NEW("markers_count", GL_UNSIGNED_INT, GL_DYNAMIC_DRAW);
+    if (compute_lib_acbo_init(&compute_prog, &slot.markers_count_acbo, NULL, 0)) {
+        fprintf(stderr, "Failed to create atomic counter '%s'!\r\n", slot.markers_count_acbo.name);
         compute_lib_error_queue_flush(&compute_inst, stderr);
-        return;
+        return false;
     }
-    sun_pts_count_acbo = COMPUTE_LIB_ACBO_NEW("sun_pts_count", GL_UNSIGNED_INT, GL_DYNAMIC_DRAW);
-    if (compute_lib_acbo_init(&compute_prog, &sun_pts_count_acbo, NULL, 0)) {
-        fprintf(stderr, "Failed to create atomic counter '%s'!\r\n", sun_pts_count_acbo.name);
+    slot.sun_pts_count_acbo = COMPUTE_LIB_ACBO_NEW("sun_pts_count", GL_UNSIGNED_INT, GL_DYNAMIC_DRAW);
+    if (compute_lib_acbo_init(&compute_prog, &slot.sun_pts_count_acbo, NULL, 0)) {
+        fprintf(stderr, "Failed to create atomic counter '%s'!\r\n", slot.sun_pts_count_acbo.name);
         compute_lib_error_queue_flush(&compute_inst, stderr);
-        return;
+        return false;
     }
 
-    // dummy clear of mask
-    uint32_t zero = 255;
-    compute_lib_image2d_reset(&compute_prog, &mask, &zero);
+    return true;
+}
 
-    initialized_ = true;
+void uvdar::UVDARLedDetectFASTGPU::destroySlot(FrameSlot& slot) {
+  compute_lib_ssbo_destroy(&compute_prog, &slot.markers_ssbo);
+  compute_lib_ssbo_destroy(&compute_prog, &slot.sun_pts_ssbo);
+  compute_lib_acbo_destroy(&compute_prog, &slot.markers_count_acbo);
+  compute_lib_acbo_destroy(&compute_prog, &slot.sun_pts_count_acbo);
+  if (slot.pbo.handle != 0) {
+    compute_lib_pbo_destroy(&compute_prog, &slot.pbo);
+  }
+  compute_lib_image2d_destroy(&compute_prog, &slot.texture_in);
 }
 
-uvdar::UVDARLedDetectFASTGPU::~UVDARLedDetectFASTGPU() {
-  if (initialized_) {
-    // destroy SSBO objects
-    compute_lib_ssbo_destroy(&compute_prog, &markers_ssbo);
-    compute_lib_ssbo_destroy(&compute_prog, &sun_pts_ssbo);
+bool uvdar::UVDARLedDetectFASTGPU::waitForSlot(FrameSlot& slot) {
+  if (slot.fence == 0) {
+    return true;
+  }
+  GLenum result = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, fence_timeout_ns);
+  glDeleteSync(slot.fence);
+  slot.fence = 0;
+  if ((result != GL_ALREADY_SIGNALED) && (result != GL_CONDITION_SATISFIED)) {
+    std::cerr << "[UVDARDetectorFASTGPU]: The GPU did not finish processing an image in time!" << std::endl;
+    return false;
+  }
+  return true;
+}
 
-    // destroy atomic counter buffer objects
-    compute_lib_acbo_destroy(&compute_prog, &markers_count_acbo);
-    compute_lib_acbo_destroy(&compute_prog, &sun_pts_count_acbo);
+void uvdar::UVDARLedDetectFASTGPU::discardPending() {
+  for (auto& slot : slots_) {
+    waitForSlot(slot);
+  }
+  next_slot_ = 0;
+  in_flight_ = 0;
+}
+//}
 
-    // destroy image2d objects
-    compute_lib_image2d_destroy(&compute_prog, &texture_in);
-    compute_lib_image2d_destroy(&compute_prog, &mask);
+bool uvdar::UVDARLedDetectFASTGPU::setPipelineDepth(int i_depth) {
+  if ((i_depth < 1) || (i_depth > max_pipeline_depth)) {
+    return false;
+  }
+  if (initialized_) { // the slots are created again on the next image, with or without the pixel buffers
+    discardPending();
+    for (auto& slot : slots_) {
+      destroySlot(slot);
+    }
+    slots_.clear();
+  }
+  pipeline_depth_ = i_depth;
+  next_slot_ = 0;
+  in_flight_ = 0;
+  if (_debug_) {
+    std::cout << "[UVDARDetectorFASTGPU]: Processing " << pipeline_depth_ << " image(s) at once, the points are retrieved " << getResultDelay() << " image(s) late" << std::endl;
+  }
+  return true;
+}
 
-    // destroy compute program
-    compute_lib_program_destroy(&compute_prog, true);
+bool uvdar::UVDARLedDetectFASTGPU::setSunCache(int i_refresh_period, double i_max_change) {
+  sun_cache_.configure(i_refresh_period, i_max_change);
+  return true;
+}
 
-    // destroy compute lib instance
-    compute_lib_deinit(&compute_inst);
-  }
+void uvdar::UVDARLedDetectFASTGPU::setThresholds(int i_threshold, int i_threshold_diff, int i_threshold_sun) {
+  UVDARLedDetectFAST::setThresholds(i_threshold, i_threshold_diff, i_threshold_sun);
+  sun_cache_.invalidate(); //the sun found with other thresholds may differ
 }
 
 bool uvdar::UVDARLedDetectFASTGPU::processImage(const cv::Mat i_image, std::vector<cv::Point2i>& detected_points, std::vector<cv::Point2i>& sun_points, int mask_id) {
+  auto detection_start = std::chrono::steady_clock::now();
   detected_points = std::vector<cv::Point2i>();
   sun_points = std::vector<cv::Point2i>();
   image_curr_     = i_image;
 
   if (!initialized_) {
+    if (init_failed_) {
+      return false;
+    }
     image_size = i_image.size();
-    init();
+    if (!init()) {
+      std::cerr << "[UVDARDetectorFASTGPU]: Failed to initialize the GPU pipeline!" << std::endl;
+      if (compute_inst.initialised) {
+        compute_lib_deinit(&compute_inst);
+      }
+      init_failed_ = true;
+      return false;
+    }
   }
 
   if (mask_id >= (int)(masks_.size())) {
@@ -152,39 +302,121 @@ bool uvdar::UVDARLedDetectFASTGPU::processImage(const cv::Mat i_image, std::vect
     (image_curr_).copyTo(image_view_);
   }
 
-  fast_det_pt_t markers[max_markers_count];
-  fast_det_pt_t sun_pts[max_sun_pts_count];
-  uint32_t sun_points_cnt_val;
-  uint32_t markers_cnt_val;
+  // the slots are created on demand, so that the pipeline depth can be changed after the initialization
+  while ((int)(slots_.size()) < pipeline_depth_) {
+    slots_.emplace_back();
+    if (!initSlot(slots_.back())) {
+      std::cerr << "[UVDARDetectorFASTGPU]: Failed to create the buffers of an image in flight!" << std::endl;
+      destroySlot(slots_.back());
+      slots_.pop_back();
+      return false;
+    }
+  }
+
+  submitImage(slots_[next_slot_], mask_id);
+  next_slot_ = (next_slot_ + 1) % pipeline_depth_;
+  in_flight_++;
+  if (in_flight_ < pipeline_depth_) { // the pipeline is still filling up, so there is no result to retrieve yet
+    return true;
+  }
+
+  // with a full pipeline, the slot to be used next holds the oldest image
+  bool success = retrieveResults(slots_[next_slot_], detected_points, sun_points, detection_start);
+  in_flight_--;
+  return success;
+}
+
+void uvdar::UVDARLedDetectFASTGPU::submitImage(FrameSlot& slot, int mask_id) {
+  auto upload_start = std::chrono::steady_clock::now();
+
+  // write input image data to GPU - in the pipelined mode, the copy into the pixel buffer is the only part done by the CPU, the transfer to the texture runs while the GPU processes the previous images
+  if (slot.pbo.handle != 0) {
+    compute_lib_pbo_write(&compute_prog, &slot.pbo, image_curr_.data);
+    compute_lib_image2d_write_pbo(&compute_prog, &slot.texture_in, &slot.pbo);
+  } else {
+    compute_lib_image2d_write(&compute_prog, &slot.texture_in, image_curr_.data);
+  }
+
+  auto dispatch_start = std::chrono::steady_clock::now();
+
+  // bind the objects of this slot, switch the mask only if a different one is selected
+  compute_lib_image2d_bind(&compute_prog, &slot.texture_in);
+  if (mask_id != bound_mask_id_) {
+    compute_lib_image2d_bind(&compute_prog, (mask_id >= 0) ? &mask_textures_[mask_id] : &mask_none);
+    bound_mask_id_ = mask_id;
+  }
+  compute_lib_ssbo_bind(&compute_prog, &slot.markers_ssbo);
+  compute_lib_ssbo_bind(&compute_prog, &slot.sun_pts_ssbo);
 
   // reset atomic counter buffer objects
-  compute_lib_acbo_write_uint_val(&compute_prog, &markers_count_acbo, 0);
-  compute_lib_acbo_write_uint_val(&compute_prog, &sun_pts_count_acbo, 0);
+  compute_lib_acbo_write_uint_val(&compute_prog, &slot.markers_count_acbo, 0);
+  compute_lib_acbo_write_uint_val(&compute_prog, &slot.sun_pts_count_acbo, 0);
   
-  // write input image data + mask data to GPU
-  compute_lib_image2d_write(&compute_prog, &texture_in, image_curr_.data);
-  compute_lib_image2d_write(&compute_prog, &mask, (mask_id>=0)?masks_[mask_id].data:nullptr);
+  if (thresholds_changed_) {
+    GLint thresholds[3] = {_threshold_, _threshold_diff_, _threshold_sun_};
+    compute_lib_uniform_write(&compute_prog, &thresholds_uniform, thresholds);
+    thresholds_changed_ = false;
+  }
 
-  // dispatch compute shader
+  // dispatch compute shader, the fence marks the moment the results of this image are ready
   compute_lib_program_dispatch(&compute_prog, image_size.width / local_size_x, image_size.height / local_size_y, 1);
+  slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  glFlush();
+  slot.mask_id = mask_id;
+
+  auto dispatch_end = std::chrono::steady_clock::now();
+  stage_times_.upload   += std::chrono::duration<double, std::milli>(dispatch_start - upload_start).count();
+  stage_times_.dispatch += std::chrono::duration<double, std::milli>(dispatch_end - dispatch_start).count();
+}
+
+bool uvdar::UVDARLedDetectFASTGPU::retrieveResults(FrameSlot& slot, std::vector<cv::Point2i>& detected_points, std::vector<cv::Point2i>& sun_points, std::chrono::steady_clock::time_point detection_start) {
+  fast_det_pt_t* markers = markers_buffer_.data();
+  fast_det_pt_t* sun_pts = sun_pts_buffer_.data();
+  uint32_t sun_points_cnt_val;
+  uint32_t markers_cnt_val;
+
+  auto wait_start = std::chrono::steady_clock::now();
+  if (!waitForSlot(slot)) {
+    return false;
+  }
+  auto readback_start = std::chrono::steady_clock::now();
 
   // retrieve detected markers
-  compute_lib_acbo_read_uint_val(&compute_prog, &markers_count_acbo, &markers_cnt_val);
+  compute_lib_acbo_read_uint_val(&compute_prog, &slot.markers_count_acbo, &markers_cnt_val);
   if (markers_cnt_val > max_markers_count) markers_cnt_val = max_markers_count;
-  if (markers_cnt_val > 0) compute_lib_ssbo_read(&compute_prog, &markers_ssbo, (void*) markers, markers_cnt_val);
+  candidate_count_ = (int)(markers_cnt_val);
+  if (markers_cnt_val > 0) compute_lib_ssbo_read(&compute_prog, &slot.markers_ssbo, (void*) markers, markers_cnt_val);
 
-  // retrieve detected sun points
-  compute_lib_acbo_read_uint_val(&compute_prog, &sun_pts_count_acbo, &sun_points_cnt_val);
+  // retrieve detected sun points - every saturated pixel of the sun is a sun point here, so with the sun caching, their count decides whether the cached ones can be used instead of reading them back
+  compute_lib_acbo_read_uint_val(&compute_prog, &slot.sun_pts_count_acbo, &sun_points_cnt_val);
   if (sun_points_cnt_val > max_sun_pts_count) sun_points_cnt_val = max_sun_pts_count;
-  if (sun_points_cnt_val > 0) compute_lib_ssbo_read(&compute_prog, &sun_pts_ssbo, (void*) sun_pts, sun_points_cnt_val);
-
-  // find centroids of concentrated detected markers
-  cpuFindMarkerCentroids(markers, markers_cnt_val, 5, detected_points);
+  bool sun_cache = sun_cache_.enabled();
+  bool sun_cache_hit = sun_cache && sun_cache_.usable(image_size, slot.mask_id) && !sun_cache_.changed((int)(sun_points_cnt_val));
+  if (sun_cache_hit) {
+    sun_points = sun_cache_.points();
+  } else {
+    if (sun_points_cnt_val > 0) compute_lib_ssbo_read(&compute_prog, &slot.sun_pts_ssbo, (void*) sun_pts, sun_points_cnt_val);
+    sun_points.reserve(sun_points_cnt_val);
+    for (uint32_t i = 0; i < sun_points_cnt_val; i++){
+      sun_points.push_back(cv::Point(sun_pts[i].x,sun_pts[i].y));
+    }
+    if (sun_cache) {
+      sun_cache_.store(sun_points, (int)(sun_points_cnt_val), image_size, slot.mask_id);
+    }
+  }
 
-  for (uint32_t i = 0; i < sun_points_cnt_val; i++){
-    sun_points.push_back(cv::Point(sun_pts[i].x,sun_pts[i].y));
+  auto readback_end = std::chrono::steady_clock::now();
+  stage_times_.wait     += std::chrono::duration<double, std::milli>(readback_start - wait_start).count();
+  stage_times_.readback += std::chrono::duration<double, std::milli>(readback_end - readback_start).count();
+  stage_times_.images++;
+  if (_debug_ && ((stage_times_.images % 100) == 0)) {
+    double n = (double)(stage_times_.images);
+    std::cout << "[UVDARDetectorFASTGPU]: Mean stage times over " << stage_times_.images << " images - upload: " << stage_times_.upload / n << " ms, dispatch: " << stage_times_.dispatch / n << " ms, wait: " << stage_times_.wait / n << " ms, readback: " << stage_times_.readback / n << " ms" << std::endl;
   }
 
+  // find centroids of concentrated detected markers
+  marker_clusters_.findCentroids(markers, markers_cnt_val, 5, image_size, detected_points);
+
   /* for (int i = 0; i< sun_points_cnt_val; i++){ */
   /*   std::cout << "Sun pt: " << sun_points[i].x << ":" << sun_points[i].y << std::endl; */
   /* } */
@@ -196,71 +428,18 @@ bool uvdar::UVDARLedDetectFASTGPU::processImage(const cv::Mat i_image, std::vect
   /* } */
 
   // filter markers using detected sun points
-  for (int i = 0; i < (int)(detected_points.size()); i++) { //iterate over the detected marker points
-    for (int j = 0; j < (int)(sun_points.size()); j++) { //iterate over the detected sun points
-      if (cv::norm(detected_points[i] - (sun_points[j])) < 25) { //if the current detected marker point is close to the sun, it might be merely glare, so we discard it rather than to have numerous false detections here
-        detected_points.erase(detected_points.begin() + i);
-        i--;
-        break;
-      }
-    }
-  }
-
-  return true;
-}
+  point_limit_.filterGlare(detected_points, sun_points, image_size);
 
-extern "C" int compare_fast_det_pt_xy1d(const void* a, const void* b) {
-    fast_det_pt_t* pt1 = (fast_det_pt_t*) a;
-    fast_det_pt_t* pt2 = (fast_det_pt_t*) b;
-    int res = pt1->y - pt2->y;
-    if (res == 0) res = pt1->x - pt2->x;
-    return res;
-}
+  // the GPU processes the whole image at once, so the point limit can only be applied to the result
+  point_limit_.start(image_size);
+  if (point_limit_.check(detected_points, sun_points)) {
+    detected_points.clear();
+  }
 
-uint32_t uvdar::UVDARLedDetectFASTGPU::cpuFindMarkerCentroids(fast_det_pt_t* markers, uint32_t init_cnt, uint32_t distance_px, std::vector<cv::Point2i>& detected_points) {
-    ivec3_t filtered_markers[init_cnt];
-    uint32_t filtered_cnt = 0;
-    uint32_t max_dist2 = (distance_px * distance_px);
-    uint32_t min_dist2, dist2;
-    int32_t closest_marker;
-    uint32_t i, j;
-    int32_t x2, y2, n;
-    fast_det_pt_t pt;
-
-    qsort(markers, init_cnt, sizeof(fast_det_pt_t), compare_fast_det_pt_xy1d);
-
-    for (i = 0; i < init_cnt; i++) {
-        pt = markers[i];
-
-        min_dist2 = max_dist2;
-        closest_marker = -1;
-
-        for (j = 0; j < filtered_cnt; j++) {
-            n = filtered_markers[j].z;
-            x2 = filtered_markers[j].x / n;
-            y2 = filtered_markers[j].y / n;
-            dist2 = (x2 - pt.x)*(x2 - pt.x) + (y2 - pt.y)*(y2 - pt.y);
-            if (dist2 < min_dist2) {
-                min_dist2 = dist2;
-                closest_marker = j;
-            }
-        }
-
-        if (closest_marker != -1) {
-            filtered_markers[closest_marker].x += pt.x;
-            filtered_markers[closest_marker].y += pt.y;
-            filtered_markers[closest_marker].z += 1;
-        } else {
-            filtered_markers[filtered_cnt].x = pt.x;
-            filtered_markers[filtered_cnt].y = pt.y;
-            filtered_markers[filtered_cnt].z = 1;
-            filtered_cnt++;
-        }
-    }
+  if (sun_cache) {
+    sun_cache_.record(sun_cache_hit, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - detection_start).count());
+  }
 
-    for (i = 0; i < filtered_cnt; i++) {
-        detected_points.push_back(cv::Point(filtered_markers[i].x / filtered_markers[i].z, filtered_markers[i].y / filtered_markers[i].z));
-    }
-    return filtered_cnt;
+  return true;
 }
 
@@ -4,26 +4,117 @@
 extern "C" {
 #include "../compute_lib/compute_lib.h"
 }
+#include <chrono>
+#include <string>
+#include <vector>
 #include "uv_led_detect_fast.h"
-
-typedef struct {
-    uint16_t y;
-    uint16_t x;
-} fast_det_pt_t;
+#include "marker_clusters.h"
 
 namespace uvdar {
 
+  /**
+   * @brief Host-side durations of the stages of the GPU detection, in milliseconds, summed over the retrieved images
+   */
+  struct GPUStageTimes {
+    unsigned long images = 0; ///< the number of images retrieved
+    double upload = 0.0;      ///< writing the images to the GPU - in the pipelined mode only the copy into the pixel buffer, the transfer itself runs asynchronously
+    double dispatch = 0.0;    ///< binding the objects and starting the compute shader
+    double wait = 0.0;        ///< waiting for the GPU to finish the images being retrieved - close to zero if the pipelining hides the processing
+    double readback = 0.0;    ///< reading the counters and the points back
+  };
+
   class UVDARLedDetectFASTGPU : public UVDARLedDetectFAST {
     public:
       UVDARLedDetectFASTGPU(bool i_gui, bool i_debug, int i_threshold, int i_threshold_diff, int i_threshold_sun, std::vector<cv::Mat> i_masks);
       ~UVDARLedDetectFASTGPU();
       bool processImage(const cv::Mat i_image, std::vector<cv::Point2i>& detected_points, std::vector<cv::Point2i>& sun_points, int mask_id=-1);
+      bool setSunCache(int i_refresh_period, double i_max_change);
+      const SunCacheStats& getSunCacheStats() const { return sun_cache_.stats(); }
+      void setThresholds(int i_threshold, int i_threshold_diff, int i_threshold_sun);
+      void setPointLimit(int i_max_points, bool i_tile_budget) { point_limit_.setLimit(i_max_points, i_tile_budget); }
+      const DetectionOverload& getOverload() const { return point_limit_.overload(); }
+      int getCandidateCount() const { return candidate_count_; }
+      bool setPipelineDepth(int i_depth);
+      int getResultDelay() const {
+        return pipeline_depth_ - 1;
+      }
+
+      /**
+       * @brief Retrieves the durations of the stages of the detection since the detector was created
+       *
+       * @return The summed durations
+       */
+      const GPUStageTimes& getStageTimes() const {
+        return stage_times_;
+      }
+
+      /**
+       * @brief The largest supported number of images processed at once
+       */
+      static constexpr int max_pipeline_depth = 3;
+
+      /**
+       * @brief Checks whether a compute_lib instance (and with it the GPU context) can be created on this machine
+       *
+       * @param o_error Output - the reason of the failure, if any
+       * @param i_platform The EGL platform to try, as in setDevice
+       * @param i_device_path The DRM device to try, as in setDevice
+       *
+       * @return True if the GPU can be used by this detector
+       */
+      static bool probe(std::string& o_error, compute_lib_platform_t i_platform = COMPUTE_LIB_PLATFORM_GBM, const std::string& i_device_path = "");
+
+      /**
+       * @brief Selects the EGL platform and the device used for the GPU context. Must be called before the first image is processed. Without a DRM render node (e.g. in containers), the device or the surfaceless platform can still run the detection on a software renderer such as Mesa llvmpipe
+       *
+       * @param i_platform The EGL platform
+       * @param i_device_path The DRM device (e.g. /dev/dri/renderD129) for the GBM and the device platforms - empty for /dev/dri/renderD128 with GBM, or for the first device with the device platform
+       */
+      void setDevice(compute_lib_platform_t i_platform, const std::string& i_device_path);
 
     private:
-      void init();
-      uint32_t cpuFindMarkerCentroids(fast_det_pt_t* markers, uint32_t init_cnt, uint32_t distance_px, std::vector<cv::Point2i>& detected_points);
+
+      /**
+       * @brief The objects used by a single image in flight - each image has its own, so that the next image can be uploaded while the previous ones are processed and read back
+       */
+      struct FrameSlot {
+        compute_lib_image2d_t texture_in;
+        compute_lib_pbo_t pbo; ///< only created in the pipelined mode
+        compute_lib_acbo_t markers_count_acbo, sun_pts_count_acbo;
+        compute_lib_ssbo_t markers_ssbo, sun_pts_ssbo;
+        GLsync fence = 0;      ///< signalled when the GPU finished processing the image, 0 if no image is in flight
+        int mask_id = -1;
+      };
+
+      bool init();
+      bool initSlot(FrameSlot& slot);
+      void destroySlot(FrameSlot& slot);
+
+      /**
+       * @brief Uploads the current image into a slot and starts its processing without waiting for it
+       */
+      void submitImage(FrameSlot& slot, int mask_id);
+
+      /**
+       * @brief Waits for the image of a slot to be processed, and retrieves its points
+       */
+      bool retrieveResults(FrameSlot& slot, std::vector<cv::Point2i>& detected_points, std::vector<cv::Point2i>& sun_points, std::chrono::steady_clock::time_point detection_start);
+
+      /**
+       * @brief Waits for the GPU to finish the image of a slot, if any
+       *
+       * @return False if the waiting timed out
+       */
+      bool waitForSlot(FrameSlot& slot);
+
+      /**
+       * @brief Waits for all images in flight without retrieving their points
+       */
+      void discardPending();
+
 
       bool initialized_ = false;
+      bool init_failed_ = false;
       bool first_ = true;
 
       bool use_masks = true;
@@ -34,11 +125,28 @@ namespace uvdar {
       cv::Mat image_curr_;
       cv::Mat  image_view_;
 
+      compute_lib_platform_t platform_ = COMPUTE_LIB_PLATFORM_GBM;
+      std::string device_path_;
       compute_lib_instance_t compute_inst;
       compute_lib_program_t compute_prog;
-      compute_lib_image2d_t texture_in, mask;
-      compute_lib_acbo_t markers_count_acbo, sun_pts_count_acbo;
-      compute_lib_ssbo_t markers_ssbo, sun_pts_ssbo;
+      compute_lib_image2d_t mask_none;
+      std::vector<compute_lib_image2d_t> mask_textures_; //one texture per mask, uploaded once during initialization
+      int bound_mask_id_ = -1;
+      compute_lib_uniform_t thresholds_uniform;
+
+      std::vector<FrameSlot> slots_;
+      int pipeline_depth_ = 1;
+      int next_slot_ = 0; //the slot the next image is uploaded into
+      int in_flight_ = 0; //the number of images submitted, but not retrieved yet
+      GPUStageTimes stage_times_;
+
+      PointLimit point_limit_;
+      SunCache sun_cache_;
+      int candidate_count_ = 0; //the raw marker points of the last retrieved image, before their merging
+
+      std::vector<fast_det_pt_t> markers_buffer_, sun_pts_buffer_; //the points read back from the GPU
+      MarkerClusters marker_clusters_; //merges the raw points of the markers
+      static constexpr GLuint64 fence_timeout_ns = 1000000000;
 
       uint32_t local_size_x;
       uint32_t local_size_y;
@@ -51,14 +159,16 @@ namespace uvdar {
 
 #define LOCAL_SIZE_X %d
 #define LOCAL_SIZE_Y %d
-#define FAST_THRESHOLD %d
-#define FAST_THRESHOLD_DIFF %d
-#define FAST_THRESHOLD_SUN %d
+#define FAST_THRESHOLD thresholds.x
+#define FAST_THRESHOLD_DIFF thresholds.y
+#define FAST_THRESHOLD_SUN thresholds.z
 #define MAX_MARKERS_COUNT %d
 #define MAX_SUN_PTS_COUNT %d
 
 layout (local_size_x = LOCAL_SIZE_X, local_size_y = LOCAL_SIZE_Y, local_size_z = 1) in;
 
+uniform ivec3 thresholds;
+
 layout(rgba8ui, binding = 0) readonly uniform highp uimage2D image_in;
 
 layout(rgba8ui, binding = 1) readonly uniform highp uimage2D mask;
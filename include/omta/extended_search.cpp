@@ -3,138 +3,201 @@
 namespace uvdar
 {
 
-    ExtendedSearch::ExtendedSearch(double decay_factor)
+    SlidingPolyFit::SlidingPolyFit(double decay_factor, int poly_order)
     {
         decay_factor_ = decay_factor;
+        poly_order_ = std::clamp(poly_order, 0, max_poly_order);
+        powers_ = std::max(2 * poly_order_ + 1, 2);
+        clear();
     }
 
-    ExtendedSearch::~ExtendedSearch()
+    void SlidingPolyFit::clear()
     {
+        n_ = 0;
+        t_origin_ = 0.0;
+        t_newest_ = 0.0;
+        pow_w_.fill(0.0);
+        pow_w2_.fill(0.0);
+        for (int axis = 0; axis < 2; ++axis)
+        {
+            val_w_[axis].fill(0.0);
+            val_w2_[axis].fill(0.0);
+        }
+        sq_w_.fill(0.0);
+        sum_t_ = 0.0;
+        sum_t2_ = 0.0;
     }
 
-    std::tuple<std::vector<double>, Eigen::VectorXd> ExtendedSearch::polyReg(const std::vector<double> &coordinate, const std::vector<double> &time, const std::vector<double> &weights, const int & poly_order)
+    void SlidingPolyFit::accumulate(double t, double x, double y, double sign)
     {
-        Eigen::MatrixXd design_mat(time.size(), poly_order + 1);
-        Eigen::VectorXd pixel_vect = Eigen::VectorXd::Map(&coordinate.front(), coordinate.size());
-        Eigen::VectorXd weight_vect = Eigen::VectorXd::Map(&weights.front(), weights.size());
-        Eigen::VectorXd result(poly_order + 1);
+        double weight = sign * exp(-decay_factor_ * (t_newest_ - t));
+        double weight2 = sign * exp(-2.0 * decay_factor_ * (t_newest_ - t));
+        double time = t - t_origin_;
+        double values[2] = {x, y};
 
-        Eigen::MatrixXd weight_mat = weight_vect.asDiagonal();
-
-        // fill the Design matrix
-        for (int i = 0; i < (int)time.size(); ++i)
+        double power = 1.0;
+        for (int k = 0; k < powers_; ++k)
         {
-            for (int j = 0; j < poly_order + 1; ++j)
+            pow_w_[k] += weight * power;
+            pow_w2_[k] += weight2 * power;
+            if (k <= poly_order_)
             {
-                if (j == 0)
-                    design_mat(i, j) = 1;
-                else
-                    design_mat(i, j) = pow(time[i], j);
+                for (int axis = 0; axis < 2; ++axis)
+                {
+                    val_w_[axis][k] += weight * power * values[axis];
+                    val_w2_[axis][k] += weight2 * power * values[axis];
+                }
             }
+            power *= time;
         }
-
-        Eigen::MatrixXd weighed_design_mat = weight_mat * design_mat;
-        Eigen::VectorXd weighted_pixel_vect = weight_mat * pixel_vect;
-
-        // Solve for weighted linear least squares fit
-        result = weighed_design_mat.householderQr().solve(weighted_pixel_vect);
-        std::vector<double> coeff;
-        for (int i = 0; i < result.size(); ++i)
+        for (int axis = 0; axis < 2; ++axis)
         {
-            coeff.push_back(result[i]);
+            sq_w_[axis] += weight * values[axis] * values[axis];
         }
-
-        auto prediction = design_mat * result;
-
-        return {coeff, prediction};
+        sum_t_ += sign * time;
+        sum_t2_ += sign * time * time;
+        n_ += (int)sign;
     }
 
-    std::vector<double> ExtendedSearch::calcNormalizedWeightVect(const std::vector<double> &time)
+    void SlidingPolyFit::add(double t, double x, double y)
     {
-        std::vector<double> weights;
-        double sum_weights = 0.0;
-        double reference_time = time.end()[-1];
-        for (int i = 0; i < (int)time.size(); ++i)
+        if (n_ == 0)
         {
-            double time_dist = reference_time - time[i];
-            double weight = exp(-decay_factor_ * time_dist);
-            sum_weights += weight;
-            weights.push_back(weight);
+            clear();
+            t_origin_ = t;
+            t_newest_ = t;
         }
+        else if (t > t_newest_)
+        {
+            // the weights are relative to the newest point, so all of the older ones decay
+            double decay = exp(-decay_factor_ * (t - t_newest_));
+            double decay2 = decay * decay;
+            for (int k = 0; k < powers_; ++k)
+            {
+                pow_w_[k] *= decay;
+                pow_w2_[k] *= decay2;
+            }
+            for (int axis = 0; axis < 2; ++axis)
+            {
+                for (int k = 0; k <= poly_order_; ++k)
+                {
+                    val_w_[axis][k] *= decay;
+                    val_w2_[axis][k] *= decay2;
+                }
+                sq_w_[axis] *= decay;
+            }
+            t_newest_ = t;
+        }
+        accumulate(t, x, y, 1.0);
+    }
 
-        // normalize to sum up to 1
-        for (auto &weight : weights)
+    void SlidingPolyFit::remove(double t, double x, double y)
+    {
+        accumulate(t, x, y, -1.0);
+        if (n_ <= 0)
         {
-            weight /= sum_weights;
+            clear();
         }
+    }
 
-        return weights;
+    double SlidingPolyFit::weightedMean(int axis) const
+    {
+        return val_w_[axis][0] / pow_w_[0];
     }
 
-    double ExtendedSearch::calcWeightedMean(const std::vector<double> &values, const std::vector<double> &weights)
+    double SlidingPolyFit::weightedMeanTime() const
     {
-        if (weights.size() != values.size())
-            return -1;
+        return t_origin_ + pow_w_[1] / pow_w_[0];
+    }
 
-        double weighted_sum = 0.0;
+    double SlidingPolyFit::weightedSTD(int axis) const
+    {
+        if (n_ == 1)
+            return -1.0;
 
-        for (int i = 0; i < (int)values.size(); i++)
-        {
-            weighted_sum += (values[i] * weights[i]);
-        }
+        double mean = weightedMean(axis);
+        double ss = std::max(sq_w_[axis] / pow_w_[0] - mean * mean, 0.0);
+        return sqrt(ss / (n_ - 1));
+    }
 
-        double w_mean = weighted_sum;
-        return w_mean;
+    double SlidingPolyFit::timeVariation() const
+    {
+        double mean = pow_w_[1] / pow_w_[0];
+        return std::max(sum_t2_ - 2.0 * mean * sum_t_ + n_ * mean * mean, 0.0);
     }
 
-    double ExtendedSearch::calcWSTD(const std::vector<double> &values, const std::vector<double> &weights, const double &mean)
+    void SlidingPolyFit::fit(int axis, int order, Vector &o_coeff) const
     {
+        order = std::min(order, poly_order_);
+        int fitted_order = std::min(order, n_ - 1);
 
-        double ss = 0.0;
-        int n = (int)values.size();
-        for (int i = 0; i < n; ++i)
+        Matrix normal_mat(fitted_order + 1, fitted_order + 1);
+        Vector normal_vect(fitted_order + 1);
+        for (int i = 0; i < fitted_order + 1; ++i)
         {
-            ss += (weights[i] * pow(values[i] - mean, 2));
+            for (int j = 0; j < fitted_order + 1; ++j)
+            {
+                normal_mat(i, j) = pow_w2_[i + j];
+            }
+            normal_vect(i) = val_w2_[axis][i];
         }
 
-        if (n == 1)
-            return -1.0;
-
-        double w_std = sqrt(ss / (n - 1));
-        return w_std;
+        o_coeff.setZero(order + 1);
+        o_coeff.head(fitted_order + 1) = normal_mat.ldlt().solve(normal_vect);
     }
 
-    double ExtendedSearch::calcWSSR(const Eigen::VectorXd &predictions, const std::vector<double> &values, const std::vector<double> &weights)
+    double SlidingPolyFit::weightedSSR(int axis, const Vector &coeff) const
     {
+        double sum_squared_residuals = sq_w_[axis];
+        for (int i = 0; i < coeff.size(); ++i)
+        {
+            sum_squared_residuals -= 2.0 * coeff(i) * val_w_[axis][i];
+            for (int j = 0; j < coeff.size(); ++j)
+            {
+                sum_squared_residuals += coeff(i) * coeff(j) * pow_w_[i + j];
+            }
+        }
+        return std::max(sum_squared_residuals / pow_w_[0], 0.0);
+    }
 
-        double sum_squared_residuals = 0;
-        for (int i = 0; i < (int)values.size(); i++)
+    void SlidingPolyFit::shiftCoefficients(const Vector &coeff, double reference_time, std::vector<double> &o_coeff) const
+    {
+        // p(t - origin) = sum_k coeff_k (s + shift)^k, with s = t - reference_time, expanded by the binomial theorem
+        double shift = reference_time - t_origin_;
+        o_coeff.assign(coeff.size(), 0.0);
+        for (int k = 0; k < coeff.size(); ++k)
         {
-            sum_squared_residuals += (weights[i] * pow((predictions(i) - values[i]), 2));
+            double binomial = 1.0;
+            double power = 1.0;
+            for (int j = k; j >= 0; --j)
+            {
+                o_coeff[j] += coeff(k) * binomial * power;
+                binomial = binomial * j / (k - j + 1);
+                power *= shift;
+            }
         }
-        return sum_squared_residuals;
     }
 
-    double ExtendedSearch::confidenceInterval(const PredictionStatistics &prediction_vals, const std::vector<double> &time, const std::vector<double> &values, const std::vector<double> weights, const int &wanted_percentage)
+    ExtendedSearch::ExtendedSearch()
     {
+    }
 
-        double w_ssr = calcWSSR(prediction_vals.predicted_vals_past, values, weights);
+    ExtendedSearch::~ExtendedSearch()
+    {
+    }
+
+    double ExtendedSearch::confidenceInterval(const PredictionStatistics &prediction_vals, const double &w_ssr, const int &n, const double &var_time, const int &wanted_percentage)
+    {
 
-        const int n = (int)values.size();
         const int dof = n - (int)prediction_vals.coeff.size();
 
-        // earlier caught - here to guarantee standalone functionality 
+        // earlier caught - here to guarantee standalone functionality
         if (prediction_vals.mean_independent == -1.0 || prediction_vals.mean_dependent == -1.0 || dof <= 0)
         {
             return -1;
         }
 
         double unb_estimate_error_var = w_ssr / dof;
-        double var_time = 0.0;
-        for (auto t : time)
-        {
-            var_time += pow((t - prediction_vals.mean_independent), 2);
-        }
 
         double standard_error = sqrt(unb_estimate_error_var + (1 + 1 / n + ((prediction_vals.time_pred - prediction_vals.mean_independent) / var_time)));
 
@@ -155,4 +218,4 @@ namespace uvdar
         return false;
     }
 
-} // uvdar
\ No newline at end of file
+} // uvdar
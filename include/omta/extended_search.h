@@ -1,3 +1,5 @@
+#pragma once
+
 #include <ros/console.h>
 #include <opencv2/highgui/highgui.hpp>
 #include <Eigen/Dense>
@@ -12,64 +14,141 @@ namespace uvdar{
         double time_pred = -1;
         bool poly_reg_computed = false;
         bool extended_search = false;
-        std::vector<double> coeff;
-        Eigen::VectorXd predicted_vals_past; 
+        std::vector<double> coeff;       // in powers of the time
+        std::vector<double> coeff_local; // in powers of the time since time_pred - unlike coeff, precise to evaluate with large time stamps
         double mean_dependent;
         double mean_independent;
         double predicted_coordinate = -1;
         double confidence_interval = -1;
+
+        /**
+         * @brief resets the values to the defaults, keeping the allocated storage of the coefficients
+         */
+        void reset(){
+            time_pred = -1;
+            poly_reg_computed = false;
+            extended_search = false;
+            coeff.clear();
+            coeff_local.clear();
+            predicted_coordinate = -1;
+            confidence_interval = -1;
+        }
     };
-    
-    class ExtendedSearch{
-        
-        private: 
+
+    /**
+     * @brief Exponentially weighted polynomial regression of the x and y coordinates of a sliding window of points over time.
+     * The weighted sums of the normal equations are kept up to date, so adding or removing a point costs O(order) and a fit O(order^3), regardless of the number of points.
+     * The weights decay with the age of a point relative to the newest one, as exp(-decay_factor*age) normalized to a unit sum, and the regression minimizes the sum of the squared weighted residuals
+     */
+    class SlidingPolyFit{
+
+        public:
+            static constexpr int max_poly_order = 4;
+            using Matrix = Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, 0, max_poly_order + 1, max_poly_order + 1>;
+            using Vector = Eigen::Matrix<double, Eigen::Dynamic, 1, 0, max_poly_order + 1, 1>;
+
+        private:
+            static constexpr int max_powers = 2*max_poly_order + 1;
+
             double decay_factor_;
+            int poly_order_;
+            int powers_;        // the number of the power sums kept - the normal equations of the order need 2*order + 1 powers of the time
+            double t_origin_;   // the times are stored relative to this, to keep the power sums well conditioned
+            double t_newest_;   // the time of the newest point, with the unit weight
+            int n_ = 0;
+
+            // sums weighted by exp(-decay_factor*age)
+            std::array<double, max_powers> pow_w_;
+            std::array<std::array<double, max_poly_order + 1>, 2> val_w_;
+            std::array<double, 2> sq_w_;
+            // sums weighted by the square of the weight, which are the weights of the squared residuals
+            std::array<double, max_powers> pow_w2_;
+            std::array<std::array<double, max_poly_order + 1>, 2> val_w2_;
+            // unweighted sums of the times
+            double sum_t_, sum_t2_;
+
+            void accumulate(double t, double x, double y, double sign);
+
+        public:
+            SlidingPolyFit(double, int);
 
             /**
-             * @brief calcuate weighted sum of squared residuals 
-             * @param predictions predictions for each past coordinate
-             * @param values x or y coordinates
-             * @param weights weight vector
-             * @return sum_squared_residuals 
+             * @brief removes all points
              */
-            double calcWSSR(const Eigen::VectorXd&, const std::vector<double>&, const std::vector<double>&);
+            void clear();
 
-        public:
-            ExtendedSearch(double);
-            ~ExtendedSearch();
+            /**
+             * @brief adds a point, the times are expected to be non-decreasing
+             * @param t time in seconds
+             * @param x coordinate
+             * @param y coordinate
+             */
+            void add(double, double, double);
 
             /**
-             * @brief Calculate weighted polynomial regression 
-             * @param coordinate dependent vector 
-             * @param time independent vector 
-             * @param weights weight vector
-             * @return regression coefficients + predicted values for each data value
+             * @brief removes a previously added point. The times stay relative to the first added point, so the fit loses precision as the points move away from it - for the orders 3 and 4 within tens of removals. The owner is expected to rebuild the fit from its points after about as many removals as it holds points, as the Sequence does
+             * @param t time in seconds
+             * @param x coordinate
+             * @param y coordinate
              */
-            std::tuple<std::vector<double>, Eigen::VectorXd> polyReg(const std::vector<double>&, const std::vector<double>&, const std::vector<double>&, const int &);
+            void remove(double, double, double);
+
+            int size() const {
+                return n_;
+            }
 
             /**
-             * @brief calculates normalized weight vector with exponential decay function
-             * @param time vector
-             * @return weight vector
+             * @brief weighted mean of a coordinate
+             * @param axis 0 for x, 1 for y
              */
-            std::vector<double> calcNormalizedWeightVect(const std::vector<double>&);
+            double weightedMean(int) const;
 
             /**
-             * @brief calculate the weighted mean
-             * @param values x or y coordinates
-             * @param weights weight vector
-             * @return double 
+             * @brief weighted mean of the times
              */
-            double calcWeightedMean(const std::vector<double>&, const std::vector<double>&);
+            double weightedMeanTime() const;
 
             /**
-             * @brief calculates the weighted standard deviation
-             * @param values x or y coordinates
-             * @param weights vector
-             * @param mean double
-             * @return weighted standard deviation
+             * @brief weighted standard deviation of a coordinate
+             * @param axis 0 for x, 1 for y
+             * @return -1 for a single point
              */
-            double calcWSTD(const std::vector<double>&, const std::vector<double>&, const double&);
+            double weightedSTD(int) const;
+
+            /**
+             * @brief sum of the squared differences of the times from their weighted mean
+             */
+            double timeVariation() const;
+
+            /**
+             * @brief fits the polynomial of a coordinate. If there are not more points than the order, they are interpolated by a polynomial of a lower order and the higher coefficients are zero
+             * @param axis 0 for x, 1 for y
+             * @param order the order of the polynomial, at most the order given in the constructor
+             * @param o_coeff output - the coefficients in powers of the time since the origin
+             */
+            void fit(int, int, Vector&) const;
+
+            /**
+             * @brief weighted sum of the squared residuals of a fitted polynomial
+             * @param axis 0 for x, 1 for y
+             * @param coeff the coefficients retrieved by fit()
+             */
+            double weightedSSR(int, const Vector&) const;
+
+            /**
+             * @brief converts the fitted coefficients to powers of the time since the reference time
+             * @param coeff the coefficients retrieved by fit()
+             * @param reference_time the time where the converted polynomial has its origin, 0 for the powers of the time itself
+             * @param o_coeff output - the converted coefficients
+             */
+            void shiftCoefficients(const Vector&, double, std::vector<double>&) const;
+    };
+    
+    class ExtendedSearch{
+        
+        public:
+            ExtendedSearch();
+            ~ExtendedSearch();
 
             /**
              * @brief check if point lies within box 
@@ -84,13 +163,13 @@ namespace uvdar{
              * @brief compute the confidence interval by computing the regression accuracy and multiplying with wanted t-quantil percentage
              * 
              * @param prediction_vals statistics values 
-             * @param time vector of independent variable
-             * @param values x or y coordinates
-             * @param weighs weight vector
+             * @param w_ssr weighted sum of squared residuals of the regression
+             * @param n number of the points
+             * @param var_time sum of the squared differences of the times from their weighted mean
              * @param wanted_percentage wanted percentage for the t-quantil
              * @return -1, if not possible to compute CI from poly regression 
              * @return value, if interval can be computed
              */
-            double confidenceInterval(const PredictionStatistics&, const std::vector<double>&, const std::vector<double>&, const std::vector<double>, const int&);
+            double confidenceInterval(const PredictionStatistics&, const double&, const int&, const double&, const int&);
     };
-} // uvdar
\ No newline at end of file
+} // uvdar
@@ -5,7 +5,7 @@ using namespace uvdar;
 OMTA::OMTA(const loadedParamsForOMTA& i_params){
 
     *loaded_params_ = i_params;
-    extended_search_ = std::make_unique<ExtendedSearch>(loaded_params_->decay_factor);
+    extended_search_ = std::make_unique<ExtendedSearch>();
 }
 
 void OMTA::setDebugFlags(bool i_debug){
@@ -33,127 +33,102 @@ bool OMTA::setSequences(std::vector<std::vector<bool>> i_sequences){
 
 void OMTA::processBuffer(const mrs_msgs::ImagePointsWithFloatStampedConstPtr pts_msg) {
 
-    std::vector<PointState> current_frame;
-    for ( auto point_time_stamp : pts_msg->points) {
+    current_frame_.clear();
+    for (const auto & point_time_stamp : pts_msg->points) {
         PointState p;
         p.point = cv::Point(point_time_stamp.x, point_time_stamp.y);
         p.led_state = true;
         p.insert_time = pts_msg->stamp;
-        current_frame.push_back(p);
+        current_frame_.push_back(p);
     }
     
-    findClosestPixelAndInsert(current_frame);
+    findClosestPixelAndInsert(current_frame_, no_nn_);
+    expandedSearch(no_nn_);
     cleanPotentialBuffer();
 }
 
-void OMTA::findClosestPixelAndInsert(std::vector<PointState> & current_frame) {   
+void OMTA::findClosestPixelAndInsert(const std::vector<PointState> & current_frame, std::vector<PointState> & no_nn) {   
     
-    std::vector<seqPointer> p_gen_seq;
-    {
-        std::scoped_lock lock(mutex_gen_sequences_);
-        p_gen_seq = gen_sequences_;
-    }    
-    std::vector<PointState> no_nn;
-    for(auto & curr_point : current_frame){
-        bool nn = false;
-        {
-            std::scoped_lock lock(mutex_gen_sequences_);
-            for(auto seq = p_gen_seq.begin(); seq != p_gen_seq.end(); ++seq){
-                PointState last_inserted = (*seq)->end()[-1];
-                cv::Point2d bb_left_top = last_inserted.point - cv::Point2d(loaded_params_->max_px_shift);
-                cv::Point2d bb_right_bottom = last_inserted.point + cv::Point2d(loaded_params_->max_px_shift);
-                if(extended_search_->isInsideBB( curr_point.point, bb_left_top, bb_right_bottom)){
-                    nn = true;
-                    insertPointToSequence(**seq, curr_point);    
-                    p_gen_seq.erase(seq);
-                    break;
-                }else{
-                    nn = false;
-                }
-            }
-        }
-        if(nn == false){
+    no_nn.clear();
+    std::scoped_lock lock(mutex_gen_sequences_);
+    last_positions_.clear();
+    for(const auto & seq : gen_sequences_){
+        seq->inserted = false;
+        last_positions_.push_back(seq->lastPoint());
+    }
+    sequence_grid_.build(last_positions_, cv::Point2d(loaded_params_->max_px_shift));
+
+    // each point goes to the first unmatched sequence whose last point is within the max_px_shift, each sequence receives at most one point
+    for(const auto & curr_point : current_frame){
+        int seq_index = sequence_grid_.matchPoint(curr_point.point);
+        if(seq_index >= 0){
+            Sequence & seq = *gen_sequences_[seq_index];
+            insertPointToSequence(seq, curr_point);    
+            // a point found without the prediction has no statistics
+            seq.x_statistics.reset();
+            seq.y_statistics.reset();
+            seq.inserted = true;
+        }else{
             no_nn.push_back(curr_point);
         }
     }
-    expandedSearch(no_nn, p_gen_seq);
 }
 
-void OMTA::expandedSearch(std::vector<PointState>& no_nn_current_frame, std::vector<seqPointer>& sequences_no_insert){
+void OMTA::expandedSearch(std::vector<PointState>& no_nn_current_frame){
     std::scoped_lock lock(mutex_gen_sequences_);
 
     if((int)no_nn_current_frame.size() != 0){
         double insert_time = no_nn_current_frame[0].insert_time.toSec() + prediction_margin_;
-        // std::vector<SeqWithTrajectory> sequences;
-        // for(int k = 0; k < (int)sequences_no_insert.size(); ++k){
-        for(auto it_seq = sequences_no_insert.begin();  it_seq != sequences_no_insert.end();){
+        for(auto & seq : gen_sequences_){
 
-            if((*it_seq)->size() == 0)continue;
+            // a sequence without any "on"-point has nothing to predict from
+            if(seq->inserted || seq->fit().size() == 0) continue;
             
-            if(!checkSequenceValidityWithNewInsert(*it_seq)){
+            if(!checkSequenceValidityWithNewInsert(seq)){
                 continue;
             }
 
-
-            std::vector<double> x,y,time;
-            for(const auto point : **it_seq){
-                if(point.led_state){
-                    x.push_back(point.point.x);
-                    y.push_back(point.point.y);
-                    time.push_back(point.insert_time.toSec());
-                }
-            }
-
-            PointState& last_point = (*it_seq)->end()[-1]; 
-            PredictionStatistics x_predictions = selectStatisticsValues(x, time, insert_time, loaded_params_->max_px_shift.x);
-            PredictionStatistics y_predictions = selectStatisticsValues(y, time, insert_time, loaded_params_->max_px_shift.y);
-            last_point.x_statistics = x_predictions;
-            last_point.y_statistics = y_predictions;
-            double x_predicted = last_point.x_statistics.predicted_coordinate;
-            double y_predicted = last_point.y_statistics.predicted_coordinate;
+            selectStatisticsValues(*seq, 0, insert_time, loaded_params_->max_px_shift.x, seq->x_statistics);
+            selectStatisticsValues(*seq, 1, insert_time, loaded_params_->max_px_shift.y, seq->y_statistics);
+            double x_predicted = seq->x_statistics.predicted_coordinate;
+            double y_predicted = seq->y_statistics.predicted_coordinate;
 
             // TODO: make upper limit settable, e.g. if only one UAV is expected, value can be set higher. for swarming applications 
-            last_point.x_statistics.confidence_interval = ( last_point.x_statistics.confidence_interval > 10.0 ) ? 10.0 : last_point.x_statistics.confidence_interval;
-            last_point.y_statistics.confidence_interval = ( last_point.y_statistics.confidence_interval > 10.0 ) ? 10.0 : last_point.y_statistics.confidence_interval;
+            seq->x_statistics.confidence_interval = ( seq->x_statistics.confidence_interval > 10.0 ) ? 10.0 : seq->x_statistics.confidence_interval;
+            seq->y_statistics.confidence_interval = ( seq->y_statistics.confidence_interval > 10.0 ) ? 10.0 : seq->y_statistics.confidence_interval;
 
-            last_point.x_statistics.confidence_interval = ( last_point.x_statistics.confidence_interval < 3.0 ) ? 3.0 : last_point.x_statistics.confidence_interval;
-            last_point.y_statistics.confidence_interval = ( last_point.y_statistics.confidence_interval < 3.0 ) ? 3.0 : last_point.y_statistics.confidence_interval;
+            seq->x_statistics.confidence_interval = ( seq->x_statistics.confidence_interval < 3.0 ) ? 3.0 : seq->x_statistics.confidence_interval;
+            seq->y_statistics.confidence_interval = ( seq->y_statistics.confidence_interval < 3.0 ) ? 3.0 : seq->y_statistics.confidence_interval;
 
-            double x_conf = last_point.x_statistics.confidence_interval;
-            double y_conf = last_point.y_statistics.confidence_interval; 
+            double x_conf = seq->x_statistics.confidence_interval;
+            double y_conf = seq->y_statistics.confidence_interval; 
              
             cv::Point2d bb_left_top = cv::Point2d( (x_predicted - x_conf), (y_predicted - y_conf) );
             cv::Point2d bb_right_bottom = cv::Point2d( (x_predicted + x_conf), (y_predicted + y_conf) );
             
             if(debug_){
-                std::cout << "[OMTA]: Predicted Point: x = " << x_predicted << " y = " << y_predicted << " Prediction Interval: x = " << x_conf << " y = " << y_conf << " seq_size " << x.size();
+                std::cout << "[OMTA]: Predicted Point: x = " << x_predicted << " y = " << y_predicted << " Prediction Interval: x = " << x_conf << " y = " << y_conf << " seq_size " << seq->fit().size();
                 std::cout << "\n";
             }
 
-            bool deleted = false;
-            for(auto it_frame = no_nn_current_frame.begin(); it_frame != no_nn_current_frame.end();){
+            for(auto it_frame = no_nn_current_frame.begin(); it_frame != no_nn_current_frame.end(); ++it_frame){
                 if(extended_search_->isInsideBB(it_frame->point, bb_left_top, bb_right_bottom)){
-                    it_frame->x_statistics = last_point.x_statistics;
-                    it_frame->y_statistics = last_point.y_statistics;
-                    insertPointToSequence(*(*it_seq), *it_frame);
-                    it_frame = no_nn_current_frame.erase(it_frame);
-                    it_seq = sequences_no_insert.erase(it_seq); 
-                    deleted = true;
+                    // the inserted point takes over the statistics of the prediction
+                    insertPointToSequence(*seq, *it_frame);
+                    no_nn_current_frame.erase(it_frame);
+                    seq->inserted = true;
                     break;
-                }else{   
-                    ++it_frame;
                 }
             }
-            if(!deleted){
-                ++it_seq;
-            }
         }
     }
 
 
     // for sequences with no newly inserted point, add virtual point
-    for(auto seq : sequences_no_insert){
-        insertVPforSequencesWithNoInsert(seq);
+    for(auto & seq : gen_sequences_){
+        if(!seq->inserted){
+            insertVPforSequencesWithNoInsert(*seq);
+        }
     }
 
 
@@ -163,17 +138,18 @@ void OMTA::expandedSearch(std::vector<PointState>& no_nn_current_frame, std::vec
 
         int diff = (int)gen_sequences_.size() - loaded_params_->max_buffer_length;
         for(int i = 0; i < diff; ++i){
-            gen_sequences_.erase(gen_sequences_.end() - 1); 
+            retireSequence(std::move(gen_sequences_.back()));
+            gen_sequences_.pop_back(); 
         }
         return;
     }
 
     // for the points, still no NN found -> start new sequence
-    for(auto point : no_nn_current_frame){
-        std::vector<PointState> vect;
-        vect.reserve(loaded_params_->stored_seq_len_factor*original_sequences_[0].size());
-        vect.emplace_back(point);
-        gen_sequences_.emplace_back(std::make_shared<std::vector<PointState>>(vect));
+    for(const auto & point : no_nn_current_frame){
+        seqPointer seq = acquireSequence();
+        insertPointToSequence(*seq, point);
+        seq->inserted = true;
+        gen_sequences_.push_back(std::move(seq));
     }
     
 
@@ -184,7 +160,7 @@ bool OMTA::checkSequenceValidityWithNewInsert(const seqPointer & seq){
     if((int)seq->size() >  loaded_params_->max_ones_consecutive){
         int cnt = 0;
         for(int i = 0; i < loaded_params_->max_ones_consecutive; ++i){
-            if(seq->end()[-(i+1)].led_state == true) ++cnt; 
+            if(seq->ledState(seq->size() - (i+1)) == true) ++cnt; 
         }
         if(cnt >  loaded_params_->max_ones_consecutive) return false; 
     }
@@ -192,64 +168,80 @@ bool OMTA::checkSequenceValidityWithNewInsert(const seqPointer & seq){
     if((int)seq->size() > loaded_params_->max_zeros_consecutive){
         int cnt =0;
         for(int i = 0; i < loaded_params_->max_zeros_consecutive; ++i){
-             if(!(seq->end()[-(i+1)].led_state)) ++cnt;
+             if(!(seq->ledState(seq->size() - (i+1)))) ++cnt;
         }
         if(cnt > loaded_params_->max_zeros_consecutive) return false;
     }
     return true; 
 }
 
-void OMTA::insertPointToSequence(std::vector<PointState> & sequence, const PointState signal){
-    sequence.push_back(signal);            
-    if(sequence.size() > (original_sequences_[0].size()* loaded_params_->stored_seq_len_factor)){
-        sequence.erase(sequence.begin());
+void OMTA::insertPointToSequence(Sequence & sequence, const PointState & signal){
+    sequence.push(signal.point, signal.insert_time.toSec(), signal.led_state);
+}
+
+void OMTA::insertVPforSequencesWithNoInsert(Sequence & seq){
+    seq.push(seq.lastPoint(), ros::Time::now().toSec(), false);
+}
+
+seqPointer OMTA::acquireSequence(){
+    for(auto it = retired_sequences_.begin(); it != retired_sequences_.end(); ++it){
+        if(it->use_count() == 1){
+            seqPointer seq = std::move(*it);
+            *it = std::move(retired_sequences_.back());
+            retired_sequences_.pop_back();
+            seq->clear();
+            return seq;
+        }
     }
+    int capacity = std::max(1, (int)original_sequences_[0].size() * loaded_params_->stored_seq_len_factor);
+    return std::make_shared<Sequence>(capacity, loaded_params_->decay_factor, loaded_params_->poly_order);
 }
 
-void OMTA::insertVPforSequencesWithNoInsert(seqPointer & seq){
-    PointState pVirtual;
-    pVirtual = seq->end()[-1];
-    pVirtual.insert_time = ros::Time::now();
-    pVirtual.led_state = false;
-    insertPointToSequence(*seq, pVirtual);
+void OMTA::retireSequence(seqPointer && seq){
+    // the retired sequences are limited, the rest is freed once the retrieved results release them
+    if((int)retired_sequences_.size() < loaded_params_->max_buffer_length){
+        retired_sequences_.push_back(std::move(seq));
+    }else{
+        seq.reset();
+    }
 }
 
-PredictionStatistics OMTA::selectStatisticsValues(const std::vector<double>& values, const std::vector<double>& time, const double& insert_time, const int& max_pix_shift){
+void OMTA::selectStatisticsValues(const Sequence& sequence, const int& axis, const double& insert_time, const int& max_pix_shift, PredictionStatistics& statistics){
 
-    auto weight_vect = extended_search_->calcNormalizedWeightVect(time);
-    
-    PredictionStatistics statistics;
-    statistics.mean_dependent = extended_search_->calcWeightedMean(values, weight_vect); 
-    statistics.mean_independent = extended_search_->calcWeightedMean(time, weight_vect); 
+    const SlidingPolyFit & fit = sequence.fit();
+    const int n = fit.size();
+
+    statistics.reset();
+    statistics.mean_dependent = fit.weightedMean(axis);
+    statistics.mean_independent = fit.weightedMeanTime();
     statistics.time_pred = insert_time;
     statistics.poly_reg_computed = false;
 
-    auto std = extended_search_->calcWSTD(values, weight_vect, statistics.mean_dependent); 
+    auto std = fit.weightedSTD(axis);
 
     bool conf_interval_bool = false;
 
 
     int poly_order = loaded_params_->poly_order;
 
-    if((int)values.size() < poly_order && values.size() > 0){
-        poly_order = values.size();
+    if(n < poly_order && n > 0){
+        poly_order = n;
     }
 
-    if((int)values.size() > 1){
+    if(n > 1){
         
-        auto [coeff, predicted_vals_past] = extended_search_->polyReg(values, time, weight_vect, poly_order);
-        statistics.coeff = coeff;
-        statistics.predicted_vals_past = predicted_vals_past;
+        fit.fit(axis, poly_order, coeff_);
+        fit.shiftCoefficients(coeff_, 0.0, statistics.coeff);
+        fit.shiftCoefficients(coeff_, insert_time, statistics.coeff_local);
 
-        bool all_coeff_zero = std::all_of(coeff.begin(), coeff.end(), [](double coeff){return coeff == 0.0;});
+        bool all_coeff_zero = std::all_of(statistics.coeff.begin(), statistics.coeff.end(), [](double coeff){return coeff == 0.0;});
         if(!all_coeff_zero){ 
-            for(int i = 0; i < (int)coeff.size(); ++i){
-                statistics.predicted_coordinate += coeff[i]*pow(insert_time, i);
-            }
+            // evaluated at the insert time itself, where only the constant term of the local coefficients remains
+            statistics.predicted_coordinate += statistics.coeff_local[0];
             statistics.poly_reg_computed = true;
         }
 
-        statistics.confidence_interval = extended_search_->confidenceInterval(statistics, time, values, weight_vect, loaded_params_->conf_probab_percent);
+        statistics.confidence_interval = extended_search_->confidenceInterval(statistics, fit.weightedSSR(axis, coeff_), n, fit.timeVariation(), loaded_params_->conf_probab_percent);
         conf_interval_bool = (statistics.confidence_interval == -1.0) ? false : true; 
     }
     
@@ -266,7 +258,6 @@ PredictionStatistics OMTA::selectStatisticsValues(const std::vector<double>& val
     }
     
     statistics.extended_search = true;
-    return statistics;
 
 }
 
@@ -278,8 +269,8 @@ void OMTA::cleanPotentialBuffer(){
         int number_zeros_till_seq_deleted = (loaded_params_->max_zeros_consecutive + loaded_params_->allowed_BER_per_seq);
         if((int)((*it_seq)->size()) > number_zeros_till_seq_deleted){
             int cnt = 0;
-            for(auto it_seq_element : *(*it_seq)){
-                if(!it_seq_element.led_state){
+            for(int i = 0; i < (*it_seq)->size(); ++i){
+                if(!(*it_seq)->ledState(i)){
                     cnt++;
                     if(cnt > number_zeros_till_seq_deleted)
                         break;
@@ -289,6 +280,7 @@ void OMTA::cleanPotentialBuffer(){
             }
             if(cnt > number_zeros_till_seq_deleted){
                 deleted = true;
+                retireSequence(std::move(*it_seq));
                 it_seq = gen_sequences_.erase(it_seq);
                 continue;
             }
@@ -297,46 +289,31 @@ void OMTA::cleanPotentialBuffer(){
     }
 }
 
-std::vector<std::pair<seqPointer, int>> OMTA::getResults(){
+void OMTA::getResults(std::vector<std::pair<seqPointer, int>> & o_results){
 
     std::scoped_lock lock(mutex_gen_sequences_);
-    std::vector<std::pair<seqPointer, int>> retrieved_signals;
+    o_results.clear();
     if(debug_) std::cout << "[OMTA]: The retrieved signals:{\n";
-    for (auto sequence : gen_sequences_){
-        std::vector<bool> led_states;
-        std::vector<PointState> return_seq; 
-        for(auto p : *sequence){
-            return_seq.push_back(p);
-        }
-
-        std::vector<PointState> selected;
-        if ((int)return_seq.size() > (int)original_sequences_[0].size()){
-            int diff = (int)return_seq.size() - (int)original_sequences_[0].size();
-            for(int i = diff; i < (int)return_seq.size(); ++i){
-                selected.push_back(return_seq[i]);
-            }
-        }else{
-            selected = return_seq;
-        }
-        for (auto point : selected){
-            led_states.push_back(point.led_state);        
+    for (const auto & sequence : gen_sequences_){
+        // only the newest points, up to the length of the original sequences, are matched
+        int first = std::max(0, sequence->size() - (int)original_sequences_[0].size());
+        led_states_.clear();
+        for(int i = first; i < sequence->size(); ++i){
+            led_states_.push_back(sequence->ledState(i));        
         }
         if(debug_){
             std::cout << "[ ";
-            for(auto state : led_states){
+            for(auto state : led_states_){
                 if(state) std::cout << "1,";
                 else std::cout << "0,";
             }
             std::cout << "]\n";
         }
 
-        int id = matcher_->matchSignalWithCrossCorr(led_states);
-        auto sequence_copy = sequence; 
-        retrieved_signals.push_back(std::make_pair(sequence_copy, id));
+        int id = matcher_->matchSignalWithCrossCorr(led_states_);
+        o_results.emplace_back(sequence, id);
     }
     if(debug_)std::cout << "}\n";
-    
-    return retrieved_signals;
 }
 
 OMTA::~OMTA() {
@@ -1,23 +1,20 @@
 #pragma once
 
 #include "extended_search.h"
+#include "sequence_grid.h"
+#include "sequence.h"
 #include <mrs_msgs/ImagePointsWithFloatStamped.h>
 #include "signal_matcher/signal_matcher.h"
 
 namespace uvdar
 {
 
+    // a point of the current frame
     struct PointState{
         cv::Point2d point;
         bool led_state; 
         ros::Time insert_time;
-
-        PredictionStatistics x_statistics;
-        PredictionStatistics y_statistics;
-        
     };
-    
-    using seqPointer = std::shared_ptr<std::vector<PointState>>;
 
     // loaded params from the launch file and passed to the OMTA
     struct loadedParamsForOMTA{
@@ -45,23 +42,33 @@ namespace uvdar
         std::vector<std::vector<bool>> original_sequences_;
         std::mutex mutex_gen_sequences_;
         std::vector<seqPointer> gen_sequences_;
+        std::vector<seqPointer> retired_sequences_; // deleted sequences, reused once they are not referenced by the retrieved results anymore
         std::unique_ptr<SignalMatcher> matcher_;
         std::unique_ptr<ExtendedSearch> extended_search_;
+        SequenceGrid sequence_grid_;
+        std::vector<cv::Point2d> last_positions_;
+
+        // buffers reused in every frame
+        std::vector<PointState> current_frame_;
+        std::vector<PointState> no_nn_;
+        SlidingPolyFit::Vector coeff_;
+        std::vector<bool> led_states_;
 
         /**
-         * @brief check if distance between the last point in the sequences and point in current frame is within the "max_px_shift" allowed distance. If yes, point in current frame is inserted otherwise point is pushed into vector for expandedSearch()
+         * @brief check if distance between the last point in the sequences and point in current frame is within the "max_px_shift" allowed distance. If yes, point in current frame is inserted otherwise point is pushed into vector for expandedSearch().
+         * The sequences are looked up in a SequenceGrid, so the association takes expected linear time in the number of points
          * @param current_frame vector of points in the current frame
+         * @param no_nn output - the points with no nearest neighbour in the current sequences
          */
-        void findClosestPixelAndInsert(std::vector<PointState>&);
+        void findClosestPixelAndInsert(const std::vector<PointState>&, std::vector<PointState>&);
         
         /**
-         * @brief receives: sequences with no inserted points + points in current frame that were not inserted.
+         * @brief receives: points in current frame that were not inserted, checks them against the sequences with no inserted points.
          * Calls selectStatisticsValues() and checks if point in current frame is in bounding box of the prediction. If it is inside bounding box the point is insert to the query sequence 
          * 
          * @param no_nn_current_frame vector of points in the current frame, with no nearest neighbour in the current sequences
-         * @param sequences_no_insert vector of sequences with no new inserted points in the current frame
          */
-        void expandedSearch(std::vector<PointState>& , std::vector<seqPointer>&);
+        void expandedSearch(std::vector<PointState>&);
         
         /**
          * @brief checks if it is allowed to insert a new "on"-point to the passed sequence
@@ -72,27 +79,38 @@ namespace uvdar
         bool checkSequenceValidityWithNewInsert(const seqPointer &);
 
         /**
-         * @brief push the current point to the end of the sequence + delete first element if seq exceeds the wanted sequence length for the polynomial regression
+         * @brief push the current point to the end of the sequence - the oldest point is overwritten if seq reached the wanted sequence length for the polynomial regression
          * @param sequence sequence where query point will be inserted
          * @param signal query point
          */
-        void insertPointToSequence(std::vector<PointState> &, const PointState);
+        void insertPointToSequence(Sequence &, const PointState &);
 
         /**
          * @brief insert "off"-point at the end of the sequence with current time with same position as last point in the sequence
          * @param seq seq where the "off" will be inserted 
          */
-        void insertVPforSequencesWithNoInsert(seqPointer &);
+        void insertVPforSequencesWithNoInsert(Sequence &);
+
+        /**
+         * @brief retrieves an empty sequence - a retired one if possible, to avoid allocating a new one
+         */
+        seqPointer acquireSequence();
+
+        /**
+         * @brief keeps a deleted sequence for reuse by acquireSequence()
+         */
+        void retireSequence(seqPointer &&);
 
         /**
          * @brief computes the expected prediction for a new appearing point by doing a polynomial regression and computing the prediction interval
-         * @param values x or y coordinate
-         * @param time insert time of the x or y coordinate
+         * @param sequence the sequence, whose regression of the "on"-points is used
+         * @param axis 0 for the x coordinate, 1 for the y coordinate
          * @param insert_time the current time stamp for which the next pixel should be inserted
          * @param  max_pix_shift the max_pix_shift loaded from the launch file
-         * @return PredictionStatistics 
+         * @param o_statistics output - the PredictionStatistics, reusing the storage of the coefficients
          */
-        PredictionStatistics selectStatisticsValues(const std::vector<double>&, const std::vector<double>&, const double&, const int &);
+        void selectStatisticsValues(const Sequence&, const int&, const double&, const int &, PredictionStatistics&);
+        friend class OMTAStatisticsTest; // checks selectStatisticsValues() against the former regression
 
         /**
          * @brief checks all sequences if one violates the current sequence settings or if the time since a new inserted bit is too long ago
@@ -123,9 +141,9 @@ namespace uvdar
 
         /**
         * @brief compares the original sequences with the extracted ones.
-        * @return returns the sequences with seq id to the bp_tim.cpp 
+        * @param o_results output - the sequences with seq id for the blink processor. The vector is reused, so that its storage is not allocated again in every frame
         */
-        std::vector<std::pair<seqPointer, int>> getResults();
+        void getResults(std::vector<std::pair<seqPointer, int>> &);
         
     };    
 } // namespace uvdar
\ No newline at end of file
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "extended_search.h"
+#include <ros/time.h>
+
+namespace uvdar
+{
+
+    /**
+     * @brief The history of a tracked point, kept in a fixed-capacity ring buffer - the oldest point is overwritten once the buffer is full.
+     * The coordinates, times and LED states are stored in separate arrays, and the prediction statistics only for the newest point.
+     * The "on"-points are also kept in a SlidingPolyFit, updated with every push, so the prediction does not have to go through the whole history
+     */
+    class Sequence {
+
+    private:
+        std::vector<double> x_;
+        std::vector<double> y_;
+        std::vector<double> t_;
+        std::vector<uint8_t> led_state_;
+        int start_ = 0; // the position of the oldest point in the arrays
+        int size_ = 0;
+        SlidingPolyFit fit_;
+        int removals_ = 0; // the points removed from the fit since it was rebuilt
+
+        int position(int index) const {
+            int pos = start_ + index;
+            return (pos >= (int)x_.size()) ? (pos - (int)x_.size()) : pos;
+        }
+
+    public:
+
+        PredictionStatistics x_statistics; ///< the statistics of the newest point
+        PredictionStatistics y_statistics; ///< the statistics of the newest point
+        bool inserted = false;             ///< true if a point of the current frame was inserted to the sequence
+
+        /**
+         * @param capacity the maximal number of the stored points
+         * @param decay_factor the decay of the weights of the older points in the regression
+         * @param poly_order the order of the polynomial regression
+         */
+        Sequence(int capacity, double decay_factor, int poly_order) : x_(capacity), y_(capacity), t_(capacity), led_state_(capacity), fit_(decay_factor, poly_order) {}
+
+        /**
+         * @brief empties the sequence and resets its statistics, keeping the allocated storage
+         */
+        void clear(){
+            start_ = 0;
+            size_ = 0;
+            removals_ = 0;
+            fit_.clear();
+            inserted = false;
+            x_statistics.reset();
+            y_statistics.reset();
+        }
+
+        /**
+         * @brief appends a point as the newest one, overwriting the oldest point if the sequence is full. The statistics are kept
+         * @param point image position
+         * @param time insert time in seconds
+         * @param led_state true for a received point, false for a virtual one
+         */
+        void push(const cv::Point2d & point, double time, bool led_state){
+            int pos;
+            if(size_ < capacity()){
+                pos = position(size_);
+                size_++;
+            }else{
+                pos = start_;
+                start_ = position(1);
+                if(led_state_[pos]){
+                    fit_.remove(t_[pos], x_[pos], y_[pos]);
+                    removals_++;
+                }
+            }
+            x_[pos] = point.x;
+            y_[pos] = point.y;
+            t_[pos] = time;
+            led_state_[pos] = led_state;
+
+            // the removals accumulate rounding errors in the sums of the fit, so it is rebuilt from time to time
+            if(removals_ >= capacity()){
+                fit_.clear();
+                removals_ = 0;
+                for(int i = 0; i < size_; ++i){
+                    int p = position(i);
+                    if(led_state_[p]) fit_.add(t_[p], x_[p], y_[p]);
+                }
+            }else if(led_state){
+                fit_.add(time, point.x, point.y);
+            }
+        }
+
+        int size() const {
+            return size_;
+        }
+
+        /**
+         * @brief the regression of the "on"-points in the sequence
+         */
+        const SlidingPolyFit & fit() const {
+            return fit_;
+        }
+
+        int capacity() const {
+            return (int)x_.size();
+        }
+
+        // the points are indexed from the oldest (0) to the newest (size() - 1)
+        double x(int index) const {
+            return x_[position(index)];
+        }
+
+        double y(int index) const {
+            return y_[position(index)];
+        }
+
+        cv::Point2d point(int index) const {
+            int pos = position(index);
+            return cv::Point2d(x_[pos], y_[pos]);
+        }
+
+        double time(int index) const {
+            return t_[position(index)];
+        }
+
+        ros::Time insertTime(int index) const {
+            return ros::Time(t_[position(index)]);
+        }
+
+        bool ledState(int index) const {
+            return led_state_[position(index)];
+        }
+
+        cv::Point2d lastPoint() const {
+            return point(size_ - 1);
+        }
+
+        ros::Time lastInsertTime() const {
+            return insertTime(size_ - 1);
+        }
+    };
+
+    using seqPointer = std::shared_ptr<Sequence>;
+
+} // namespace uvdar
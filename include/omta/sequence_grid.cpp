@@ -0,0 +1,97 @@
+#include "sequence_grid.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace uvdar;
+
+void SequenceGrid::build(const std::vector<cv::Point2d> & positions, const cv::Point2d & max_px_shift){
+
+    positions_ = positions;
+    max_px_shift_ = max_px_shift;
+    matched_.assign(positions_.size(), 0);
+    if(positions_.empty()){
+        cols_ = 0;
+        rows_ = 0;
+        return;
+    }
+
+    cv::Point2d min_pos = positions_[0];
+    cv::Point2d max_pos = positions_[0];
+    for(const auto & pos : positions_){
+        min_pos.x = std::min(min_pos.x, pos.x);
+        min_pos.y = std::min(min_pos.y, pos.y);
+        max_pos.x = std::max(max_pos.x, pos.x);
+        max_pos.y = std::max(max_pos.y, pos.y);
+    }
+
+    // the cells can not be smaller than the shift, but they are made larger if there would be many more cells than sequences
+    double max_cells_per_axis = std::ceil(2.0*std::sqrt((double)positions_.size()));
+    origin_ = min_pos;
+    cell_size_.x = std::max({max_px_shift_.x, 1.0, (max_pos.x - min_pos.x)/max_cells_per_axis});
+    cell_size_.y = std::max({max_px_shift_.y, 1.0, (max_pos.y - min_pos.y)/max_cells_per_axis});
+    cols_ = (int)((max_pos.x - min_pos.x)/cell_size_.x) + 1;
+    rows_ = (int)((max_pos.y - min_pos.y)/cell_size_.y) + 1;
+
+    // counting sort of the sequences by their cells - the sequences keep their order within each cell
+    cell_start_.assign(cols_*rows_ + 1, 0);
+    entry_cells_.resize(positions_.size());
+    for(int i = 0; i < (int)positions_.size(); ++i){
+        cv::Point cell = cellOf(positions_[i]);
+        entry_cells_[i] = cell.y*cols_ + cell.x;
+        cell_start_[entry_cells_[i] + 1]++;
+    }
+    for(int c = 0; c < cols_*rows_; ++c){
+        cell_start_[c + 1] += cell_start_[c];
+    }
+    entries_.resize(positions_.size());
+    for(int i = 0; i < (int)positions_.size(); ++i){
+        entries_[cell_start_[entry_cells_[i]]++] = i;
+    }
+    // the starts were shifted to the ends of the cells by the filling
+    for(int c = cols_*rows_; c > 0; --c){
+        cell_start_[c] = cell_start_[c - 1];
+    }
+    cell_start_[0] = 0;
+}
+
+cv::Point SequenceGrid::cellOf(const cv::Point2d & point) const {
+    double x = std::floor((point.x - origin_.x)/cell_size_.x);
+    double y = std::floor((point.y - origin_.y)/cell_size_.y);
+    return cv::Point((int)std::clamp(x, 0.0, (double)(cols_ - 1)), (int)std::clamp(y, 0.0, (double)(rows_ - 1)));
+}
+
+int SequenceGrid::matchPoint(const cv::Point2d & point){
+
+    if(positions_.empty()){
+        return -1;
+    }
+
+    cv::Point center = cellOf(point);
+    int best = -1;
+    for(int y = std::max(center.y - 1, 0); y <= std::min(center.y + 1, rows_ - 1); ++y){
+        for(int x = std::max(center.x - 1, 0); x <= std::min(center.x + 1, cols_ - 1); ++x){
+            int cell = y*cols_ + x;
+            for(int e = cell_start_[cell]; e < cell_start_[cell + 1]; ++e){
+                int index = entries_[e];
+                if(best >= 0 && index >= best){
+                    break;
+                }
+                if(matched_[index]){
+                    continue;
+                }
+                cv::Point2d bb_left_top = positions_[index] - max_px_shift_;
+                cv::Point2d bb_right_bottom = positions_[index] + max_px_shift_;
+                if(bb_left_top.x <= point.x && point.x <= bb_right_bottom.x && bb_left_top.y <= point.y && point.y <= bb_right_bottom.y){
+                    best = index;
+                    break;
+                }
+            }
+        }
+    }
+
+    if(best >= 0){
+        matched_[best] = 1;
+    }
+    return best;
+}
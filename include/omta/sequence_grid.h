@@ -0,0 +1,60 @@
+#pragma once
+
+#include <opencv2/core/core.hpp>
+#include <vector>
+
+namespace uvdar
+{
+
+    /**
+     * @brief Uniform grid over the last points of the sequences, for finding the sequence a new point belongs to without comparing it with every sequence.
+     * The cells are at least as large as the maximal pixel shift, so all sequences within the shift of a point lie in the 3x3 cells around it
+     */
+    class SequenceGrid {
+
+    private:
+        cv::Point2d max_px_shift_;
+        cv::Point2d origin_;
+        cv::Point2d cell_size_;
+        int cols_ = 0;
+        int rows_ = 0;
+
+        std::vector<cv::Point2d> positions_;
+        std::vector<int> cell_start_;   // the first entry of each cell in entries_, with one extra element at the end
+        std::vector<int> entries_;      // the indices of the sequences, ordered by the cells and by the indices within each cell
+        std::vector<int> entry_cells_;
+        std::vector<char> matched_;
+
+        /**
+         * @brief retrieves the cell containing the point, or the nearest cell if the point lies outside of the grid
+         */
+        cv::Point cellOf(const cv::Point2d &) const;
+
+    public:
+
+        /**
+         * @brief indexes the sequences by their positions, all of them are unmatched afterwards
+         * @param positions the last points of the sequences
+         * @param max_px_shift the largest allowed distance of a new point from the last point of its sequence, in each axis
+         */
+        void build(const std::vector<cv::Point2d> &, const cv::Point2d &);
+
+        /**
+         * @brief finds the unmatched sequence with the lowest index whose position is within max_px_shift of the point, and marks it as matched
+         * @param point the new point
+         * @return index of the matched sequence, -1 if there is none
+         */
+        int matchPoint(const cv::Point2d &);
+
+        /**
+         * @brief checks whether a sequence was matched since the last build()
+         */
+        bool isMatched(int index) const {
+            return matched_[index];
+        }
+
+        int size() const {
+            return (int)positions_.size();
+        }
+    };
+} // namespace uvdar
@@ -53,7 +53,7 @@ namespace uvdar {
 
       }
 
-      int matchSignalWithCrossCorr(std::vector<bool> i_signal){
+      int matchSignalWithCrossCorr(const std::vector<bool> &i_signal){
 
         if (i_signal.size() == 0){
           return -1;
@@ -16,8 +16,11 @@
 #include <uvdar_core/omtaSeqVariables.h>
 #include <uvdar_core/omtaAllSequences.h>
 #include <uvdar_core/omtaSeqPoint.h>
+#include <uvdar_core/omtaWorkerMetrics.h>
 #include <mutex>
 #include <thread>
+#include <condition_variable>
+#include <deque>
 #include <atomic>
 #include <fstream>
 
@@ -31,7 +34,18 @@ namespace uvdar{
 
       UVDARBlinkProcessor(){};
 
-      ~UVDARBlinkProcessor(){};
+      ~UVDARBlinkProcessor(){
+        for (auto& worker : omta_workers_){
+          {
+            std::scoped_lock lock(worker->mutex);
+            worker->stop = true;
+          }
+          worker->condition.notify_all();
+          if (worker->thread.joinable()){
+            worker->thread.join();
+          }
+        }
+      };
   
 
     private:
@@ -75,14 +89,39 @@ namespace uvdar{
       void setupCallbackAndPublisher();
 
       /**
-      * @brief Callback to insert new image points to:
+      * @brief Callback receiving new image points:
+      * - OMTA: queues them for the worker thread of the camera, dropping the oldest queued message if the queue is full
+      * - if 4DHT activated: inserts them directly
+      *
+      * @param msg The input message with image points
+      * @param Image_index index of the camera image producing this message
+      */
+      void insertPoints(const mrs_msgs::ImagePointsWithFloatStampedConstPtr &, const size_t &);
+
+      /**
+      * @brief Inserts new image points to:
       * - the OMTA and processes+publishes receiving points
       * - if 4DHT activated: the accumulator of the HT4D process
       *
       * @param msg The input message with image points
       * @param Image_index index of the camera image producing this message
       */
-      void insertPoints(const mrs_msgs::ImagePointsWithFloatStampedConstPtr &, const size_t &);
+      void processPoints(const mrs_msgs::ImagePointsWithFloatStampedConstPtr &, const size_t &);
+
+      /**
+      * @brief Thread function of the OMTA worker of a camera - processes the queued messages of image points one by one and periodically reports the metrics of the queue
+      *
+      * @param image_index Index of the camera producing the image
+      */
+      void OMTAWorkerThread(const size_t);
+
+      /**
+      * @brief Publishes the metrics of the OMTA worker of a camera collected since the last report on <blinkers_seen_topic>/omta_metrics, and resets them. Expects the mutex of the worker to be locked
+      *
+      * @param image_index Index of the camera producing the image
+      * @param now The current time
+      */
+      void reportWorkerMetrics(const size_t, const ros::WallTime&);
 
       /**
       * @brief Callback to insert points corresponding to pixels with sun to local variable for visualization
@@ -108,6 +147,20 @@ namespace uvdar{
       */
       void ProcessThread(const int&);
 
+      /**
+      * @brief Timer function requesting the whole sequences tracked by the OMTA from the OMTA worker, and publishing the OMTA parameters for logging. The sequences are only requested if they have subscribers
+      *
+      * @param image_index Index of the camera producing the image
+      */
+      void publishOMTAInfo(const int&);
+
+      /**
+      * @brief Publishes the whole sequences tracked by the OMTA. Must be called by the OMTA worker of the camera - the sequences are only changed by that thread, so they are read without locking them, and the OMTA is never blocked by copying them
+      *
+      * @param image_index Index of the camera producing the image
+      */
+      void publishOMTASequences(const size_t);
+
       /**
       * @brief Thread function for optional visualization of the detected blinking markers
       *
@@ -143,6 +196,7 @@ namespace uvdar{
       std::vector<ros::Publisher> pub_blinkers_seen_;
       std::vector<ros::Publisher> pub_OMTA_logging_;
       std::vector<ros::Publisher> pub_OMTA_all_seq_info;
+      std::vector<ros::Publisher> pub_OMTA_worker_metrics_;
       std::vector<ros::Publisher> pub_estimated_framerate_;
 
       using points_seen_callback_t = boost::function<void (const mrs_msgs::ImagePointsWithFloatStampedConstPtr&)>;
@@ -154,6 +208,7 @@ namespace uvdar{
 
       // visualization variables
       std::vector<ros::Timer> timer_process_;
+      std::vector<ros::Timer> timer_omta_info_;
       ros::Timer timer_visualization_;
       using image_callback_t = boost::function<void (const sensor_msgs::ImageConstPtr&)>;
       std::vector<image_callback_t> cals_image_;
@@ -169,8 +224,6 @@ namespace uvdar{
 
       std::vector<std::vector<cv::Point>> sun_points_;
       std::mutex mutex_sun;
-      
-      ros::Time last_publish_omta_logging_;
 
       // dynamic loaded params
       std::string _uav_name_;   
@@ -201,6 +254,8 @@ namespace uvdar{
       int _allowed_BER_per_seq_;
       double _std_threshold_poly_reg_;
       int _loaded_var_pub_rate_; 
+      int _omta_queue_length_;
+      float _omta_all_seq_info_rate_;
       double _draw_predict_window_sec_;
 
       // params for 4DHT
@@ -217,9 +272,11 @@ namespace uvdar{
       struct BlinkData{
         ros::Time                     last_sample_time;
         ros::Time                     last_sample_time_diagnostic;
+        ros::Time                     last_omta_logging_publish;
         unsigned int                  sample_count = -1;
         double                        framerate_estimate = 72;
         std::vector<std::pair<seqPointer,int>> retrieved_blinkers;
+        mrs_msgs::ImagePointsWithFloatStamped blinkers_seen_msg; // reused for publishing the retrieved blinkers, so that the points are not allocated again in every frame
         std::vector<std::pair<cv::Point2d,int>>      retrieved_blinkers_4DHT;
         std::vector<double>           pitch_4DHT;
         std::vector<double>           yaw_4DHT;
@@ -230,6 +287,31 @@ namespace uvdar{
       };
 
       std::vector<BlinkData> blink_data_;
+
+      /**
+       * @brief The thread processing the image points of one camera by the OMTA, so that a slow frame does not block the subscriber callbacks
+       */
+      struct OMTAWorker{
+        std::thread                   thread;
+        std::mutex                    mutex;
+        std::condition_variable       condition;
+        std::deque<std::pair<mrs_msgs::ImagePointsWithFloatStampedConstPtr, ros::WallTime>> queue; // the messages with the times they were received
+        bool                          stop = false;
+        bool                          sequences_requested = false; // set by publishOMTAInfo, the sequences are published after the next processed message
+
+        // metrics since the last report
+        ros::WallTime                 last_report;
+        unsigned long                 received = 0;
+        unsigned long                 dropped = 0;
+        unsigned long                 processed = 0;
+        size_t                        queue_depth_sum = 0; // the depth of the queue after each reception
+        size_t                        queue_depth_max = 0;
+        double                        latency_sum = 0.0;   // from the reception to the publishing of the results [ms]
+        double                        latency_max = 0.0;
+        double                        processing_sum = 0.0; // the processing alone [ms]
+      };
+      std::vector<std::unique_ptr<OMTAWorker>> omta_workers_;
+      static constexpr double worker_metrics_period = 1.0; // [s]
       std::vector<std::shared_ptr<OMTA>> omta_trackers_;
       std::vector<std::shared_ptr<HT4DBlinkerTrackerCPU>> ht4dbt_trackers_;
   };
@@ -239,8 +321,6 @@ namespace uvdar{
 
     nh_ = nodelet::Nodelet::getMTPrivateNodeHandle();
 
-    last_publish_omta_logging_ = ros::Time::now();
-
     const bool print_params_console = false;
     loadParams(print_params_console);
 
@@ -271,6 +351,16 @@ namespace uvdar{
       camera_image_sizes_.push_back(cv::Size(-1,-1));
     }
 
+    if(!_use_4DHT_){
+      for (size_t i = 0; i < _points_seen_topics_.size(); ++i) {
+        omta_workers_.push_back(std::make_unique<OMTAWorker>());
+        omta_workers_.back()->last_report = ros::WallTime::now();
+      }
+      for (size_t i = 0; i < omta_workers_.size(); ++i) {
+        omta_workers_[i]->thread = std::thread(&UVDARBlinkProcessor::OMTAWorkerThread, this, i);
+      }
+    }
+
     
     setupVisualization();  
 
@@ -318,6 +408,8 @@ namespace uvdar{
     param_loader.loadParam("allowed_BER_per_seq", _allowed_BER_per_seq_, int(0));
     param_loader.loadParam("std_threshold_poly_reg", _std_threshold_poly_reg_, double(0.5));
     param_loader.loadParam("loaded_var_pub_rate", _loaded_var_pub_rate_, int(20));
+    param_loader.loadParam("omta_queue_length", _omta_queue_length_, int(5));
+    param_loader.loadParam("omta_all_seq_info_rate", _omta_all_seq_info_rate_, float(5.0));
     param_loader.loadParam("draw_predict_window_sec", _draw_predict_window_sec_, double(0.3));
       
     /***** 4DHT params *****/
@@ -363,6 +455,18 @@ namespace uvdar{
       ROS_ERROR_STREAM("[UVDARBlinkProcessor]: Wanted confidence interval size equal or bigger than 100\% is set. A Confidence interval of 100\% is not settable! Returning."); 
       return false;
     } 
+    if(_poly_order_ < 0 || _poly_order_ > SlidingPolyFit::max_poly_order){
+      ROS_ERROR_STREAM("[UVDARBlinkProcessor]: The order of the polynomial regression has to be between 0 and " << SlidingPolyFit::max_poly_order << "! Returning.");
+      return false;
+    }
+    if(_omta_queue_length_ < 1){
+      ROS_ERROR_STREAM("[UVDARBlinkProcessor]: The length of the OMTA frame queue has to be at least 1! Returning.");
+      return false;
+    }
+    if(_omta_all_seq_info_rate_ <= 0.0){
+      ROS_ERROR_STREAM("[UVDARBlinkProcessor]: The rate of publishing the OMTA sequences has to be positive! Returning.");
+      return false;
+    }
     if(_draw_predict_window_sec_ != 0.0){
       ROS_WARN("[UVDARBlinkProcessor]: ''_draw_predict_window_sec_'' value is primary for debug use. Please don't set it too high - Otherwise it might cause unecessary load to the system.");
     }
@@ -490,6 +594,8 @@ namespace uvdar{
       if(!_use_4DHT_){
         pub_OMTA_logging_.push_back(nh_.advertise<uvdar_core::omtaDataForLogging>(_omta_logging_topics_[i], 1));
         pub_OMTA_all_seq_info.push_back(nh_.advertise<uvdar_core::omtaAllSequences>(_omta_all_seq_info_topics[i], 1));
+        pub_OMTA_worker_metrics_.push_back(nh_.advertise<uvdar_core::omtaWorkerMetrics>(_blinkers_seen_topics_[i]+"/omta_metrics", 1));
+        timer_omta_info_.push_back(nh_.createTimer(ros::Duration(1.0/(double)(_omta_all_seq_info_rate_)), boost::bind(&UVDARBlinkProcessor::publishOMTAInfo, this, i), false, true));
       }
     }
   }
@@ -531,6 +637,103 @@ namespace uvdar{
   void UVDARBlinkProcessor::insertPoints(const mrs_msgs::ImagePointsWithFloatStampedConstPtr &pts_msg, const size_t & img_index) {
     if (!initialized_) return;
 
+    if(_use_4DHT_){
+      processPoints(pts_msg, img_index);
+      return;
+    }
+
+    OMTAWorker& worker = *omta_workers_[img_index];
+    {
+      std::scoped_lock lock(worker.mutex);
+      worker.received++;
+      if ((int)(worker.queue.size()) >= _omta_queue_length_){
+        worker.queue.pop_front();
+        worker.dropped++;
+      }
+      worker.queue.emplace_back(pts_msg, ros::WallTime::now());
+      worker.queue_depth_sum += worker.queue.size();
+      worker.queue_depth_max = std::max(worker.queue_depth_max, worker.queue.size());
+    }
+    worker.condition.notify_one();
+  }
+
+  void UVDARBlinkProcessor::OMTAWorkerThread(const size_t image_index) {
+    OMTAWorker& worker = *omta_workers_[image_index];
+    while (true){
+      mrs_msgs::ImagePointsWithFloatStampedConstPtr pts_msg;
+      ros::WallTime received_time;
+      {
+        std::unique_lock lock(worker.mutex);
+        worker.condition.wait(lock, [&worker]{return worker.stop || !worker.queue.empty();});
+        if (worker.stop){
+          return;
+        }
+        pts_msg = worker.queue.front().first;
+        received_time = worker.queue.front().second;
+        worker.queue.pop_front();
+      }
+
+      ros::WallTime start_time = ros::WallTime::now();
+      processPoints(pts_msg, image_index);
+      ros::WallTime end_time = ros::WallTime::now();
+
+      bool sequences_requested;
+      {
+        std::scoped_lock lock(worker.mutex);
+        sequences_requested = worker.sequences_requested;
+        worker.sequences_requested = false;
+        double latency = (end_time - received_time).toSec()*1000.0;
+        worker.processed++;
+        worker.latency_sum += latency;
+        worker.latency_max = std::max(worker.latency_max, latency);
+        worker.processing_sum += (end_time - start_time).toSec()*1000.0;
+        if ((end_time - worker.last_report).toSec() >= worker_metrics_period){
+          reportWorkerMetrics(image_index, end_time);
+        }
+      }
+
+      if (sequences_requested){
+        publishOMTASequences(image_index);
+      }
+    }
+  }
+
+  void UVDARBlinkProcessor::reportWorkerMetrics(const size_t image_index, const ros::WallTime& now) {
+    OMTAWorker& worker = *omta_workers_[image_index];
+
+    auto msg = boost::make_shared<uvdar_core::omtaWorkerMetrics>();
+    msg->stamp = ros::Time::now();
+    msg->period = (now - worker.last_report).toSec();
+    msg->received = worker.received;
+    msg->dropped = worker.dropped;
+    msg->processed = worker.processed;
+    msg->queue_depth_mean = (worker.received > 0) ? (double)(worker.queue_depth_sum)/(double)(worker.received) : 0.0;
+    msg->queue_depth_max = worker.queue_depth_max;
+    msg->latency_mean = (worker.processed > 0) ? worker.latency_sum/(double)(worker.processed) : 0.0;
+    msg->latency_max = worker.latency_max;
+    msg->processing_mean = (worker.processed > 0) ? worker.processing_sum/(double)(worker.processed) : 0.0;
+    pub_OMTA_worker_metrics_[image_index].publish(msg);
+
+    if (worker.dropped > 0){
+      ROS_WARN_STREAM_THROTTLE(10.0, "[UVDARBlinkProcessor]: Camera " << image_index << ": Dropped " << worker.dropped << " of " << worker.received << " received frames in the last " << msg->period << " s, the OMTA can not keep up! Increase omta_queue_length if this is a burst.");
+    }
+    if (_debug_ && (worker.received > 0) && (worker.processed > 0)){
+      ROS_INFO_STREAM("[UVDARBlinkProcessor]: Camera " << image_index << ": OMTA queue depth: mean " << msg->queue_depth_mean << ", max " << worker.queue_depth_max
+          << "; latency: mean " << msg->latency_mean << " ms, max " << worker.latency_max << " ms"
+          << "; processing: mean " << msg->processing_mean << " ms");
+    }
+    worker.last_report = now;
+    worker.received = 0;
+    worker.dropped = 0;
+    worker.processed = 0;
+    worker.queue_depth_sum = 0;
+    worker.queue_depth_max = 0;
+    worker.latency_sum = 0.0;
+    worker.latency_max = 0.0;
+    worker.processing_sum = 0.0;
+  }
+
+  void UVDARBlinkProcessor::processPoints(const mrs_msgs::ImagePointsWithFloatStampedConstPtr &pts_msg, const size_t & img_index) {
     blink_data_[img_index].sample_count++;
     
     if ((blink_data_[img_index].sample_count % 10) == 0) { //update the estimate of frequency every 10 samples
@@ -576,7 +779,11 @@ namespace uvdar{
     }
 
     if(!_use_4DHT_){
+      // the retrieved sequences are shared with the OMTA, so they must not be read while they are being updated. The results of the previous frame are released first, so that the OMTA can reuse the sequences deleted in this frame instead of allocating new ones
+      std::scoped_lock lock(*(blink_data_[img_index].mutex_retrieved_blinkers));
+      blink_data_[img_index].retrieved_blinkers.clear();
       omta_[img_index]->processBuffer(pts_msg);
+      omta_[img_index]->getResults(blink_data_[img_index].retrieved_blinkers);
     }else{
       std::vector<cv::Point2i> points;
       for (auto& point : pts_msg->points) {
@@ -601,21 +808,19 @@ namespace uvdar{
 
     if(_use_4DHT_) return;
     
-    mrs_msgs::ImagePointsWithFloatStamped msg;
-    uvdar_core::omtaDataForLogging omta_logging_msg;
-    uvdar_core::omtaAllSequences omta_all_seq_msg;
+    mrs_msgs::ImagePointsWithFloatStamped& msg = blink_data_[img_index].blinkers_seen_msg;
     ros::Time local_last_sample_time = blink_data_[img_index].last_sample_time;
     {
       std::scoped_lock lock(*(blink_data_[img_index].mutex_retrieved_blinkers));
-      blink_data_[img_index].retrieved_blinkers = omta_[img_index]->getResults();
 
       int valid_signal_cnt = 0 , invalid_signal_cnt = 0;
+      msg.points.clear();
       for (auto& signal : blink_data_[img_index].retrieved_blinkers) {
         mrs_msgs::Point2DWithFloat point;
         // take the last/most up-to-date point and publish to pose calculator
-        auto last_point = signal.first->end()[-1];
-        point.x = last_point.point.x;
-        point.y = last_point.point.y;
+        cv::Point2d last_point = signal.first->lastPoint();
+        point.x = last_point.x;
+        point.y = last_point.y;
         if ( 0 <= signal.second && signal.second <= (int)sequences_.size()){
           point.value = signal.second;
           valid_signal_cnt++;
@@ -624,44 +829,6 @@ namespace uvdar{
           point.value = -2;
           invalid_signal_cnt++;
         }
-                  
-        // publish values from omta if the sequence is valid
-        uvdar_core::omtaSeqVariables omta_seq_msg;
-        omta_seq_msg.inserted_time = last_point.insert_time;
-        omta_seq_msg.signal_id = signal.second;
-
-        omta_seq_msg.confidence_interval.x = last_point.x_statistics.confidence_interval;
-        omta_seq_msg.confidence_interval.y = last_point.y_statistics.confidence_interval;
-        omta_seq_msg.predicted_point.x = last_point.x_statistics.predicted_coordinate;
-        omta_seq_msg.predicted_point.y = last_point.y_statistics.predicted_coordinate;
-        
-
-        for(auto coeff : last_point.x_statistics.coeff){
-          omta_seq_msg.x_coeff_reg.push_back(static_cast<float>(coeff));
-        }
-
-        for(auto coeff : last_point.y_statistics.coeff){
-          omta_seq_msg.y_coeff_reg.push_back(static_cast<float>(coeff));
-        }
-
-        for(auto point_state : *signal.first){
-          uvdar_core::omtaSeqPoint ps_msg;
-          mrs_msgs::Point2DWithFloat p;
-          p.x = point_state.point.x;
-          p.y = point_state.point.y;
-          p.value = point_state.led_state;
-          ps_msg.point = p;
-          ps_msg.insert_time = point_state.insert_time;
-          omta_seq_msg.sequence.push_back(ps_msg);
-        }
-
-        omta_seq_msg.poly_reg_computed.push_back(last_point.x_statistics.poly_reg_computed);
-        omta_seq_msg.poly_reg_computed.push_back(last_point.y_statistics.poly_reg_computed);
-
-        omta_seq_msg.extended_search.push_back(last_point.x_statistics.extended_search);
-        omta_seq_msg.extended_search.push_back(last_point.y_statistics.extended_search);
-
-        omta_all_seq_msg.sequences.push_back(omta_seq_msg);
         msg.points.push_back(point);
       }
       msg.stamp         = local_last_sample_time;
@@ -674,38 +841,82 @@ namespace uvdar{
 
       // publish the last point for the pose calculate
       pub_blinkers_seen_[img_index].publish(msg);
-      // publish whole sequence with infos from omta
-      pub_OMTA_all_seq_info[img_index].publish(omta_all_seq_msg);
 
       std_msgs::Float32 msg_framerate;
       msg_framerate.data = blink_data_[img_index].framerate_estimate;
       pub_estimated_framerate_[img_index].publish(msg_framerate);
+    }
+    
+  } 
+
+  void UVDARBlinkProcessor::publishOMTAInfo(const int& image_index) {
+    if (!initialized_){
+      return;
+    }
 
+    if (pub_OMTA_all_seq_info[image_index].getNumSubscribers() > 0){
+      // the sequences are built and published by the OMTA worker after its next message - building them here would hold mutex_retrieved_blinkers while copying every point of every sequence, blocking the OMTA for that time
+      OMTAWorker& worker = *omta_workers_[image_index];
+      std::scoped_lock lock(worker.mutex);
+      worker.sequences_requested = true;
+    }
 
+    // publish loaded variables every _loaded_var_pub_rate_ seconds
+    ros::Time now = ros::Time::now();
+    if ((pub_OMTA_logging_[image_index].getNumSubscribers() > 0) && (_loaded_var_pub_rate_ < (now - blink_data_[image_index].last_omta_logging_publish).toSec())){
+      blink_data_[image_index].last_omta_logging_publish = now;
+
+      auto omta_logging_msg = boost::make_shared<uvdar_core::omtaDataForLogging>();
+      omta_logging_msg->stamp = now;
+      omta_logging_msg->pub_rate = _loaded_var_pub_rate_; 
+      omta_logging_msg->stored_seq_len_factor = _stored_seq_len_factor_;
+      omta_logging_msg->max_buffer_length = _max_buffer_length_;
+      omta_logging_msg->default_poly_order = _poly_order_;
+      omta_logging_msg->max_zeros_consecutive = _max_zeros_consecutive_;
+      omta_logging_msg->max_ones_consecutive = _max_ones_consecutive_;
+      omta_logging_msg->max_px_shift.x = _max_px_shift_.x;
+      omta_logging_msg->max_px_shift.y = _max_px_shift_.y;
+      omta_logging_msg->confidence_probab_t_dist = _conf_probab_percent_;
+      omta_logging_msg->decay_factor_weight_func = _decay_factor_;
+      pub_OMTA_logging_[image_index].publish(omta_logging_msg);
+    }
+  }
 
-      // publish loaded variables every _loaded_var_pub_rate_ seconds
-      double diff = ros::Time::now().toSec() - last_publish_omta_logging_.toSec();
-      if( _loaded_var_pub_rate_ < diff){
-        last_publish_omta_logging_ = ros::Time::now();
-
-        omta_logging_msg.stamp = last_publish_omta_logging_;
-        omta_logging_msg.pub_rate = _loaded_var_pub_rate_; 
-        mrs_msgs::Point2DWithFloat max_px_shift;
-        omta_logging_msg.stored_seq_len_factor = _stored_seq_len_factor_;
-        omta_logging_msg.max_buffer_length = _max_buffer_length_;
-        omta_logging_msg.default_poly_order = _poly_order_;
-        omta_logging_msg.max_zeros_consecutive = _max_zeros_consecutive_;
-        omta_logging_msg.max_ones_consecutive = _max_ones_consecutive_;
-        max_px_shift.x = _max_px_shift_.x;
-        max_px_shift.y = _max_px_shift_.y;
-        omta_logging_msg.confidence_probab_t_dist = _conf_probab_percent_;
-        omta_logging_msg.decay_factor_weight_func = _decay_factor_;
-        omta_logging_msg.max_px_shift = max_px_shift;
-        pub_OMTA_logging_[img_index].publish(omta_logging_msg);
+  void UVDARBlinkProcessor::publishOMTASequences(const size_t image_index) {
+    // retrieved_blinkers and the sequences are only changed by the OMTA worker calling this, so no lock is needed for reading them here
+    auto omta_all_seq_msg = boost::make_shared<uvdar_core::omtaAllSequences>();
+    omta_all_seq_msg->sequences.reserve(blink_data_[image_index].retrieved_blinkers.size());
+    for (auto& signal : blink_data_[image_index].retrieved_blinkers) {
+      const Sequence& sequence = *signal.first;
+
+      omta_all_seq_msg->sequences.emplace_back();
+      uvdar_core::omtaSeqVariables& omta_seq_msg = omta_all_seq_msg->sequences.back();
+      omta_seq_msg.inserted_time = sequence.lastInsertTime();
+      omta_seq_msg.signal_id = signal.second;
+
+      omta_seq_msg.confidence_interval.x = sequence.x_statistics.confidence_interval;
+      omta_seq_msg.confidence_interval.y = sequence.y_statistics.confidence_interval;
+      omta_seq_msg.predicted_point.x = sequence.x_statistics.predicted_coordinate;
+      omta_seq_msg.predicted_point.y = sequence.y_statistics.predicted_coordinate;
+
+      omta_seq_msg.x_coeff_reg.assign(sequence.x_statistics.coeff.begin(), sequence.x_statistics.coeff.end());
+      omta_seq_msg.y_coeff_reg.assign(sequence.y_statistics.coeff.begin(), sequence.y_statistics.coeff.end());
+
+      omta_seq_msg.sequence.reserve(sequence.size());
+      for(int i = 0; i < sequence.size(); ++i){
+        omta_seq_msg.sequence.emplace_back();
+        uvdar_core::omtaSeqPoint& ps_msg = omta_seq_msg.sequence.back();
+        ps_msg.point.x = sequence.x(i);
+        ps_msg.point.y = sequence.y(i);
+        ps_msg.point.value = sequence.ledState(i);
+        ps_msg.insert_time = sequence.insertTime(i);
       }
+
+      omta_seq_msg.poly_reg_computed = {sequence.x_statistics.poly_reg_computed, sequence.y_statistics.poly_reg_computed};
+      omta_seq_msg.extended_search = {sequence.x_statistics.extended_search, sequence.y_statistics.extended_search};
     }
-    
-  } 
+    pub_OMTA_all_seq_info[image_index].publish(omta_all_seq_msg);
+  }
 
   void UVDARBlinkProcessor::insertSunPoints(const mrs_msgs::ImagePointsWithFloatStampedConstPtr& msg, const size_t & image_index) {
     if (!initialized_) return;
@@ -853,22 +1064,24 @@ namespace uvdar{
         for(int j = 0; j < (int)(blink_data_[image_index].retrieved_blinkers.size()); j++){
           cv::Scalar predict_colour(255,153,255);
           cv::Scalar seq_colour(160,160,160);
+          const Sequence& sequence = *blink_data_[image_index].retrieved_blinkers[j].first;
           
           cv::Point2d confidence_interval = cv::Point2d(
-            blink_data_[image_index].retrieved_blinkers[j].first->end()[-1].x_statistics.confidence_interval,
-            blink_data_[image_index].retrieved_blinkers[j].first->end()[-1].y_statistics.confidence_interval
+            sequence.x_statistics.confidence_interval,
+            sequence.y_statistics.confidence_interval
           );
           cv::Point2d predicted = cv::Point2d(
-            blink_data_[image_index].retrieved_blinkers[j].first->end()[-1].x_statistics.predicted_coordinate,
-            blink_data_[image_index].retrieved_blinkers[j].first->end()[-1].y_statistics.predicted_coordinate
+            sequence.x_statistics.predicted_coordinate,
+            sequence.y_statistics.predicted_coordinate
           );
-          auto x_coeff = blink_data_[image_index].retrieved_blinkers[j].first->end()[-1].x_statistics.coeff;
-          auto y_coeff = blink_data_[image_index].retrieved_blinkers[j].first->end()[-1].y_statistics.coeff;
-          double curr_time = blink_data_[image_index].retrieved_blinkers[j].first->end()[-1].insert_time.toSec();
-          bool x_poly_reg_computed = blink_data_[image_index].retrieved_blinkers[j].first->end()[-1].x_statistics.poly_reg_computed;
-          bool y_poly_reg_computed = blink_data_[image_index].retrieved_blinkers[j].first->end()[-1].y_statistics.poly_reg_computed;
-          bool x_extended_search = blink_data_[image_index].retrieved_blinkers[j].first->end()[-1].x_statistics.extended_search;
-          bool y_extended_search = blink_data_[image_index].retrieved_blinkers[j].first->end()[-1].y_statistics.extended_search;
+          // the local coefficients are in powers of the time since the prediction, which stay precise with large time stamps
+          const std::vector<double>& x_coeff = sequence.x_statistics.coeff_local;
+          const std::vector<double>& y_coeff = sequence.y_statistics.coeff_local;
+          double curr_time = sequence.lastInsertTime().toSec();
+          bool x_poly_reg_computed = sequence.x_statistics.poly_reg_computed;
+          bool y_poly_reg_computed = sequence.y_statistics.poly_reg_computed;
+          bool x_extended_search = sequence.x_statistics.extended_search;
+          bool y_extended_search = sequence.y_statistics.extended_search;
 
           std::vector<cv::Point> interpolated_prediction;
           
@@ -885,7 +1098,7 @@ namespace uvdar{
               double x_calculated = 0.0; 
               if(x_poly_reg_computed){
                 for(int k = 0; k < (int)x_coeff.size(); ++k){
-                x_calculated += x_coeff[k]*pow(computed_time, k);
+                x_calculated += x_coeff[k]*pow(computed_time - sequence.x_statistics.time_pred, k);
                 }
                 interpolated_point.x = x_calculated;
               }else{
@@ -894,7 +1107,7 @@ namespace uvdar{
               if(y_poly_reg_computed){
                 double y_calculated = 0.0;
                 for(int k = 0; k < (int)y_coeff.size(); ++k){
-                  y_calculated += y_coeff[k]*pow(computed_time, k);
+                  y_calculated += y_coeff[k]*pow(computed_time - sequence.y_statistics.time_pred, k);
                 }
                 interpolated_point.y = y_calculated;
               }else{
@@ -912,7 +1125,7 @@ namespace uvdar{
             }
           }
   
-          cv::Point center = cv::Point(blink_data_[image_index].retrieved_blinkers[j].first->end()[-1].point.x, blink_data_[image_index].retrieved_blinkers[j].first->end()[-1].point.y) + start_point;
+          cv::Point center = cv::Point(sequence.lastPoint().x, sequence.lastPoint().y) + start_point;
           int signal_index = blink_data_[image_index].retrieved_blinkers[j].second;
           if(signal_index == -2 || signal_index == -3) {
             continue;
@@ -950,11 +1163,11 @@ namespace uvdar{
   
           // draw "past" stored sequence points 
           std::vector<cv::Point> draw_seq;  
-          for(auto p : *blink_data_[image_index].retrieved_blinkers[j].first){
-            if(p.led_state){
+          for(int i = 0; i < sequence.size(); ++i){
+            if(sequence.ledState(i)){
               cv::Point point;
-              point.x = p.point.x;
-              point.y = p.point.y;
+              point.x = sequence.x(i);
+              point.y = sequence.y(i);
               draw_seq.push_back(point+start_point);
             }
           }
@@ -0,0 +1,173 @@
+#include <opencv2/core/core.hpp>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "benchmark/command_line.h"
+#include "detect/detector_defaults.h"
+#include "detect/synthetic_frames.h"
+#include "detect/uv_led_detect_fast_cpu.h"
+
+/*
+ * Standalone (ROS-free) benchmark of the reset of the non-maxima suppression marks of the CPU FAST detector (clearMarks).
+ * Runs two CPU detectors on the same synthetic full resolution frames with the given numbers of markers - one resetting only the listed marked points, the other scanning the whole plane as before - and compares the mean time of processImage per frame. Checks that both retrieve the same points and reports the results as CSV.
+ *
+ * Example:
+ *   uvdar_clear_marks_benchmark --markers 0,50,200 --frames 1000
+ */
+
+namespace uvdar {
+
+  /**
+   * @brief The settings of the benchmark, as given on the command line
+   */
+  struct BenchmarkOptions {
+    std::vector<int> markers = {0, 50, 200}; ///< the numbers of markers per frame, each measured separately
+    int frames = 1000;
+    int width = 752;
+    int height = 480;
+    int threshold = 200;
+    int threshold_diff = 100;
+    unsigned int seed = 0;
+  };
+
+  /**
+   * @brief The measured performance for a single number of markers
+   */
+  struct BenchmarkResult {
+    int markers = 0;
+    int frames = 0;
+    double mean_points = 0.0;      ///< the mean number of retrieved points per frame
+    double full_scan_us = 0.0;     ///< the mean time of processImage per frame with the reset scanning the whole plane
+    double listed_us = 0.0;        ///< the mean time of processImage per frame with the reset of the listed points only
+    int mismatches = 0;            ///< the number of frames in which the two detectors retrieved different points
+  };
+
+  /* renderFrames //{ */
+  /**
+   * @brief Renders a set of frames with the given number of randomly placed markers, cycled through by the measurement
+   */
+  std::vector<cv::Mat> renderFrames(int marker_count, const BenchmarkOptions& options) {
+    std::mt19937 rng(options.seed + marker_count);
+    std::uniform_int_distribution<int> x_dist(0, options.width - 1);
+    std::uniform_int_distribution<int> y_dist(0, options.height - 1);
+    std::uniform_int_distribution<int> radius(1, 3);
+    std::uniform_int_distribution<int> peak(180, 255);
+
+    std::vector<cv::Mat> frames;
+    for (int f = 0; f < 16; f++) {
+      cv::Mat frame = synthetic::background(cv::Size(options.width, options.height), 12, 6, rng);
+      for (int i = 0; i < marker_count; i++) {
+        synthetic::drawMarker(frame, cv::Point(x_dist(rng), y_dist(rng)), peak(rng), radius(rng));
+      }
+      frames.push_back(frame);
+    }
+    return frames;
+  }
+  //}
+
+  /* runBenchmark //{ */
+  /**
+   * @brief Processes the frames with the given number of markers by both detectors, alternating between them in every frame so that both see the same state of the caches
+   */
+  BenchmarkResult runBenchmark(int marker_count, const BenchmarkOptions& options) {
+    std::vector<cv::Mat> frames = renderFrames(marker_count, options);
+
+    UVDARLedDetectFASTCPU full_scan(false, false, options.threshold, options.threshold_diff, THRESHOLD_SUN, {});
+    UVDARLedDetectFASTCPU listed(false, false, options.threshold, options.threshold_diff, THRESHOLD_SUN, {});
+    full_scan.setMarkReset(UVDARLedDetectFASTCPU::MarkReset::FULL_SCAN);
+    listed.setMarkReset(UVDARLedDetectFASTCPU::MarkReset::LISTED);
+
+    BenchmarkResult result;
+    result.markers = marker_count;
+    result.frames = options.frames;
+    std::vector<cv::Point2i> full_scan_points, listed_points, sun_points;
+    full_scan.processImage(frames.front(), full_scan_points, sun_points); //the first image also initializes the detectors
+    listed.processImage(frames.front(), listed_points, sun_points);
+
+    double full_scan_total = 0.0, listed_total = 0.0;
+    for (int f = 0; f < options.frames; f++) {
+      const cv::Mat& frame = frames[f % frames.size()];
+
+      auto full_scan_start = std::chrono::steady_clock::now();
+      full_scan.processImage(frame, full_scan_points, sun_points);
+      full_scan_total += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - full_scan_start).count();
+
+      auto listed_start = std::chrono::steady_clock::now();
+      listed.processImage(frame, listed_points, sun_points);
+      listed_total += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - listed_start).count();
+
+      result.mean_points += listed_points.size();
+      if (full_scan_points != listed_points) {
+        result.mismatches++;
+      }
+    }
+
+    result.mean_points /= options.frames;
+    result.full_scan_us = full_scan_total/options.frames;
+    result.listed_us = listed_total/options.frames;
+    return result;
+  }
+  //}
+
+  /* parseOptions //{ */
+  bool parseOptions(int argc, char** argv, BenchmarkOptions& o_options) {
+    benchmark::CommandLine command_line("UVDARClearMarksBenchmark",
+        "Usage: uvdar_clear_marks_benchmark [options]\n"
+        "  --markers LIST            comma separated numbers of markers per frame (0,50,200)\n"
+        "  --frames N                number of frames per measurement (1000)\n"
+        "  --width W, --height H     size of the image (752x480)\n"
+        "  --threshold T             detection threshold (200)\n"
+        "  --threshold_diff T        threshold difference (100)\n"
+        "  --seed N                  seed of the marker positions (0)\n");
+    if (!command_line.parse(argc, argv)) {
+      return false;
+    }
+
+    command_line.takeList("markers", o_options.markers);
+    command_line.take("frames", o_options.frames);
+    command_line.take("width", o_options.width);
+    command_line.take("height", o_options.height);
+    command_line.take("threshold", o_options.threshold);
+    command_line.take("threshold_diff", o_options.threshold_diff);
+    command_line.take("seed", o_options.seed);
+    if (!command_line.finish()) {
+      return false;
+    }
+
+    if ((o_options.width < 16) || (o_options.height < 16) || (o_options.frames < 1)) {
+      return command_line.fail("The image must be at least 16x16, and the number of frames at least 1!");
+    }
+    for (auto count : o_options.markers) {
+      if (count < 0) {
+        return command_line.fail("The numbers of markers can not be negative!");
+      }
+    }
+    return true;
+  }
+  //}
+
+}
+
+int main(int argc, char** argv) {
+  uvdar::BenchmarkOptions options;
+  if (!uvdar::parseOptions(argc, argv, options)) {
+    return 1;
+  }
+
+  bool identical = true;
+  uvdar::benchmark::CsvWriter csv(std::cout, {"markers", "frames", "mean_points", "full_scan_us", "listed_us", "speedup", "mismatches"});
+  for (auto count : options.markers) {
+    uvdar::BenchmarkResult result = uvdar::runBenchmark(count, options);
+    csv.row(result.markers, result.frames, result.mean_points, result.full_scan_us, result.listed_us, (result.listed_us > 0.0 ? result.full_scan_us/result.listed_us : 0.0), result.mismatches);
+    if (result.mismatches > 0) {
+      std::cerr << "[UVDARClearMarksBenchmark]: The two resets led to different points in " << result.mismatches << " frames with " << count << " markers!" << std::endl;
+      identical = false;
+    }
+  }
+
+  return identical ? 0 : 1;
+}
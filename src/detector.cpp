@@ -1,5 +1,6 @@
 #define camera_delay 0.50
-#define MAX_POINTS_PER_IMAGE 200
+#define SELF_BENCHMARK_FRAMES 20
+#define ROI_MAX_AGE 0.5
 
 #include <ros/ros.h>
 #include <ros/package.h>
@@ -11,14 +12,27 @@
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/imgcodecs/imgcodecs.hpp>
 #include <mrs_msgs/ImagePointsWithFloatStamped.h>
+#include <std_msgs/UInt32.h>
+#include <uvdar_core/DetectorOverload.h>
+#include <uvdar_core/DetectorThresholds.h>
+#include <uvdar_core/DetectorSunCache.h>
 #include <mrs_lib/image_publisher.h>
 #include <mrs_lib/param_loader.h>
 #include <boost/filesystem/operations.hpp>
 /* #include <experimental/filesystem> */
+#include <atomic>
+#include <chrono>
+#include <deque>
 #include <mutex>
+#include <sstream>
+#include <thread>
 
+#include "detect/detector_defaults.h"
 #include "detect/uv_led_detect_fast_cpu.h"
 #include "detect/uv_led_detect_fast_gpu.h"
+#include "detect/uv_led_detect_blob.h"
+#include "detect/frame_mailbox.h"
+#include "detect/threshold_controller.h"
 
 namespace enc = sensor_msgs::image_encodings;
 
@@ -46,6 +60,84 @@ public:
     param_loader.loadParam("threshold", _threshold_, 200);
     param_loader.loadParam("threshold_differential", _threshold_differential_, _threshold_/2);
 
+    /* adaptive thresholds //{ */
+    param_loader.loadParam("adaptive_threshold", _adaptive_threshold_, bool(false));
+    ThresholdController::Params threshold_params;
+    threshold_params.threshold = _threshold_;
+    threshold_params.threshold_diff = _threshold_differential_;
+    param_loader.loadParam("adaptive_threshold_max", threshold_params.threshold_max, 250);
+    param_loader.loadParam("adaptive_threshold_differential_max", threshold_params.threshold_diff_max, std::min(2*_threshold_differential_, 250));
+    param_loader.loadParam("adaptive_threshold_step", threshold_params.step, 5);
+    param_loader.loadParam("adaptive_threshold_max_points", threshold_params.max_points, MAX_POINTS_PER_IMAGE/2);
+    param_loader.loadParam("adaptive_threshold_max_time", threshold_params.max_time, 10.0);
+    param_loader.loadParam("adaptive_threshold_hysteresis", threshold_params.hysteresis_images, 10);
+    //}
+
+    /* select the detector backend //{ */
+    param_loader.loadParam("detector_backend", _detector_backend_, std::string("auto"));
+    param_loader.loadParam("detector_self_benchmark", _detector_self_benchmark_, bool(true));
+    param_loader.loadParam("cpu_threads", _cpu_threads_, 1);
+    param_loader.loadParam("prescan_kernel", _prescan_kernel_name_, std::string("auto"));
+    param_loader.loadParam("prescan_prescreen", _prescan_prescreen_, bool(true));
+    param_loader.loadParam("overload_tile_budget", _overload_tile_budget_, bool(false));
+    param_loader.loadParam("blob_max_marker_area", _blob_max_marker_area_, 400);
+    param_loader.loadParam("blob_min_sun_area", _blob_min_sun_area_, 100);
+    param_loader.loadParam("gpu_platform", _gpu_platform_name_, std::string("gbm"));
+    param_loader.loadParam("gpu_device_path", _gpu_device_path_, std::string(""));
+    param_loader.loadParam("gpu_pipeline_depth", _gpu_pipeline_depth_, 1);
+    if ((_detector_backend_ != "cpu") && (_detector_backend_ != "gpu") && (_detector_backend_ != "auto") && (_detector_backend_ != "blob")){
+      ROS_ERROR_STREAM("[UVDARDetector]: Unknown detector backend \"" << _detector_backend_ << "\"! Use one of \"cpu\", \"gpu\", \"blob\" or \"auto\".");
+      return;
+    }
+
+    if (_prescan_kernel_name_ == "auto"){
+      _prescan_kernel_ = UVDARLedDetectFASTCPU::PrescanKernel::AUTO;
+    }
+    else if (_prescan_kernel_name_ == "scalar"){
+      _prescan_kernel_ = UVDARLedDetectFASTCPU::PrescanKernel::SCALAR;
+    }
+    else if (_prescan_kernel_name_ == "sse2"){
+      _prescan_kernel_ = UVDARLedDetectFASTCPU::PrescanKernel::SSE2;
+    }
+    else if (_prescan_kernel_name_ == "avx2"){
+      _prescan_kernel_ = UVDARLedDetectFASTCPU::PrescanKernel::AVX2;
+    }
+    else {
+      ROS_ERROR_STREAM("[UVDARDetector]: Unknown pre-scan kernel \"" << _prescan_kernel_name_ << "\"! Use one of \"auto\", \"scalar\", \"sse2\" or \"avx2\".");
+      return;
+    }
+
+    if (_gpu_platform_name_ == "gbm"){
+      _gpu_platform_ = COMPUTE_LIB_PLATFORM_GBM;
+    }
+    else if (_gpu_platform_name_ == "device"){
+      _gpu_platform_ = COMPUTE_LIB_PLATFORM_DEVICE;
+    }
+    else if (_gpu_platform_name_ == "surfaceless"){
+      _gpu_platform_ = COMPUTE_LIB_PLATFORM_SURFACELESS;
+    }
+    else if (_gpu_platform_name_ == "auto"){
+      _gpu_platform_ = COMPUTE_LIB_PLATFORM_AUTO;
+    }
+    else {
+      ROS_ERROR_STREAM("[UVDARDetector]: Unknown GPU platform \"" << _gpu_platform_name_ << "\"! Use one of \"gbm\", \"device\", \"surfaceless\" or \"auto\".");
+      return;
+    }
+
+    if ((_detector_backend_ != "cpu") && (_detector_backend_ != "blob")){
+      std::string probe_error;
+      gpu_available_ = UVDARLedDetectFASTGPU::probe(probe_error, _gpu_platform_, _gpu_device_path_);
+      if (!gpu_available_){
+        if (_detector_backend_ == "gpu"){
+          ROS_ERROR_STREAM("[UVDARDetector]: The GPU backend was requested, but the GPU is not usable (" << probe_error << "). Falling back to the CPU backend!");
+        }
+        else {
+          ROS_WARN_STREAM("[UVDARDetector]: The GPU is not usable (" << probe_error << "), the CPU backend will be used.");
+        }
+      }
+    }
+    //}
+
     /* subscribe to cameras //{ */
     std::vector<std::string> _camera_topics;
     param_loader.loadParam("camera_topics", _camera_topics, _camera_topics);
@@ -71,6 +163,24 @@ public:
       }
     }
     //}
+
+    /* temporal detection //{ */
+    param_loader.loadParam("temporal_detection", _temporal_detection_, _temporal_detection_);
+    if (_temporal_detection_.empty()){
+      _temporal_detection_.resize(_camera_count_, false);
+    }
+    else if (_temporal_detection_.size() != _camera_count_){
+      ROS_ERROR_STREAM("[UVDARDetector]: The number of temporal detection flags (" << _temporal_detection_.size() << ") does not match the number of cameras (" << _camera_count_ << ")!");
+      return;
+    }
+    param_loader.loadParam("temporal_decay", _temporal_decay_, 8);
+    param_loader.loadParam("temporal_min_change", _temporal_min_change_, _threshold_differential_);
+    //}
+
+    /* sun caching //{ */
+    param_loader.loadParam("sun_cache_period", _sun_cache_period_, 0);
+    param_loader.loadParam("sun_cache_max_change", _sun_cache_max_change_, 0.2);
+    //}
     
     // Create callbacks, timers and process objects for each camera
     for (unsigned int i = 0; i < _camera_count_; ++i) {
@@ -79,7 +189,11 @@ public:
       };
       cals_image_.push_back(callback);
 
-      timer_process_.push_back(ros::Timer());
+      camera_workers_.push_back(std::make_unique<CameraWorker>());
+
+      if (_adaptive_threshold_){
+        threshold_controllers_.push_back(std::make_unique<ThresholdController>(threshold_params));
+      }
 
       camera_image_sizes_.push_back(cv::Size(0,0));
 
@@ -90,19 +204,9 @@ public:
 
       mutex_camera_image_.push_back(std::make_unique<std::mutex>());
 
-      ROS_INFO("[UVDARDetector]: Initializing FAST-based marker detection...");
-      uvdf_.push_back(std::make_unique<UVDARLedDetectFASTGPU>(
-            _gui_,
-            _debug_,
-            _threshold_,
-            _threshold_differential_,
-            150,
-            _masks_
-            ));
-      if (!uvdf_.back()){
-        ROS_ERROR("[UVDARDetector]: Failed to initialize FAST-based marker detection!");
-        return;
-      }
+      // the detector is created on the first image, since the GPU backend can only be verified once the image size is known
+      uvdf_.push_back(nullptr);
+      pending_stamps_.push_back(std::deque<ros::Time>());
     }
 
     // Subscribe to corresponding topics
@@ -110,6 +214,28 @@ public:
       sub_images_.push_back(nh_.subscribe(_camera_topics[i], 1, cals_image_[i]));
     }
 
+    /* tracking-guided detection //{ */
+    param_loader.loadParam("roi_detection", _roi_detection_, bool(false));
+    if (_roi_detection_){
+      std::vector<std::string> _roi_topics;
+      param_loader.loadParam("roi_topics", _roi_topics, _roi_topics);
+      param_loader.loadParam("roi_padding", _roi_padding_, 30);
+      param_loader.loadParam("roi_full_scan_period", _roi_full_scan_period_, 10);
+      if (_roi_topics.size() != _camera_count_) {
+        ROS_ERROR_STREAM("[UVDARDetector]: Tracking-guided detection is enabled, but the number of ROI topics (" << _roi_topics.size() << ") does not match the number of cameras (" << _camera_count_ << ")!");
+        return;
+      }
+
+      for (unsigned int i = 0; i < _camera_count_; ++i) {
+        roi_states_.push_back(std::make_unique<RoiState>());
+        points_callback_t callback = [image_index=i,this] (const mrs_msgs::ImagePointsWithFloatStampedConstPtr& points_msg) {
+          callbackTrackedPoints(points_msg, image_index);
+        };
+        sub_tracked_points_.push_back(nh_.subscribe(_roi_topics[i], 1, callback));
+      }
+    }
+    //}
+
     //}
 
     
@@ -130,7 +256,18 @@ public:
       if (_publish_sun_points_){
         pub_sun_points_.push_back(nh_.advertise<mrs_msgs::ImagePointsWithFloatStamped>(_points_seen_topics[i]+"/sun", 1));
       }
+
+      pub_dropped_frames_.push_back(nh_.advertise<std_msgs::UInt32>(_points_seen_topics[i]+"/dropped_frames", 1));
+      pub_overload_.push_back(nh_.advertise<uvdar_core::DetectorOverload>(_points_seen_topics[i]+"/overload", 1));
+      if (_adaptive_threshold_){
+        pub_thresholds_.push_back(nh_.advertise<uvdar_core::DetectorThresholds>(_points_seen_topics[i]+"/thresholds", 1, true));
+      }
+      if (_sun_cache_period_ > 0){
+        pub_sun_cache_.push_back(nh_.advertise<uvdar_core::DetectorSunCache>(_points_seen_topics[i]+"/sun_cache", 1));
+        sun_cache_published_.push_back(ros::Time(0));
+      }
     }
+    timer_dropped_frames_ = nh_.createTimer(ros::Duration(1.0), &UVDARDetector::callbackDroppedFrames, this);
 
     if (_publish_visualization_){
       pub_visualization_ = std::make_unique<mrs_lib::ImagePublisher>(boost::make_shared<ros::NodeHandle>(nh_));
@@ -146,6 +283,11 @@ public:
     ros::Time::waitForValid();
 
     initialized_ = true;
+
+    // each camera is processed by its own thread - this also keeps the GPU context of each detector on a single thread
+    for (unsigned int i = 0; i < _camera_count_; ++i) {
+      camera_workers_[i]->thread = std::thread(&UVDARDetector::workerLoop, this, i);
+    }
     ROS_INFO("[UVDARDetector]: Initialized.");
   }
   //}
@@ -155,6 +297,14 @@ public:
    * @brief destructor
    */
   ~UVDARDetector() {
+    for (auto& worker : camera_workers_){
+      worker->mailbox.close();
+    }
+    for (auto& worker : camera_workers_){
+      if (worker->thread.joinable()){
+        worker->thread.join();
+      }
+    }
   }
   //}
 
@@ -197,47 +347,365 @@ private:
      * @param image_index - index of the camera that produced this image message
      */
   void callbackImage(const sensor_msgs::ImageConstPtr& image_msg, int image_index) {
+    if (!initialized_) return; // the workers draining the mailboxes only exist once the initialization is finished
+
     cv_bridge::CvImageConstPtr image;
     image = cv_bridge::toCvShare(image_msg, enc::MONO8);
-    ros::NodeHandle nh("~");
-    timer_process_[image_index] = nh.createTimer(ros::Duration(0), boost::bind(&UVDARDetector::processSingleImage, this, _1, image, image_index), true, true);
     camera_image_sizes_[image_index] = image->image.size();
+    if (camera_workers_[image_index]->mailbox.put(image)){ // the worker was still busy with an older frame, which was never processed
+      camera_workers_[image_index]->dropped_frames++;
+    }
+  }
+  //}
+
+  /* workerLoop //{ */
+  /**
+   * @brief Processing loop of the worker thread of a single camera - always processes the latest received image of the camera
+   *
+   * @param image_index - index of the camera handled by this thread
+   */
+  void workerLoop(int image_index) {
+    cv_bridge::CvImageConstPtr image;
+    while (camera_workers_[image_index]->mailbox.take(image)){
+      processSingleImage(image, image_index);
+    }
+  }
+  //}
+
+  /* callbackDroppedFrames //{ */
+  /**
+   * @brief Publishes the number of frames of each camera that were replaced by a newer frame before they could be processed
+   *
+   * @param te - timer event - necessary for use of this method as a timer callback
+   */
+  void callbackDroppedFrames([[maybe_unused]] const ros::TimerEvent& te) {
+    for (unsigned int i = 0; i < camera_workers_.size(); ++i) {
+      std_msgs::UInt32 msg;
+      msg.data = camera_workers_[i]->dropped_frames.load();
+      pub_dropped_frames_[i].publish(msg);
+    }
+  }
+  //}
+
+
+  /* makeDetector //{ */
+  /**
+   * @brief Creates a FAST-based marker detector using the selected backend
+   *
+   * @param use_gpu - if true, the GPU backend is used, otherwise the CPU backend
+   *
+   * @return the new detector
+   */
+  std::unique_ptr<UVDARLedDetectFAST> makeDetector(bool use_gpu) {
+    // images with more points than MAX_POINTS_PER_IMAGE are not usable, so the detectors are allowed to stop (or to drop the overflowing tiles) as soon as the limit is exceeded
+    if (use_gpu){
+      auto detector = std::make_unique<UVDARLedDetectFASTGPU>(_gui_, _debug_, _threshold_, _threshold_differential_, THRESHOLD_SUN, _masks_);
+      detector->setDevice(_gpu_platform_, _gpu_device_path_);
+      detector->setPointLimit(MAX_POINTS_PER_IMAGE, _overload_tile_budget_);
+      return detector;
+    }
+
+    auto detector = std::make_unique<UVDARLedDetectFASTCPU>(_gui_, _debug_, _threshold_, _threshold_differential_, THRESHOLD_SUN, _masks_);
+    detector->setThreadCount(_cpu_threads_);
+    if ((detector->setPrescanKernel(_prescan_kernel_) != _prescan_kernel_) && (_prescan_kernel_ != UVDARLedDetectFASTCPU::PrescanKernel::AUTO)){
+      ROS_WARN_STREAM("[UVDARDetector]: The pre-scan kernel \"" << _prescan_kernel_name_ << "\" is not available in this build or on this CPU, the scalar kernel is used instead.");
+    }
+    detector->setPrescreen(_prescan_prescreen_);
+    detector->setPointLimit(MAX_POINTS_PER_IMAGE, _overload_tile_budget_);
+    return detector;
+  }
+  //}
+
+  /* makeBlobDetector //{ */
+  /**
+   * @brief Creates a marker detector based on connected components of bright pixels
+   *
+   * @return the new detector
+   */
+  std::unique_ptr<UVDARLedDetectFAST> makeBlobDetector() {
+    auto detector = std::make_unique<UVDARLedDetectBlob>(_gui_, _debug_, _threshold_, _threshold_differential_, THRESHOLD_SUN, _masks_);
+    detector->setAreaLimits(_blob_max_marker_area_, _blob_min_sun_area_);
+    detector->setPointLimit(MAX_POINTS_PER_IMAGE, _overload_tile_budget_);
+    return detector;
+  }
+  //}
+
+  /* benchmarkDetector //{ */
+  /**
+   * @brief Measures the mean time a detector takes to process the given image
+   *
+   * @param detector - the detector to measure
+   * @param image - the image to process repeatedly
+   * @param mask_id - the index of the mask to use, -1 for none
+   *
+   * @return the mean frame time in milliseconds, negative if the detector failed to process the image
+   */
+  double benchmarkDetector(UVDARLedDetectFAST& detector, const cv::Mat& image, int mask_id) {
+    std::vector<cv::Point> detected_points, sun_points;
+    if (!detector.processImage(image, detected_points, sun_points, mask_id)){ // warm-up - the first call also initializes the backend
+      return -1.0;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int k = 0; k < SELF_BENCHMARK_FRAMES; k++){
+      detector.processImage(image, detected_points, sun_points, mask_id);
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / SELF_BENCHMARK_FRAMES;
+  }
+  //}
+
+  /* prepareDetector //{ */
+  /**
+   * @brief Creates the detector of a camera on its first image. The GPU backend is used if it was selected (or allowed by "auto") and it manages to process the image, otherwise the CPU backend is used. If enabled, the frame time of every available backend is measured and logged
+   *
+   * @param image - the first image of the camera
+   * @param image_index - index of the camera that produced this image
+   *
+   * @return success
+   */
+  bool prepareDetector(const cv::Mat& image, int image_index) {
+    int mask_id = _use_masks_?image_index:-1;
+    std::unique_ptr<UVDARLedDetectFAST> detector_gpu, detector_cpu;
+    double time_gpu = -1.0, time_cpu = -1.0;
+
+    if (_detector_backend_ == "blob"){
+      if (_temporal_detection_[image_index]){
+        ROS_WARN_STREAM("[UVDARDetector]: Camera " << image_index << ": The temporal detection is not available in the blob backend, all markers will be retrieved.");
+      }
+      uvdf_[image_index] = makeBlobDetector();
+      if ((_sun_cache_period_ > 0) && !uvdf_[image_index]->setSunCache(_sun_cache_period_, _sun_cache_max_change_)){
+        ROS_WARN_STREAM("[UVDARDetector]: Camera " << image_index << ": The sun caching is not available in the blob backend, the sun will be searched for in every image.");
+      }
+      if (_detector_self_benchmark_){
+        double time_blob = benchmarkDetector(*uvdf_[image_index], image, mask_id);
+        ROS_INFO_STREAM("[UVDARDetector]: Camera " << image_index << ": Self-benchmark on a " << image.cols << "x" << image.rows << " image - "
+            << "blob: " << ((time_blob < 0.0)?std::string("failed"):(std::to_string(time_blob) + " ms")));
+      }
+      ROS_INFO_STREAM("[UVDARDetector]: Camera " << image_index << ": Using the blob backend of the marker detection.");
+      return true;
+    }
+
+    if (_temporal_detection_[image_index] && gpu_available_ && (_detector_backend_ == "gpu")){
+      ROS_WARN_STREAM("[UVDARDetector]: Camera " << image_index << ": The temporal detection is only available in the CPU backend, the CPU backend will be used.");
+    }
+
+    if (gpu_available_ && !_temporal_detection_[image_index]){
+      detector_gpu = makeDetector(true);
+      if (_detector_self_benchmark_){
+        time_gpu = benchmarkDetector(*detector_gpu, image, mask_id);
+      }
+      else {
+        std::vector<cv::Point> detected_points, sun_points;
+        time_gpu = detector_gpu->processImage(image, detected_points, sun_points, mask_id)?0.0:-1.0;
+      }
+      if (time_gpu < 0.0){
+        if (_detector_backend_ == "gpu"){
+          ROS_ERROR_STREAM("[UVDARDetector]: Camera " << image_index << ": The GPU backend was requested, but it failed to process the first image. Falling back to the CPU backend!");
+        }
+        else {
+          ROS_WARN_STREAM("[UVDARDetector]: Camera " << image_index << ": The GPU backend failed to process the first image, the CPU backend will be used.");
+        }
+        detector_gpu.reset();
+      }
+    }
+
+    if (!detector_gpu || _detector_self_benchmark_){
+      detector_cpu = makeDetector(false);
+      if (_detector_self_benchmark_){
+        time_cpu = benchmarkDetector(*detector_cpu, image, mask_id);
+      }
+    }
+
+    if (_detector_self_benchmark_){
+      ROS_INFO_STREAM("[UVDARDetector]: Camera " << image_index << ": Self-benchmark on a " << image.cols << "x" << image.rows << " image - "
+          << "gpu: " << ((time_gpu < 0.0)?std::string("unavailable"):(std::to_string(time_gpu) + " ms")) << ", "
+          << "cpu (" << _cpu_threads_ << " threads): " << ((time_cpu < 0.0)?std::string("failed"):(std::to_string(time_cpu) + " ms")));
+    }
+
+    if (detector_gpu){
+      uvdf_[image_index] = std::move(detector_gpu);
+      ROS_INFO_STREAM("[UVDARDetector]: Camera " << image_index << ": Using the GPU backend of the FAST-based marker detection.");
+    }
+    else {
+      uvdf_[image_index] = std::move(detector_cpu);
+      ROS_INFO_STREAM("[UVDARDetector]: Camera " << image_index << ": Using the CPU backend of the FAST-based marker detection.");
+    }
+
+    if (_temporal_detection_[image_index]){ // enabled only now, so that the history does not start with the repeated images of the self-benchmark
+      uvdf_[image_index]->setTemporalMode(true, _temporal_decay_, _temporal_min_change_);
+      ROS_INFO_STREAM("[UVDARDetector]: Camera " << image_index << ": Using the temporal detection - only the markers that recently changed their brightness are retrieved.");
+    }
+
+    if (_sun_cache_period_ > 0){
+      if (uvdf_[image_index]->setSunCache(_sun_cache_period_, _sun_cache_max_change_)){
+        ROS_INFO_STREAM("[UVDARDetector]: Camera " << image_index << ": Caching the sun for up to " << _sun_cache_period_ << " images.");
+      }
+      else {
+        ROS_WARN_STREAM("[UVDARDetector]: Camera " << image_index << ": The sun caching is not available in the selected backend, the sun will be searched for in every image.");
+      }
+    }
+
+    if (_gpu_pipeline_depth_ > 1){ // set only after the self-benchmark, so that the benchmark images do not remain in the pipeline
+      if (uvdf_[image_index]->setPipelineDepth(_gpu_pipeline_depth_)){
+        ROS_INFO_STREAM("[UVDARDetector]: Camera " << image_index << ": Processing " << _gpu_pipeline_depth_ << " images at once - the points are published " << uvdf_[image_index]->getResultDelay() << " image(s) late, with the time stamps of their images.");
+      }
+      else {
+        ROS_WARN_STREAM("[UVDARDetector]: Camera " << image_index << ": Processing " << _gpu_pipeline_depth_ << " images at once is not available in the selected backend, each image will be processed before the next one.");
+      }
+    }
+
+    return (bool)(uvdf_[image_index]);
   }
   //}
 
+  /* callbackTrackedPoints //{ */
+  /**
+   * @brief Callback for the points of the markers currently tracked by the blink processor, used to select the regions of the tracking-guided detection
+   *
+   * @param points_msg - the tracked points
+   * @param image_index - index of the camera that produced the image these points were retrieved from
+   */
+  void callbackTrackedPoints(const mrs_msgs::ImagePointsWithFloatStampedConstPtr& points_msg, int image_index) {
+    if (!initialized_) return;
+
+    auto& state = *roi_states_[image_index];
+    std::scoped_lock lock(state.mutex);
+    state.tracked_points.clear();
+    for (auto& point : points_msg->points){
+      state.tracked_points.push_back(cv::Point(point.x, point.y));
+    }
+    state.tracked_stamp = points_msg->stamp;
+  }
+  //}
+
+  /* selectRegions //{ */
+  /**
+   * @brief Decides whether the current image of a camera can be searched only around the known markers and if so, selects the regions to search. The whole image is searched periodically, whenever the number of tracked markers changes and whenever the tracking information is missing or outdated, so that new markers are picked up
+   *
+   * @param stamp - the time stamp of the current image
+   * @param image_index - index of the camera that produced the image
+   * @param regions - output - the regions around the tracked markers and the points detected in the previous image of the camera, padded by _roi_padding_
+   *
+   * @return true if only the regions should be searched, false for a full-image search
+   */
+  bool selectRegions(const ros::Time& stamp, int image_index, std::vector<cv::Rect>& regions) {
+    auto& state = *roi_states_[image_index];
+    std::vector<cv::Point> tracked_points;
+    ros::Time tracked_stamp;
+    {
+      std::scoped_lock lock(state.mutex);
+      tracked_points = state.tracked_points;
+      tracked_stamp = state.tracked_stamp;
+    }
+
+    bool full_scan =
+      tracked_points.empty() ||
+      ((stamp - tracked_stamp).toSec() > ROI_MAX_AGE) ||
+      (state.frames_since_full_scan >= _roi_full_scan_period_) ||
+      (tracked_points.size() != state.tracked_count_at_full_scan);
+
+    if (full_scan){
+      state.frames_since_full_scan = 1;
+      state.tracked_count_at_full_scan = tracked_points.size();
+      return false;
+    }
+    state.frames_since_full_scan++;
+
+    int size = 2*_roi_padding_+1;
+    for (auto& point : tracked_points){
+      regions.push_back(cv::Rect(point.x-_roi_padding_, point.y-_roi_padding_, size, size));
+    }
+    for (auto& point : state.last_detected){ // keeps following markers that appeared since the last update of the tracking
+      regions.push_back(cv::Rect(point.x-_roi_padding_, point.y-_roi_padding_, size, size));
+    }
+    return true;
+  }
+  //}
 
   /* processSingleImage //{ */
 
   /**
    * @brief Extracts small bright points from input image and publishes them. Optionally also publishes points corresponding to the sun.
    *
-   * @param te - timer event - necessary for use of this method as a timer callback
    * @param image - the input image
    * @param image_index - index of the camera that produced this image
    */
-  void processSingleImage([[maybe_unused]] const ros::TimerEvent& te, const cv_bridge::CvImageConstPtr image, int image_index) {
-    if (!initialized_){
-      ROS_WARN_STREAM_THROTTLE(1.0,"[UVDARDetector]: Not yet initialized, dropping message...");
-      return;
-    }
-
+  void processSingleImage(const cv_bridge::CvImageConstPtr image, int image_index) {
+    DetectionOverload overload;
+    ros::Time stamp = image->header.stamp;
     {
       std::scoped_lock lock(*mutex_camera_image_[image_index]);
       images_current_[image_index] = image->image;
       sun_points_[image_index].clear();
       detected_points_[image_index].clear();
 
-      if ( ! (uvdf_[image_index]->processImage(
-              image->image,
-              detected_points_[image_index],
-              sun_points_[image_index],
-              _use_masks_?image_index:-1
-              )
-            )
-         ){
+      if (!uvdf_[image_index]){
+        if (!prepareDetector(image->image, image_index)){
+          ROS_ERROR_STREAM("[UVDARDetector]: Failed to initialize FAST-based marker detection for camera " << image_index << "!");
+          return;
+        }
+      }
+
+      bool success;
+      std::vector<cv::Rect> regions;
+      auto detection_start = std::chrono::steady_clock::now();
+      if (_roi_detection_ && selectRegions(image->header.stamp, image_index, regions)){
+        success = uvdf_[image_index]->processImageRegions(
+            image->image,
+            regions,
+            detected_points_[image_index],
+            sun_points_[image_index],
+            _use_masks_?image_index:-1
+            );
+      }
+      else {
+        success = uvdf_[image_index]->processImage(
+            image->image,
+            detected_points_[image_index],
+            sun_points_[image_index],
+            _use_masks_?image_index:-1
+            );
+      }
+      if (_roi_detection_){
+        roi_states_[image_index]->last_detected = detected_points_[image_index];
+      }
+
+      if (!success){
         ROS_ERROR_STREAM("Failed to extract markers from the image!");
         return;
       }
+
+      if (_debug_){
+        logBandTimings(stamp, image_index);
+      }
+
+      // with a pipelined detector, the retrieved points belong to an earlier image
+      int result_delay = uvdf_[image_index]->getResultDelay();
+      auto& pending_stamps = pending_stamps_[image_index];
+      if (result_delay > 0){
+        pending_stamps.push_back(stamp);
+        if ((int)(pending_stamps.size()) <= result_delay){
+          return;
+        }
+        stamp = pending_stamps.front();
+        pending_stamps.pop_front();
+      }
+      else {
+        pending_stamps.clear();
+      }
+
+      overload = uvdf_[image_index]->getOverload();
+
+      if (_sun_cache_period_ > 0){
+        publishSunCache(uvdf_[image_index]->getSunCacheStats(), stamp, image_index);
+      }
+
+      if (_adaptive_threshold_){
+        std::chrono::duration<double, std::milli> detection_time = std::chrono::steady_clock::now() - detection_start;
+        int point_count = overload.overloaded?overload.point_count:(int)(detected_points_[image_index].size());
+        adaptThresholds(point_count, detection_time.count(), stamp, image_index);
+      }
       /* ROS_INFO_STREAM("Cam" << image_index << ". There are " << detected_points_[image_index].size() << " detected points."); */
 
       if (sun_points_[image_index].size() > 30){
@@ -246,40 +714,181 @@ private:
       /* ROS_INFO_STREAM("There are " << sun_points_[image_index].size() << " detected potential sun points."); */
     }
 
+    if (overload.overloaded){
+      publishOverload(overload, stamp, image_index);
+      if (!overload.degraded){
+        ROS_WARN_STREAM_THROTTLE(1.0, "[UVDARDetector]: Camera " << image_index << ": Over " << MAX_POINTS_PER_IMAGE << " points found (" << overload.tile_point_count << " of them in the tile " << overload.tile << "). Skipping noisy image.");
+        return;
+      }
+      ROS_WARN_STREAM_THROTTLE(1.0, "[UVDARDetector]: Camera " << image_index << ": Over " << MAX_POINTS_PER_IMAGE << " points found (" << overload.tile_point_count << " of them in the tile " << overload.tile << "). Dropped " << overload.dropped_tiles.size() << " overflowing tile(s).");
+    }
+
     if (detected_points_[image_index].size()>MAX_POINTS_PER_IMAGE){
       ROS_WARN_STREAM("[UVDARDetector]: Over " << MAX_POINTS_PER_IMAGE << " points received. Skipping noisy image.");
       return;
     }
 
-    {
-      std::scoped_lock lock(mutex_pub_);
-      if (_publish_sun_points_){
-        mrs_msgs::ImagePointsWithFloatStamped msg_sun;
-        msg_sun.stamp = image->header.stamp;
-        msg_sun.image_width = image->image.cols;
-        msg_sun.image_height = image->image.rows;
-        for (auto& sun_point : sun_points_[image_index]) {
-          mrs_msgs::Point2DWithFloat point;
-          point.x = sun_point.x;
-          point.y = sun_point.y;
-          msg_sun.points.push_back(point);
-        }
-        pub_sun_points_[image_index].publish(msg_sun);
-      }
-
-      mrs_msgs::ImagePointsWithFloatStamped msg_detected;
-      msg_detected.stamp = image->header.stamp;
-      msg_detected.image_width = image->image.cols;
-      msg_detected.image_height = image->image.rows;
-      for (auto& detected_point : detected_points_[image_index]) {
+    // the messages are published as shared pointers to const, so that subscribers in the same nodelet manager receive them without copying or serialization
+    if (_publish_sun_points_){
+      auto msg_sun = boost::make_shared<mrs_msgs::ImagePointsWithFloatStamped>();
+      msg_sun->stamp = stamp;
+      msg_sun->image_width = image->image.cols;
+      msg_sun->image_height = image->image.rows;
+      msg_sun->points.reserve(sun_points_[image_index].size());
+      for (auto& sun_point : sun_points_[image_index]) {
         mrs_msgs::Point2DWithFloat point;
-        point.x = detected_point.x;
-        point.y = detected_point.y;
-        msg_detected.points.push_back(point);
+        point.x = sun_point.x;
+        point.y = sun_point.y;
+        msg_sun->points.push_back(point);
       }
-      pub_candidate_points_[image_index].publish(msg_detected);
+      pub_sun_points_[image_index].publish(mrs_msgs::ImagePointsWithFloatStampedConstPtr(msg_sun));
+    }
+
+    auto msg_detected = boost::make_shared<mrs_msgs::ImagePointsWithFloatStamped>();
+    msg_detected->stamp = stamp;
+    msg_detected->image_width = image->image.cols;
+    msg_detected->image_height = image->image.rows;
+    msg_detected->points.reserve(detected_points_[image_index].size());
+    for (auto& detected_point : detected_points_[image_index]) {
+      mrs_msgs::Point2DWithFloat point;
+      point.x = detected_point.x;
+      point.y = detected_point.y;
+      msg_detected->points.push_back(point);
+    }
+    pub_candidate_points_[image_index].publish(mrs_msgs::ImagePointsWithFloatStampedConstPtr(msg_detected));
+
+  }
+  //}
+
+  /* adaptThresholds //{ */
+  /**
+   * @brief Updates the adaptive threshold controller of a camera with the outcome of an image, and applies and publishes the adjusted thresholds if they changed
+   *
+   * @param point_count - the number of points retrieved from the image
+   * @param detection_time - the time spent on the detection, in milliseconds
+   * @param stamp - the time stamp of the image
+   * @param image_index - index of the camera that produced the image
+   */
+  void adaptThresholds(int point_count, double detection_time, const ros::Time& stamp, int image_index) {
+    auto& controller = *threshold_controllers_[image_index];
+    auto adjustment = controller.update(point_count, detection_time);
+    if (adjustment == ThresholdController::Adjustment::NONE){
+      return;
+    }
+
+    uvdf_[image_index]->setThresholds(controller.getThreshold(), controller.getThresholdDiff(), THRESHOLD_SUN);
+    ROS_INFO_STREAM("[UVDARDetector]: Camera " << image_index << ": " << ((adjustment == ThresholdController::Adjustment::RAISED)?"Raised":"Lowered") << " the thresholds to " << controller.getThreshold() << " (differential " << controller.getThresholdDiff() << ") - " << point_count << " points in " << detection_time << " ms.");
+
+    auto msg = boost::make_shared<uvdar_core::DetectorThresholds>();
+    msg->stamp = stamp;
+    msg->adjustment = (adjustment == ThresholdController::Adjustment::RAISED)?1:-1;
+    msg->threshold = controller.getThreshold();
+    msg->threshold_differential = controller.getThresholdDiff();
+    msg->threshold_sun = THRESHOLD_SUN;
+    msg->point_count = point_count;
+    msg->processing_time = detection_time;
+    pub_thresholds_[image_index].publish(uvdar_core::DetectorThresholdsConstPtr(msg));
+  }
+  //}
+
+  /* publishSunCache //{ */
+  /**
+   * @brief Publishes the statistics of the sun caching of a camera, at most once per second
+   *
+   * @param stats - the statistics reported by the detector
+   * @param stamp - the time stamp of the current image
+   * @param image_index - index of the camera that produced the image
+   */
+  void publishSunCache(const SunCacheStats& stats, const ros::Time& stamp, int image_index) {
+    if ((stamp - sun_cache_published_[image_index]) < ros::Duration(1.0)){
+      return;
+    }
+    sun_cache_published_[image_index] = stamp;
+
+    auto msg = boost::make_shared<uvdar_core::DetectorSunCache>();
+    msg->stamp = stamp;
+    msg->images = stats.images;
+    msg->hits = stats.hits;
+    msg->hit_rate = (stats.images > 0)?((double)(stats.hits) / stats.images):0.0;
+    msg->time_saved = stats.time_saved;
+    pub_sun_cache_[image_index].publish(uvdar_core::DetectorSunCacheConstPtr(msg));
+  }
+  //}
+
+  /* logBandTimings //{ */
+  /**
+   * @brief Logs the mean time the CPU detector of a camera spent on each of its bands, at most once per second. If the slowest band takes much longer than the mean, the markers are concentrated in a part of the image and more CPU threads would not shorten the detection
+   *
+   * @param stamp - the time stamp of the current image
+   * @param image_index - index of the camera that produced the image
+   */
+  void logBandTimings(const ros::Time& stamp, int image_index) {
+    auto detector = dynamic_cast<UVDARLedDetectFASTCPU*>(uvdf_[image_index].get());
+    if (detector == nullptr){
+      return;
+    }
+
+    auto& worker = *camera_workers_[image_index];
+    const std::vector<double>& timings = detector->getBandTimings();
+    if (worker.band_time_sums.size() != timings.size()){ // the number of bands changes with the image size
+      worker.band_time_sums.assign(timings.size(), 0.0);
+      worker.band_time_images = 0;
+    }
+    for (size_t b = 0; b < timings.size(); b++){
+      worker.band_time_sums[b] += timings[b];
+    }
+    worker.band_time_images++;
+
+    if (((stamp - worker.band_times_logged) < ros::Duration(1.0)) || worker.band_time_sums.empty()){
+      return;
+    }
+    worker.band_times_logged = stamp;
+
+    std::ostringstream bands;
+    double total = 0.0, slowest = 0.0;
+    for (size_t b = 0; b < worker.band_time_sums.size(); b++){
+      double mean = worker.band_time_sums[b] / worker.band_time_images;
+      bands << ((b > 0)?", ":"") << mean;
+      total += mean;
+      slowest = std::max(slowest, mean);
     }
+    double imbalance = (total > 0.0)?(slowest * worker.band_time_sums.size() / total):1.0;
+    ROS_INFO_STREAM("[UVDARDetector]: Camera " << image_index << ": Mean band times over " << worker.band_time_images << " images [ms]: " << bands.str() << " (slowest/mean: " << imbalance << ")");
 
+    worker.band_time_sums.assign(worker.band_time_sums.size(), 0.0);
+    worker.band_time_images = 0;
+  }
+  //}
+
+  /* publishOverload //{ */
+  /**
+   * @brief Publishes the description of an image with more points than MAX_POINTS_PER_IMAGE
+   *
+   * @param overload - the overload reported by the detector
+   * @param stamp - the time stamp of the image
+   * @param image_index - index of the camera that produced the image
+   */
+  void publishOverload(const DetectionOverload& overload, const ros::Time& stamp, int image_index) {
+    auto toRoi = [](const cv::Rect& rect) {
+      sensor_msgs::RegionOfInterest roi;
+      roi.x_offset = rect.x;
+      roi.y_offset = rect.y;
+      roi.width = rect.width;
+      roi.height = rect.height;
+      return roi;
+    };
+
+    auto msg = boost::make_shared<uvdar_core::DetectorOverload>();
+    msg->stamp = stamp;
+    msg->point_count = overload.point_count;
+    msg->point_limit = MAX_POINTS_PER_IMAGE;
+    msg->degraded = overload.degraded;
+    msg->overflow_tile = toRoi(overload.tile);
+    msg->overflow_tile_point_count = overload.tile_point_count;
+    for (auto& tile : overload.dropped_tiles){
+      msg->dropped_tiles.push_back(toRoi(tile));
+    }
+    pub_overload_[image_index].publish(uvdar_core::DetectorOverloadConstPtr(msg));
   }
   //}
 
@@ -346,7 +955,7 @@ private:
   
 private:
   std::string _uav_name_;
-  bool initialized_ = false;
+  std::atomic<bool> initialized_ = false; // read by the callbacks of the subscribers, which may run before onInit finishes
 
   std::vector<ros::Subscriber> sub_images_;
   unsigned int _camera_count_;
@@ -381,13 +990,74 @@ private:
   int  _threshold_;
   int  _threshold_differential_;
 
+  bool _roi_detection_ = false;
+  int  _roi_padding_;
+  int  _roi_full_scan_period_;
+  /**
+   * @brief State of the tracking-guided detection of a single camera
+   */
+  struct RoiState {
+    std::mutex mutex; // guards the tracked points, which are written by the subscriber callback
+    std::vector<cv::Point> tracked_points;
+    ros::Time tracked_stamp;
+    std::vector<cv::Point> last_detected;
+    int frames_since_full_scan = 0;
+    size_t tracked_count_at_full_scan = 0;
+  };
+  std::vector<std::unique_ptr<RoiState>> roi_states_;
+  using points_callback_t = boost::function<void (const mrs_msgs::ImagePointsWithFloatStampedConstPtr&)>;
+  std::vector<ros::Subscriber> sub_tracked_points_;
+
+  std::string _detector_backend_;
+  bool _detector_self_benchmark_;
+  int  _cpu_threads_;
+  std::string _prescan_kernel_name_;
+  UVDARLedDetectFASTCPU::PrescanKernel _prescan_kernel_ = UVDARLedDetectFASTCPU::PrescanKernel::AUTO;
+  bool _prescan_prescreen_;
+  bool _overload_tile_budget_;
+  int  _blob_max_marker_area_;
+  int  _blob_min_sun_area_;
+  std::string _gpu_platform_name_;
+  compute_lib_platform_t _gpu_platform_ = COMPUTE_LIB_PLATFORM_GBM;
+  std::string _gpu_device_path_;
+  int _gpu_pipeline_depth_;
+  std::vector<std::deque<ros::Time>> pending_stamps_; // the stamps of the images in flight of each camera - accessed under its image mutex
+
+  std::vector<bool> _temporal_detection_;
+  int  _temporal_decay_;
+  int  _temporal_min_change_;
+
+  int    _sun_cache_period_;
+  double _sun_cache_max_change_;
+  std::vector<ros::Publisher> pub_sun_cache_;
+  std::vector<ros::Time> sun_cache_published_; // written only by the worker thread of each camera
+
+  bool _adaptive_threshold_;
+  std::vector<std::unique_ptr<ThresholdController>> threshold_controllers_;
+  std::vector<ros::Publisher> pub_thresholds_;
+  std::vector<ros::Publisher> pub_overload_;
+  bool gpu_available_ = false;
+
   bool _use_masks_;
   std::vector<std::string> _mask_file_names_;
   std::vector<cv::Mat> _masks_;
 
   std::vector<std::unique_ptr<UVDARLedDetectFAST>> uvdf_;
-  std::mutex  mutex_pub_;
-  std::vector<ros::Timer> timer_process_;
+
+  /**
+   * @brief The processing thread of a single camera, together with the mailbox feeding it
+   */
+  struct CameraWorker {
+    FrameMailbox<cv_bridge::CvImageConstPtr> mailbox;
+    std::thread thread;
+    std::atomic<unsigned int> dropped_frames{0};
+    std::vector<double> band_time_sums; // the band times of the CPU detector summed since they were last logged - accessed only by the worker thread
+    int band_time_images = 0;
+    ros::Time band_times_logged;
+  };
+  std::vector<std::unique_ptr<CameraWorker>> camera_workers_;
+  std::vector<ros::Publisher> pub_dropped_frames_;
+  ros::Timer timer_dropped_frames_;
 
 };
 
@@ -0,0 +1,575 @@
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgcodecs/imgcodecs.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "benchmark/command_line.h"
+#include "detect/detector_defaults.h"
+#include "detect/synthetic_frames.h"
+#include "detect/uv_led_detect_fast_cpu.h"
+#include "detect/uv_led_detect_fast_gpu.h"
+#include "detect/uv_led_detect_blob.h"
+
+/*
+ * Standalone (ROS-free) throughput benchmark of the marker detection backends.
+ * Runs each selected backend on the same sequence of images - either recorded PNG images, or synthetic UV frames - and reports the per-frame latency percentiles, the throughput, the numbers of raw candidates and of retrieved points and, for the CPU backend, the mean time of each of its bands as CSV or JSON.
+ *
+ * Examples:
+ *   uvdar_detector_benchmark --markers 20 --suns 1 --frames 500 --format json
+ *   uvdar_detector_benchmark --images /data/uvdar_left --passes 3 --backends cpu,blob --cpu_threads 4
+ */
+
+namespace uvdar {
+
+  /**
+   * @brief The settings of the benchmark, as given on the command line
+   */
+  struct BenchmarkOptions {
+    std::string images;            ///< a directory or a glob pattern of recorded images - synthetic frames are generated if empty
+    int passes = 1;                ///< the number of times the recorded images are processed
+    int frames = 300;              ///< the number of synthetic frames
+    int width = 752;
+    int height = 480;
+    int markers = 10;              ///< the number of blinking markers in the synthetic frames
+    int suns = 0;                  ///< the number of sun discs in the synthetic frames
+    double noise = 6.0;            ///< the standard deviation of the background noise of the synthetic frames
+    unsigned int seed = 0;
+    int warmup = 10;               ///< the images processed before the measurement - the first one also initializes the backend
+    std::vector<std::string> backends = {"cpu", "gpu", "blob"};
+    int threshold = 200;
+    int threshold_diff = 100;
+    int cpu_threads = 1;
+    int max_points = MAX_POINTS_PER_IMAGE;
+    int sun_cache_period = 0;
+    std::string gpu_platform = "gbm";
+    std::string gpu_device_path;
+    int gpu_pipeline_depth = 1;
+    std::string mask;
+    std::string format = "csv";
+    std::string output;            ///< the report file - the standard output if empty
+  };
+
+  /**
+   * @brief The measured performance of a single backend
+   */
+  struct BenchmarkResult {
+    std::string backend;
+    int frames = 0;
+    double mean_ms = 0.0;
+    double p50_ms = 0.0;
+    double p90_ms = 0.0;
+    double p99_ms = 0.0;
+    double max_ms = 0.0;
+    double fps = 0.0;
+    double mean_points = 0.0;     ///< the mean number of retrieved marker points per image
+    double mean_sun_points = 0.0;
+    double mean_candidates = 0.0; ///< the mean number of raw marker candidates per image, before their merging and filtering
+    int overloaded = 0;           ///< the number of images exceeding the point limit
+    std::vector<double> band_ms;  ///< the mean time spent on each band of the CPU backend per image, from the top of the image - empty for the other backends
+    double band_imbalance = 0.0;  ///< the time of the slowest band relative to the mean band time - close to 1 if more threads would shorten the detection proportionally
+  };
+
+  /* SyntheticScene //{ */
+  /**
+   * @brief Generates a deterministic sequence of UV camera frames - a dark, noisy background with small blinking markers moving across the image, and optionally large saturated sun discs with glare around them
+   */
+  class SyntheticScene {
+    public:
+      SyntheticScene(const BenchmarkOptions& i_options) : options_(i_options) {
+        reset();
+      }
+
+      /**
+       * @brief Starts the sequence again from its first frame
+       */
+      void reset() {
+        rng_.seed(options_.seed);
+        std::uniform_real_distribution<double> pos_x(0.0, options_.width - 1.0);
+        std::uniform_real_distribution<double> pos_y(0.0, options_.height - 1.0);
+        std::uniform_real_distribution<double> velocity(-2.0, 2.0);
+        std::uniform_int_distribution<int> radius(1, 3);
+        std::uniform_int_distribution<int> peak(180, 255);
+        std::uniform_int_distribution<int> period(2, 8);
+
+        markers_.clear();
+        for (int i = 0; i < options_.markers; i++) {
+          markers_.push_back({pos_x(rng_), pos_y(rng_), velocity(rng_), velocity(rng_), radius(rng_), peak(rng_), period(rng_)});
+        }
+
+        std::uniform_int_distribution<int> sun_radius(15, 40);
+        suns_.clear();
+        for (int i = 0; i < options_.suns; i++) {
+          suns_.push_back({pos_x(rng_), pos_y(rng_), sun_radius(rng_)});
+        }
+
+        // the noise is drawn once and then read from random offsets, which is much faster than drawing it for every pixel of every frame
+        std::normal_distribution<double> noise(0.0, options_.noise);
+        noise_.resize(2 * options_.width * options_.height);
+        for (auto& value : noise_) {
+          value = (short)(std::lround(noise(rng_)));
+        }
+        frame_index_ = 0;
+      }
+
+      /**
+       * @brief Renders the next frame of the sequence
+       */
+      void next(cv::Mat& o_frame) {
+        o_frame = cv::Mat(cv::Size(options_.width, options_.height), CV_8UC1);
+        int pixels = options_.width * options_.height;
+        int offset = std::uniform_int_distribution<int>(0, pixels - 1)(rng_);
+        for (int i = 0; i < pixels; i++) {
+          o_frame.data[i] = (unsigned char)(std::clamp(BACKGROUND + noise_[offset + i], 0, 255));
+        }
+
+        for (auto& sun : suns_) {
+          synthetic::drawSun(o_frame, cv::Point((int)(std::lround(sun.x)), (int)(std::lround(sun.y))), sun.radius);
+        }
+
+        for (auto& marker : markers_) {
+          if (((frame_index_ / marker.half_period) % 2) == 0) { // blinking
+            synthetic::drawMarker(o_frame, cv::Point((int)(std::lround(marker.x)), (int)(std::lround(marker.y))), marker.peak, marker.radius);
+          }
+          marker.x += marker.vx;
+          marker.y += marker.vy;
+          if ((marker.x < 0.0) || (marker.x > (options_.width - 1))) {
+            marker.vx = -marker.vx;
+          }
+          if ((marker.y < 0.0) || (marker.y > (options_.height - 1))) {
+            marker.vy = -marker.vy;
+          }
+        }
+        frame_index_++;
+      }
+
+    private:
+      struct Marker {
+        double x, y, vx, vy;
+        int radius;
+        int peak;
+        int half_period; ///< the number of frames the marker stays on or off
+      };
+
+      struct Sun {
+        double x, y;
+        int radius;
+      };
+
+      static constexpr int BACKGROUND = 12;
+      const BenchmarkOptions& options_;
+      std::mt19937 rng_;
+      std::vector<Marker> markers_;
+      std::vector<Sun> suns_;
+      std::vector<short> noise_;
+      int frame_index_ = 0;
+  };
+  //}
+
+  /* FrameSource //{ */
+  /**
+   * @brief Provides the images of the benchmark - the same sequence for each backend
+   */
+  class FrameSource {
+    public:
+      FrameSource(const BenchmarkOptions& i_options) : options_(i_options), scene_(i_options) {
+      }
+
+      /**
+       * @brief Loads the recorded images, if selected
+       *
+       * @return Success
+       */
+      bool load() {
+        if (options_.images.empty()) {
+          return true;
+        }
+        std::string pattern = options_.images;
+        if (pattern.find('*') == std::string::npos) {
+          pattern += "/*.png";
+        }
+        std::vector<cv::String> files;
+        cv::glob(pattern, files, false);
+        std::sort(files.begin(), files.end());
+        for (auto& file : files) {
+          cv::Mat image = cv::imread(file, cv::IMREAD_GRAYSCALE);
+          if (image.empty()) {
+            std::cerr << "[UVDARDetectorBenchmark]: Failed to load the image " << file << "!" << std::endl;
+            return false;
+          }
+          if (!recorded_.empty() && (image.size() != recorded_.front().size())) {
+            std::cerr << "[UVDARDetectorBenchmark]: The image " << file << " differs in size from the first one!" << std::endl;
+            return false;
+          }
+          recorded_.push_back(image);
+        }
+        if (recorded_.empty()) {
+          std::cerr << "[UVDARDetectorBenchmark]: No images match " << pattern << "!" << std::endl;
+          return false;
+        }
+        return true;
+      }
+
+      /**
+       * @brief The number of images of the whole sequence
+       */
+      int count() const {
+        return options_.images.empty() ? options_.frames : ((int)(recorded_.size()) * options_.passes);
+      }
+
+      /**
+       * @brief Starts the sequence again from its first image
+       */
+      void reset() {
+        index_ = 0;
+        scene_.reset();
+      }
+
+      /**
+       * @brief Retrieves the next image of the sequence, repeating it from the start if it ran out
+       */
+      void next(cv::Mat& o_image) {
+        if (recorded_.empty()) {
+          scene_.next(o_image);
+        } else {
+          o_image = recorded_[index_ % recorded_.size()];
+        }
+        index_++;
+      }
+
+      /**
+       * @brief A short description of the images for the report
+       */
+      std::string describe() const {
+        if (!recorded_.empty()) {
+          return "recorded " + std::to_string(recorded_.size()) + " images of " + std::to_string(recorded_.front().cols) + "x" + std::to_string(recorded_.front().rows) + " from " + options_.images;
+        }
+        std::ostringstream description;
+        description << "synthetic " << options_.width << "x" << options_.height << ", " << options_.markers << " markers, " << options_.suns << " suns, noise " << options_.noise;
+        return description.str();
+      }
+
+      cv::Size size() const {
+        return recorded_.empty() ? cv::Size(options_.width, options_.height) : recorded_.front().size();
+      }
+
+    private:
+      const BenchmarkOptions& options_;
+      SyntheticScene scene_;
+      std::vector<cv::Mat> recorded_;
+      size_t index_ = 0;
+  };
+  //}
+
+  /* makeBackend //{ */
+  /**
+   * @brief Creates a detector of the given backend, configured as in the detector node
+   *
+   * @param o_error Output - the reason if the backend is not available
+   *
+   * @return The detector, empty if the backend is not available
+   */
+  std::unique_ptr<UVDARLedDetectFAST> makeBackend(const std::string& name, const BenchmarkOptions& options, const std::vector<cv::Mat>& masks, std::string& o_error) {
+    std::unique_ptr<UVDARLedDetectFAST> detector;
+    if (name == "cpu") {
+      auto cpu = std::make_unique<UVDARLedDetectFASTCPU>(false, false, options.threshold, options.threshold_diff, THRESHOLD_SUN, masks);
+      cpu->setThreadCount(options.cpu_threads);
+      detector = std::move(cpu);
+    } else if (name == "gpu") {
+      std::map<std::string, compute_lib_platform_t> platforms = {{"gbm", COMPUTE_LIB_PLATFORM_GBM}, {"device", COMPUTE_LIB_PLATFORM_DEVICE}, {"surfaceless", COMPUTE_LIB_PLATFORM_SURFACELESS}, {"auto", COMPUTE_LIB_PLATFORM_AUTO}};
+      if (platforms.count(options.gpu_platform) == 0) {
+        o_error = "unknown GPU platform \"" + options.gpu_platform + "\"";
+        return nullptr;
+      }
+      if (!UVDARLedDetectFASTGPU::probe(o_error, platforms[options.gpu_platform], options.gpu_device_path)) {
+        return nullptr;
+      }
+      auto gpu = std::make_unique<UVDARLedDetectFASTGPU>(false, false, options.threshold, options.threshold_diff, THRESHOLD_SUN, masks);
+      gpu->setDevice(platforms[options.gpu_platform], options.gpu_device_path);
+      detector = std::move(gpu);
+    } else if (name == "blob") {
+      detector = std::make_unique<UVDARLedDetectBlob>(false, false, options.threshold, options.threshold_diff, THRESHOLD_SUN, masks);
+    } else {
+      o_error = "unknown backend";
+      return nullptr;
+    }
+    detector->setPointLimit(options.max_points, false);
+    return detector;
+  }
+  //}
+
+  /* percentile //{ */
+  /**
+   * @brief The nearest-rank percentile of sorted values
+   */
+  double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+      return 0.0;
+    }
+    size_t rank = (size_t)(std::ceil((p / 100.0) * sorted.size()));
+    return sorted[std::clamp(rank, (size_t)(1), sorted.size()) - 1];
+  }
+  //}
+
+  /* runBackend //{ */
+  /**
+   * @brief Measures a backend on the whole sequence of images
+   *
+   * @return Success
+   */
+  bool runBackend(UVDARLedDetectFAST& detector, const std::string& name, FrameSource& source, const BenchmarkOptions& options, int mask_id, BenchmarkResult& o_result) {
+    std::vector<cv::Point2i> detected_points, sun_points;
+    cv::Mat image;
+
+    source.reset();
+    for (int k = 0; k < options.warmup; k++) {
+      source.next(image);
+      if (!detector.processImage(image, detected_points, sun_points, mask_id)) {
+        std::cerr << "[UVDARDetectorBenchmark]: The " << name << " backend failed to process a warm-up image!" << std::endl;
+        return false;
+      }
+    }
+
+    // set only after the warm-up, as in the detector node, so that the warm-up images do not remain in the pipeline
+    if ((options.gpu_pipeline_depth > 1) && !detector.setPipelineDepth(options.gpu_pipeline_depth)) {
+      std::cerr << "[UVDARDetectorBenchmark]: The " << name << " backend does not support processing " << options.gpu_pipeline_depth << " images at once, each image is processed before the next one." << std::endl;
+    }
+    if ((options.sun_cache_period > 0) && !detector.setSunCache(options.sun_cache_period, 0.2)) {
+      std::cerr << "[UVDARDetectorBenchmark]: The " << name << " backend does not support the sun caching." << std::endl;
+    }
+
+    source.reset();
+    int count = source.count();
+    std::vector<double> latencies;
+    latencies.reserve(count);
+    long points = 0, sun_point_count = 0, candidates = 0;
+    int retrieved = 0;
+    o_result = BenchmarkResult();
+    o_result.backend = name;
+    auto cpu = dynamic_cast<const UVDARLedDetectFASTCPU*>(&detector);
+    std::vector<double> band_sums;
+    for (int k = 0; k < count; k++) {
+      source.next(image); // not measured - the synthetic frames are rendered here
+      auto start = std::chrono::steady_clock::now();
+      if (!detector.processImage(image, detected_points, sun_points, mask_id)) {
+        std::cerr << "[UVDARDetectorBenchmark]: The " << name << " backend failed to process the image " << k << "!" << std::endl;
+        return false;
+      }
+      latencies.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+      if (cpu != nullptr) {
+        const std::vector<double>& timings = cpu->getBandTimings();
+        band_sums.resize(std::max(band_sums.size(), timings.size()), 0.0);
+        for (size_t b = 0; b < timings.size(); b++) {
+          band_sums[b] += timings[b];
+        }
+      }
+      if (k < detector.getResultDelay()) { // the pipeline is still filling up
+        continue;
+      }
+      retrieved++;
+      points += (long)(detected_points.size());
+      sun_point_count += (long)(sun_points.size());
+      candidates += detector.getCandidateCount();
+      if (detector.getOverload().overloaded) {
+        o_result.overloaded++;
+      }
+    }
+
+    double total = 0.0;
+    for (auto latency : latencies) {
+      total += latency;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    o_result.frames          = count;
+    o_result.mean_ms         = (count > 0) ? (total / count) : 0.0;
+    o_result.p50_ms          = percentile(latencies, 50.0);
+    o_result.p90_ms          = percentile(latencies, 90.0);
+    o_result.p99_ms          = percentile(latencies, 99.0);
+    o_result.max_ms          = latencies.empty() ? 0.0 : latencies.back();
+    o_result.fps             = (total > 0.0) ? (1000.0 * count / total) : 0.0;
+    o_result.mean_points     = (retrieved > 0) ? ((double)(points) / retrieved) : 0.0;
+    o_result.mean_sun_points = (retrieved > 0) ? ((double)(sun_point_count) / retrieved) : 0.0;
+    o_result.mean_candidates = (retrieved > 0) ? ((double)(candidates) / retrieved) : 0.0;
+    double band_total = 0.0, band_slowest = 0.0;
+    for (auto sum : band_sums) {
+      o_result.band_ms.push_back(sum / count);
+      band_total += o_result.band_ms.back();
+      band_slowest = std::max(band_slowest, o_result.band_ms.back());
+    }
+    o_result.band_imbalance = (band_total > 0.0) ? (band_slowest * band_sums.size() / band_total) : 0.0;
+    return true;
+  }
+  //}
+
+  /* writeReport //{ */
+  /**
+   * @brief Joins the mean band times with the separator
+   */
+  std::string joinBands(const std::vector<double>& band_ms, const std::string& separator) {
+    std::ostringstream joined;
+    for (size_t b = 0; b < band_ms.size(); b++) {
+      joined << ((b > 0) ? separator : "") << band_ms[b];
+    }
+    return joined.str();
+  }
+
+  void writeCsv(std::ostream& out, const std::vector<BenchmarkResult>& results) {
+    benchmark::CsvWriter csv(out, {"backend", "frames", "mean_ms", "p50_ms", "p90_ms", "p99_ms", "max_ms", "fps", "mean_points", "mean_sun_points", "mean_candidates", "overloaded", "band_ms", "band_imbalance"});
+    for (auto& r : results) {
+      csv.row(r.backend, r.frames, r.mean_ms, r.p50_ms, r.p90_ms, r.p99_ms, r.max_ms, r.fps, r.mean_points, r.mean_sun_points, r.mean_candidates, r.overloaded, joinBands(r.band_ms, ";"), r.band_imbalance);
+    }
+  }
+
+  void writeJson(std::ostream& out, const std::vector<BenchmarkResult>& results, const std::string& source) {
+    std::string escaped;
+    for (char c : source) {
+      if ((c == '"') || (c == '\\')) {
+        escaped += '\\';
+      }
+      escaped += c;
+    }
+    out << "{" << std::endl;
+    out << "  \"source\": \"" << escaped << "\"," << std::endl;
+    out << "  \"results\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+      auto& r = results[i];
+      out << ((i > 0) ? "," : "") << std::endl;
+      out << "    {\"backend\": \"" << r.backend << "\", \"frames\": " << r.frames
+          << ", \"mean_ms\": " << r.mean_ms << ", \"p50_ms\": " << r.p50_ms << ", \"p90_ms\": " << r.p90_ms << ", \"p99_ms\": " << r.p99_ms << ", \"max_ms\": " << r.max_ms
+          << ", \"fps\": " << r.fps << ", \"mean_points\": " << r.mean_points << ", \"mean_sun_points\": " << r.mean_sun_points << ", \"mean_candidates\": " << r.mean_candidates << ", \"overloaded\": " << r.overloaded
+          << ", \"band_ms\": [" << joinBands(r.band_ms, ", ") << "], \"band_imbalance\": " << r.band_imbalance << "}";
+    }
+    out << std::endl << "  ]" << std::endl << "}" << std::endl;
+  }
+  //}
+
+  /* parseOptions //{ */
+  bool parseOptions(int argc, char** argv, BenchmarkOptions& o_options) {
+    benchmark::CommandLine command_line("UVDARDetectorBenchmark",
+        "Usage: uvdar_detector_benchmark [options]\n"
+        "  --images PATH             directory of PNG images, or a glob pattern - synthetic frames are used if not given\n"
+        "  --passes N                times the recorded images are processed (1)\n"
+        "  --frames N                number of synthetic frames (300)\n"
+        "  --width W, --height H     size of the synthetic frames (752x480)\n"
+        "  --markers N               blinking markers in the synthetic frames (10)\n"
+        "  --suns N                  sun discs in the synthetic frames (0)\n"
+        "  --noise SIGMA             background noise of the synthetic frames (6)\n"
+        "  --seed N                  seed of the synthetic frames (0)\n"
+        "  --warmup N                images processed before the measurement (10)\n"
+        "  --backends LIST           comma separated backends out of cpu, gpu, blob (all)\n"
+        "  --threshold T             detection threshold (200)\n"
+        "  --threshold_diff T        threshold difference (100)\n"
+        "  --cpu_threads N           threads of the CPU backend (1)\n"
+        "  --max_points N            point limit per image, 0 for none (" + std::to_string(MAX_POINTS_PER_IMAGE) + ")\n"
+        "  --sun_cache_period N      images a cached sun may be reused for, 0 to disable (0)\n"
+        "  --gpu_platform P          gbm, device, surfaceless or auto (gbm)\n"
+        "  --gpu_device_path PATH    DRM device of the GPU\n"
+        "  --gpu_pipeline_depth N    images processed at once by the GPU backend (1)\n"
+        "  --mask FILE               mask image\n"
+        "  --format F                csv or json (csv)\n"
+        "  --output FILE             report file (standard output)\n");
+    if (!command_line.parse(argc, argv)) {
+      return false;
+    }
+
+    command_line.take("images", o_options.images);
+    command_line.take("passes", o_options.passes);
+    command_line.take("frames", o_options.frames);
+    command_line.take("width", o_options.width);
+    command_line.take("height", o_options.height);
+    command_line.take("markers", o_options.markers);
+    command_line.take("suns", o_options.suns);
+    command_line.take("noise", o_options.noise);
+    command_line.take("seed", o_options.seed);
+    command_line.take("warmup", o_options.warmup);
+    command_line.takeList("backends", o_options.backends);
+    command_line.take("threshold", o_options.threshold);
+    command_line.take("threshold_diff", o_options.threshold_diff);
+    command_line.take("cpu_threads", o_options.cpu_threads);
+    command_line.take("max_points", o_options.max_points);
+    command_line.take("sun_cache_period", o_options.sun_cache_period);
+    command_line.take("gpu_platform", o_options.gpu_platform);
+    command_line.take("gpu_device_path", o_options.gpu_device_path);
+    command_line.take("gpu_pipeline_depth", o_options.gpu_pipeline_depth);
+    command_line.take("mask", o_options.mask);
+    command_line.take("format", o_options.format);
+    command_line.take("output", o_options.output);
+    if (!command_line.finish()) {
+      return false;
+    }
+
+    if ((o_options.format != "csv") && (o_options.format != "json")) {
+      return command_line.fail("Unknown format \"" + o_options.format + "\"! Use \"csv\" or \"json\".");
+    }
+    if ((o_options.width < 16) || (o_options.height < 16) || (o_options.frames < 1) || (o_options.passes < 1) || (o_options.warmup < 1)) {
+      return command_line.fail("The frame size must be at least 16x16, and the numbers of frames, passes and warm-up images at least 1!");
+    }
+    return true;
+  }
+  //}
+}
+
+int main(int argc, char** argv) {
+  uvdar::BenchmarkOptions options;
+  if (!uvdar::parseOptions(argc, argv, options)) {
+    return 1;
+  }
+
+  uvdar::FrameSource source(options);
+  if (!source.load()) {
+    return 1;
+  }
+
+  std::vector<cv::Mat> masks;
+  int mask_id = -1;
+  if (!options.mask.empty()) {
+    cv::Mat mask = cv::imread(options.mask, cv::IMREAD_GRAYSCALE);
+    if (mask.empty() || (mask.size() != source.size())) {
+      std::cerr << "[UVDARDetectorBenchmark]: The mask " << options.mask << " could not be loaded, or it does not match the size of the images!" << std::endl;
+      return 1;
+    }
+    masks.push_back(mask);
+    mask_id = 0;
+  }
+
+  std::cerr << "[UVDARDetectorBenchmark]: Images: " << source.describe() << std::endl;
+  std::vector<uvdar::BenchmarkResult> results;
+  for (auto& name : options.backends) {
+    std::string error;
+    auto detector = uvdar::makeBackend(name, options, masks, error);
+    if (!detector) {
+      std::cerr << "[UVDARDetectorBenchmark]: Skipping the " << name << " backend: " << error << std::endl;
+      continue;
+    }
+    uvdar::BenchmarkResult result;
+    if (uvdar::runBackend(*detector, name, source, options, mask_id, result)) {
+      results.push_back(result);
+    }
+  }
+
+  std::ofstream file;
+  if (!options.output.empty()) {
+    file.open(options.output);
+    if (!file) {
+      std::cerr << "[UVDARDetectorBenchmark]: Failed to open " << options.output << " for writing!" << std::endl;
+      return 1;
+    }
+  }
+  std::ostream& out = options.output.empty() ? std::cout : file;
+  if (options.format == "json") {
+    uvdar::writeJson(out, results, source.describe());
+  } else {
+    uvdar::writeCsv(out, results);
+  }
+
+  return results.empty() ? 1 : 0;
+}
@@ -0,0 +1,122 @@
+#include <opencv2/core/core.hpp>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "benchmark/command_line.h"
+#include "detect/marker_clusters.h"
+#include "detect/synthetic_frames.h"
+
+/*
+ * Standalone (ROS-free) benchmark of the merging of the raw marker points of the GPU FAST detector (MarkerClusters).
+ * Generates frames with the given numbers of raw points as the GPU finds them, merges them and reports the mean time per frame as CSV. The results are compared with the former merge by the test_detect_marker_clusters test.
+ *
+ * Example:
+ *   uvdar_marker_merge_benchmark --hits 300,4096,20000 --frames 200
+ */
+
+namespace uvdar {
+
+  /**
+   * @brief The settings of the benchmark, as given on the command line
+   */
+  struct BenchmarkOptions {
+    std::vector<int> hits = {300, 4096, 20000}; ///< the numbers of raw points per frame, each measured separately
+    int frames = 200;
+    int width = 752;
+    int height = 480;
+    int distance = 5;                           ///< the merging distance, as used by the detector
+    unsigned int seed = 0;
+  };
+
+  /**
+   * @brief The measured performance for a single number of raw points
+   */
+  struct BenchmarkResult {
+    int hits = 0;
+    int frames = 0;
+    double mean_clusters = 0.0;
+    double merge_us = 0.0; ///< the mean time per frame of the merge
+  };
+
+  /* runBenchmark //{ */
+  BenchmarkResult runBenchmark(int hit_count, const BenchmarkOptions& options) {
+    std::mt19937 rng(options.seed + hit_count);
+    BenchmarkResult result;
+    result.hits = hit_count;
+    result.frames = options.frames;
+
+    MarkerClusters clusters;
+    cv::Size image_size(options.width, options.height);
+    std::vector<fast_det_pt_t> hits;
+    std::vector<cv::Point2i> points;
+    double merge_total = 0.0;
+    for (int f = 0; f < options.frames; f++) {
+      synthetic::markerHits(hit_count, image_size, options.distance, rng, hits);
+
+      points.clear();
+      auto merge_start = std::chrono::steady_clock::now();
+      clusters.findCentroids(hits.data(), (uint32_t)(hits.size()), options.distance, image_size, points);
+      merge_total += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - merge_start).count();
+      result.mean_clusters += points.size();
+    }
+
+    result.mean_clusters /= options.frames;
+    result.merge_us = merge_total/options.frames;
+    return result;
+  }
+  //}
+
+  /* parseOptions //{ */
+  bool parseOptions(int argc, char** argv, BenchmarkOptions& o_options) {
+    benchmark::CommandLine command_line("UVDARMarkerMergeBenchmark",
+        "Usage: uvdar_marker_merge_benchmark [options]\n"
+        "  --hits LIST               comma separated numbers of raw points per frame (300,4096,20000)\n"
+        "  --frames N                number of frames per number of points (200)\n"
+        "  --width W, --height H     size of the image (752x480)\n"
+        "  --distance N              merging distance in pixels (5)\n"
+        "  --seed N                  seed of the point positions (0)\n");
+    if (!command_line.parse(argc, argv)) {
+      return false;
+    }
+
+    command_line.takeList("hits", o_options.hits);
+    command_line.take("frames", o_options.frames);
+    command_line.take("width", o_options.width);
+    command_line.take("height", o_options.height);
+    command_line.take("distance", o_options.distance);
+    command_line.take("seed", o_options.seed);
+    if (!command_line.finish()) {
+      return false;
+    }
+
+    if ((o_options.width <= 0) || (o_options.height <= 0) || (o_options.width > 65535) || (o_options.height > 65535) || (o_options.frames < 1) || (o_options.distance < 1)) {
+      return command_line.fail("Invalid size of the image, number of frames or merging distance!");
+    }
+    for (auto count : o_options.hits) {
+      if (count < 0) {
+        return command_line.fail("The numbers of points can not be negative!");
+      }
+    }
+    return true;
+  }
+  //}
+
+}
+
+int main(int argc, char** argv) {
+  uvdar::BenchmarkOptions options;
+  if (!uvdar::parseOptions(argc, argv, options)) {
+    return 1;
+  }
+
+  uvdar::benchmark::CsvWriter csv(std::cout, {"hits", "frames", "mean_clusters", "merge_us"});
+  for (auto count : options.hits) {
+    uvdar::BenchmarkResult result = uvdar::runBenchmark(count, options);
+    csv.row(result.hits, result.frames, result.mean_clusters, result.merge_us);
+  }
+
+  return 0;
+}
@@ -0,0 +1,214 @@
+#include <opencv2/core/core.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "benchmark/command_line.h"
+#include "omta/sequence_grid.h"
+
+/*
+ * Standalone (ROS-free) benchmark of the association of new points with the tracked sequences in the OMTA.
+ * Compares the grid index used by the OMTA with the former linear search over all sequences on synthetic frames of moving, blinking points, checks that both produce identical associations, and reports the mean time per frame as CSV.
+ *
+ * Example:
+ *   uvdar_omta_benchmark --sequences 50,100,200,500 --frames 500 --max_px_shift 2
+ */
+
+namespace uvdar {
+
+  /**
+   * @brief The settings of the benchmark, as given on the command line
+   */
+  struct BenchmarkOptions {
+    std::vector<int> sequences = {50, 100, 200, 500}; ///< the numbers of concurrent sequences, each measured separately
+    int frames = 300;
+    int width = 752;
+    int height = 480;
+    int max_px_shift = 2;
+    double clutter = 0.1;          ///< the number of points not belonging to any sequence, relative to the number of sequences
+    unsigned int seed = 0;
+  };
+
+  /**
+   * @brief The measured performance for a single number of sequences
+   */
+  struct BenchmarkResult {
+    int sequences = 0;
+    int frames = 0;
+    double mean_points = 0.0;      ///< the mean number of points per frame
+    double mean_matched = 0.0;     ///< the mean number of points associated with a sequence per frame
+    double linear_us = 0.0;        ///< the mean time per frame of the linear search
+    double grid_us = 0.0;          ///< the mean time per frame of the grid, including its construction
+    int mismatches = 0;            ///< the number of frames where the associations differ
+  };
+
+  /* linearMatch //{ */
+  /**
+   * @brief The association as done by the OMTA before the grid index - each point is compared with the last points of all sequences not matched yet
+   */
+  std::vector<int> linearMatch(const std::vector<cv::Point2d>& positions, const std::vector<cv::Point2d>& points, const cv::Point2d& max_px_shift) {
+    std::vector<int> unmatched(positions.size());
+    for (int i = 0; i < (int)positions.size(); i++) {
+      unmatched[i] = i;
+    }
+
+    std::vector<int> result;
+    result.reserve(points.size());
+    for (auto& point : points) {
+      int match = -1;
+      for (auto seq = unmatched.begin(); seq != unmatched.end(); ++seq) {
+        cv::Point2d bb_left_top = positions[*seq] - max_px_shift;
+        cv::Point2d bb_right_bottom = positions[*seq] + max_px_shift;
+        if (bb_left_top.x <= point.x && point.x <= bb_right_bottom.x && bb_left_top.y <= point.y && point.y <= bb_right_bottom.y) {
+          match = *seq;
+          unmatched.erase(seq);
+          break;
+        }
+      }
+      result.push_back(match);
+    }
+    return result;
+  }
+  //}
+
+  /* runBenchmark //{ */
+  /**
+   * @brief Moves the given number of blinking points over the image, and associates the points of each frame with the positions of the previous frame by both methods
+   */
+  BenchmarkResult runBenchmark(int sequence_count, const BenchmarkOptions& options) {
+    std::mt19937 rng(options.seed + sequence_count);
+    std::uniform_real_distribution<double> x_dist(0.0, options.width - 1);
+    std::uniform_real_distribution<double> y_dist(0.0, options.height - 1);
+    std::uniform_int_distribution<int> velocity_dist(-1, 1);
+    std::uniform_int_distribution<int> shift_dist(-options.max_px_shift, options.max_px_shift);
+    std::bernoulli_distribution blink_dist(0.5);
+
+    std::vector<cv::Point2d> positions(sequence_count);
+    std::vector<cv::Point> velocities(sequence_count);
+    for (int i = 0; i < sequence_count; i++) {
+      positions[i] = cv::Point2d((int)x_dist(rng), (int)y_dist(rng));
+      velocities[i] = cv::Point(velocity_dist(rng), velocity_dist(rng));
+    }
+    int clutter_count = (int)(options.clutter*sequence_count + 0.5);
+    cv::Point2d max_px_shift(options.max_px_shift, options.max_px_shift);
+
+    BenchmarkResult result;
+    result.sequences = sequence_count;
+    result.frames = options.frames;
+    SequenceGrid grid;
+    std::vector<cv::Point2d> points;
+    std::vector<int> grid_result;
+    double linear_total = 0.0, grid_total = 0.0;
+    for (int f = 0; f < options.frames; f++) {
+      points.clear();
+      for (int i = 0; i < sequence_count; i++) {
+        if (blink_dist(rng)) {
+          cv::Point2d moved = positions[i] + cv::Point2d(velocities[i]) + cv::Point2d(shift_dist(rng), shift_dist(rng));
+          moved.x = std::clamp(moved.x, 0.0, options.width - 1.0);
+          moved.y = std::clamp(moved.y, 0.0, options.height - 1.0);
+          points.push_back(moved);
+        }
+      }
+      for (int i = 0; i < clutter_count; i++) {
+        points.push_back(cv::Point2d((int)x_dist(rng), (int)y_dist(rng)));
+      }
+      std::shuffle(points.begin(), points.end(), rng);
+
+      auto linear_start = std::chrono::steady_clock::now();
+      std::vector<int> linear_result = linearMatch(positions, points, max_px_shift);
+      auto grid_start = std::chrono::steady_clock::now();
+      grid.build(positions, max_px_shift);
+      grid_result.clear();
+      for (auto& point : points) {
+        grid_result.push_back(grid.matchPoint(point));
+      }
+      auto grid_end = std::chrono::steady_clock::now();
+      linear_total += std::chrono::duration<double, std::micro>(grid_start - linear_start).count();
+      grid_total += std::chrono::duration<double, std::micro>(grid_end - grid_start).count();
+
+      if (grid_result != linear_result) {
+        result.mismatches++;
+      }
+      result.mean_points += points.size();
+
+      // the matched sequences continue from their new points, the others stay in place as in the OMTA
+      for (int p = 0; p < (int)points.size(); p++) {
+        if (linear_result[p] >= 0) {
+          positions[linear_result[p]] = points[p];
+          result.mean_matched++;
+        }
+      }
+    }
+
+    if (options.frames > 0) {
+      result.mean_points /= options.frames;
+      result.mean_matched /= options.frames;
+      result.linear_us = linear_total/options.frames;
+      result.grid_us = grid_total/options.frames;
+    }
+    return result;
+  }
+  //}
+
+  /* parseOptions //{ */
+  bool parseOptions(int argc, char** argv, BenchmarkOptions& o_options) {
+    benchmark::CommandLine command_line("UVDAROMTABenchmark",
+        "Usage: uvdar_omta_benchmark [options]\n"
+        "  --sequences LIST          comma separated numbers of concurrent sequences (50,100,200,500)\n"
+        "  --frames N                number of frames per measurement (300)\n"
+        "  --width W, --height H     size of the image (752x480)\n"
+        "  --max_px_shift N          allowed shift of a point between frames (2)\n"
+        "  --clutter R               points outside of the sequences, relative to their number (0.1)\n"
+        "  --seed N                  seed of the synthetic frames (0)\n");
+    if (!command_line.parse(argc, argv)) {
+      return false;
+    }
+
+    command_line.takeList("sequences", o_options.sequences);
+    command_line.take("frames", o_options.frames);
+    command_line.take("width", o_options.width);
+    command_line.take("height", o_options.height);
+    command_line.take("max_px_shift", o_options.max_px_shift);
+    command_line.take("clutter", o_options.clutter);
+    command_line.take("seed", o_options.seed);
+    if (!command_line.finish()) {
+      return false;
+    }
+
+    if ((o_options.width <= 0) || (o_options.height <= 0) || (o_options.max_px_shift < 0) || (o_options.frames < 1)) {
+      return command_line.fail("Invalid size of the image, shift or number of frames!");
+    }
+    for (auto count : o_options.sequences) {
+      if (count < 1) {
+        return command_line.fail("The numbers of sequences have to be positive!");
+      }
+    }
+    return true;
+  }
+  //}
+
+}
+
+int main(int argc, char** argv) {
+  uvdar::BenchmarkOptions options;
+  if (!uvdar::parseOptions(argc, argv, options)) {
+    return 1;
+  }
+
+  bool identical = true;
+  uvdar::benchmark::CsvWriter csv(std::cout, {"sequences", "frames", "mean_points", "mean_matched", "linear_us", "grid_us", "speedup", "mismatches"});
+  for (auto count : options.sequences) {
+    uvdar::BenchmarkResult result = uvdar::runBenchmark(count, options);
+    csv.row(result.sequences, result.frames, result.mean_points, result.mean_matched, result.linear_us, result.grid_us, (result.grid_us > 0.0 ? result.linear_us/result.grid_us : 0.0), result.mismatches);
+    if (result.mismatches > 0) {
+      std::cerr << "[UVDAROMTABenchmark]: The grid associated the points differently from the linear search in " << result.mismatches << " frames with " << count << " sequences!" << std::endl;
+      identical = false;
+    }
+  }
+
+  return identical ? 0 : 1;
+}
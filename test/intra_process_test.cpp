@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include <ros/ros.h>
+#include <ros/topic_manager.h>
+#include <nodelet/loader.h>
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/image_encodings.h>
+#include <mrs_msgs/ImagePointsWithFloatStamped.h>
+#include <XmlRpcValue.h>
+#include <boost/make_shared.hpp>
+
+/*
+ * Checks that the detector hands the detected points to the subscribers in the same process without serialization (see launch/test_intra_process.launch for the nodelet setup this covers).
+ * The detector is loaded into the process of the test, so the test receives its points the same way as the blink processor in a shared nodelet manager.
+ */
+
+namespace {
+
+  const std::string detector_name = "/uvdar_test/uv_detect";
+  const std::string camera_topic  = detector_name + "/camera_test";
+  const std::string points_topic  = detector_name + "/points_seen_test";
+
+  /**
+   * @brief A dark image with a few bright single-pixel markers
+   */
+  sensor_msgs::ImagePtr makeImage(unsigned int seq) {
+    auto image = boost::make_shared<sensor_msgs::Image>();
+    image->header.seq = seq;
+    image->header.stamp = ros::Time::now();
+    image->width = 752;
+    image->height = 480;
+    image->encoding = sensor_msgs::image_encodings::MONO8;
+    image->step = image->width;
+    image->data.assign(image->width * image->height, 0);
+    for (int k = 0; k < 3; k++) {
+      image->data[((100 + (100 * k)) * image->width) + 200 + (150 * k)] = 255;
+    }
+    return image;
+  }
+
+  /**
+   * @brief Lists the transports of the connections of this process on the given topic, as reported by rosnode info
+   */
+  std::vector<std::string> connectionTransports(const std::string& topic) {
+    XmlRpc::XmlRpcValue info;
+    ros::TopicManager::instance()->getBusInfo(info);
+    std::vector<std::string> transports;
+    for (int i = 0; i < info.size(); i++) { //[connection id, destination, direction, transport, topic, connected, ...]
+      if (std::string(info[i][4]) == topic) {
+        transports.push_back(std::string(info[i][3]));
+      }
+    }
+    return transports;
+  }
+}
+
+TEST(IntraProcess, PointsAreNotSerialized) {
+  ros::NodeHandle nh;
+  nodelet::Loader loader(false);
+  ASSERT_TRUE(loader.load(detector_name, "uvdar/UVDARDetector", nodelet::M_string(), nodelet::V_string()));
+
+  std::vector<mrs_msgs::ImagePointsWithFloatStampedConstPtr> received;
+  boost::function<void(const mrs_msgs::ImagePointsWithFloatStampedConstPtr&)> callback = [&received](const mrs_msgs::ImagePointsWithFloatStampedConstPtr& msg) {
+    received.push_back(msg);
+  };
+  ros::Subscriber sub = nh.subscribe<mrs_msgs::ImagePointsWithFloatStamped>(points_topic, 10, callback);
+  ros::Publisher pub = nh.advertise<sensor_msgs::Image>(camera_topic, 1);
+
+  unsigned int seq = 0;
+  ros::WallTime deadline = ros::WallTime::now() + ros::WallDuration(20.0);
+  while ((received.size() < 5) && (ros::WallTime::now() < deadline)) {
+    pub.publish(makeImage(seq++));
+    ros::WallDuration(0.05).sleep();
+    ros::spinOnce();
+  }
+  ASSERT_GE(received.size(), 5u) << "The detector did not publish the points of the synthetic images";
+
+  //a deserialized message gets the header of the connection it came through - a message passed within the process is the very instance the detector published, which never gets one
+  for (auto& msg : received) {
+    EXPECT_EQ(msg->points.size(), 3u);
+    EXPECT_FALSE(msg->__connection_header) << "The points were serialized and deserialized on the way to the subscriber";
+  }
+
+  std::vector<std::string> transports = connectionTransports(points_topic);
+  ASSERT_FALSE(transports.empty()) << "No connection on " << points_topic;
+  for (auto& transport : transports) {
+    EXPECT_EQ(transport, "INTRAPROCESS") << "A connection on " << points_topic << " uses " << transport;
+  }
+
+  loader.unload(detector_name);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  ros::init(argc, argv, "intra_process_test");
+  ros::NodeHandle nh; //keeps the node alive for the whole test
+  return RUN_ALL_TESTS();
+}
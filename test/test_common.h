@@ -0,0 +1,58 @@
+#ifndef TEST_COMMON_H
+#define TEST_COMMON_H
+
+#include <gtest/gtest.h>
+#include <string>
+
+#include "detect/uv_led_detect_fast_cpu.h"
+
+/*
+ * The settings and the fixture shared by the detector tests
+ */
+
+namespace uvdar {
+  namespace test {
+
+    constexpr int threshold      = 100;
+    constexpr int threshold_diff = 50;
+    constexpr int threshold_sun  = 240;
+
+    using Kernel = UVDARLedDetectFASTCPU::PrescanKernel;
+
+    /**
+     * @brief A test run once for each pre-scan kernel of the CPU detector - skipped for the kernels not available in this build or on this CPU
+     */
+    class KernelTest : public testing::TestWithParam<Kernel> {
+      protected:
+        void SetUp() override {
+          UVDARLedDetectFASTCPU detector(false, false, threshold, threshold_diff, threshold_sun, {});
+          if (detector.setPrescanKernel(GetParam()) != GetParam()) {
+            GTEST_SKIP() << "The kernel is not available in this build or on this CPU";
+          }
+        }
+    };
+
+    /**
+     * @brief All the pre-scan kernels, for instantiating a KernelTest
+     */
+    inline auto allKernels() {
+      return testing::Values(Kernel::SCALAR, Kernel::SSE2, Kernel::AVX2);
+    }
+
+    /**
+     * @brief Names the instances of a KernelTest by their kernels
+     */
+    inline std::string kernelName(const testing::TestParamInfo<Kernel>& info) {
+      switch (info.param) {
+        case Kernel::SSE2:
+          return "SSE2";
+        case Kernel::AVX2:
+          return "AVX2";
+        default:
+          return "Scalar";
+      }
+    }
+  }
+}
+
+#endif  // TEST_COMMON_H
@@ -0,0 +1,181 @@
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "detect/uv_led_detect_fast_cpu.h"
+#include "detect/uv_led_detect_fast_gpu.h"
+#include "detect/synthetic_frames.h"
+#include "test_common.h"
+
+/*
+ * Runs the FAST compute shader of the GPU detector on the surfaceless EGL platform - the Mesa software rasterizer (llvmpipe) without any GPU or display - and compares its points with the CPU detector
+ * Skipped if no EGL implementation providing compute shaders is available
+ */
+
+namespace {
+
+  using uvdar::UVDARLedDetectFASTCPU;
+  using uvdar::UVDARLedDetectFASTGPU;
+
+  using uvdar::test::threshold;
+  using uvdar::test::threshold_diff;
+  using uvdar::test::threshold_sun;
+  const cv::Size image_size(752, 480);
+
+  /**
+   * @brief The non-maxima suppression of the shader handles the right and the bottom image borders differently, so the markers closer to these than the reach of the FAST rings may be retrieved a pixel away from the CPU result
+   */
+  bool nearBorder(const cv::Point2i& point) {
+    int margin = uvdar::fast_point_sets::fast_halo + 1;
+    return (point.x >= (image_size.width - margin)) || (point.y >= (image_size.height - margin));
+  }
+
+  /**
+   * @brief Checks that the two lists contain the same markers - the same positions, or the neighboring ones next to the borders
+   */
+  void expectSameMarkers(const std::vector<cv::Point2i>& cpu_points, const std::vector<cv::Point2i>& gpu_points) {
+    ASSERT_EQ(gpu_points.size(), cpu_points.size());
+    std::vector<bool> used(gpu_points.size(), false);
+    for (auto& point : cpu_points) {
+      int found = -1;
+      for (int k = 0; k < (int)(gpu_points.size()); k++) {
+        if (used[k]) {
+          continue;
+        }
+        cv::Point2i difference = gpu_points[k] - point;
+        bool exact = (difference == cv::Point2i(0, 0));
+        if (exact || (nearBorder(point) && (std::abs(difference.x) <= 1) && (std::abs(difference.y) <= 1))) {
+          found = k;
+          if (exact) {
+            break;
+          }
+        }
+      }
+      EXPECT_GE(found, 0) << "The marker at " << point.x << ", " << point.y << " was not retrieved by the shader";
+      if (found >= 0) {
+        used[found] = true;
+      }
+    }
+  }
+
+  /**
+   * @brief Places markers at least 12 pixels apart, so that the different non-maxima suppressions of the backends can not merge them differently
+   */
+  std::vector<cv::Point> separatedPositions(int count, std::mt19937& rng) {
+    std::vector<cv::Point> positions;
+    while ((int)(positions.size()) < count) {
+      cv::Point candidate((int)(rng() % image_size.width), (int)(rng() % image_size.height));
+      bool free = true;
+      for (auto& position : positions) {
+        free = free && ((std::abs(position.x - candidate.x) >= 12) || (std::abs(position.y - candidate.y) >= 12));
+      }
+      if (free) {
+        positions.push_back(candidate);
+      }
+    }
+    return positions;
+  }
+
+  class GpuLlvmpipeTest : public testing::Test {
+    protected:
+      void SetUp() override {
+        std::string error;
+        if (!UVDARLedDetectFASTGPU::probe(error, COMPUTE_LIB_PLATFORM_SURFACELESS, "")) {
+          GTEST_SKIP() << "EGL with compute shaders is not available: " << error;
+        }
+      }
+
+      std::unique_ptr<UVDARLedDetectFASTGPU> makeGpu(const std::vector<cv::Mat>& masks) {
+        auto gpu = std::make_unique<UVDARLedDetectFASTGPU>(false, false, threshold, threshold_diff, threshold_sun, masks);
+        gpu->setDevice(COMPUTE_LIB_PLATFORM_SURFACELESS, "");
+        return gpu;
+      }
+  };
+}
+
+TEST_F(GpuLlvmpipeTest, MarkersMatchCpu) {
+  std::mt19937 rng(1);
+  auto gpu = makeGpu({});
+  UVDARLedDetectFASTCPU cpu(false, false, threshold, threshold_diff, threshold_sun, {});
+  for (int f = 0; f < 30; f++) {
+    cv::Mat frame = uvdar::synthetic::background(image_size, 10, 20, rng);
+    for (auto& position : separatedPositions(40, rng)) {
+      uvdar::synthetic::drawMarker(frame, position, 120 + (int)(rng() % 136), (int)(rng() % 3));
+    }
+    std::vector<cv::Point2i> cpu_points, cpu_sun, gpu_points, gpu_sun;
+    ASSERT_TRUE(cpu.processImage(frame, cpu_points, cpu_sun));
+    ASSERT_TRUE(gpu->processImage(frame, gpu_points, gpu_sun));
+    SCOPED_TRACE("frame " + std::to_string(f));
+    expectSameMarkers(cpu_points, gpu_points);
+    EXPECT_TRUE(gpu_sun.empty());
+  }
+}
+
+TEST_F(GpuLlvmpipeTest, MaskedMarkersMatchCpu) {
+  std::mt19937 rng(2);
+  std::vector<cv::Mat> masks = {uvdar::synthetic::mask(image_size, 0.0, true, rng)};
+  auto gpu = makeGpu(masks);
+  UVDARLedDetectFASTCPU cpu(false, false, threshold, threshold_diff, threshold_sun, masks);
+  for (int f = 0; f < 10; f++) {
+    cv::Mat frame = uvdar::synthetic::background(image_size, 10, 20, rng);
+    for (auto& position : separatedPositions(40, rng)) {
+      uvdar::synthetic::drawMarker(frame, position, 200, 0);
+    }
+    std::vector<cv::Point2i> cpu_points, cpu_sun, gpu_points, gpu_sun;
+    ASSERT_TRUE(cpu.processImage(frame, cpu_points, cpu_sun, 0));
+    ASSERT_TRUE(gpu->processImage(frame, gpu_points, gpu_sun, 0));
+    SCOPED_TRACE("frame " + std::to_string(f));
+    expectSameMarkers(cpu_points, gpu_points);
+    for (auto& point : gpu_points) {
+      EXPECT_GE(point.x, image_size.width / 3);
+    }
+  }
+}
+
+//the shader reports every pixel of the sun, the CPU detector clusters them - both have to describe the same sun, and the markers away from its glare have to stay the same
+TEST_F(GpuLlvmpipeTest, SunMatchesCpu) {
+  std::mt19937 rng(3);
+  auto gpu = makeGpu({});
+  UVDARLedDetectFASTCPU cpu(false, false, threshold, threshold_diff, threshold_sun, {});
+  int reach = 42; //a sun pixel joins a cluster within 20 pixels of its centroid, which then keeps moving as further pixels join
+  for (int f = 0; f < 10; f++) {
+    cv::Mat frame = uvdar::synthetic::background(image_size, 10, 20, rng);
+    cv::Point sun_center(100 + (int)(rng() % 550), 100 + (int)(rng() % 280));
+    uvdar::synthetic::drawSun(frame, sun_center, 10 + (int)(rng() % 30));
+    for (auto& position : separatedPositions(40, rng)) {
+      if (cv::norm(position - sun_center) > 120) { //outside of the glare, for which the backends test different sun points
+        uvdar::synthetic::drawMarker(frame, position, 200, (int)(rng() % 2));
+      }
+    }
+    std::vector<cv::Point2i> cpu_points, cpu_sun, gpu_points, gpu_sun;
+    ASSERT_TRUE(cpu.processImage(frame, cpu_points, cpu_sun));
+    ASSERT_TRUE(gpu->processImage(frame, gpu_points, gpu_sun));
+    SCOPED_TRACE("frame " + std::to_string(f));
+    ASSERT_FALSE(cpu_sun.empty());
+    ASSERT_FALSE(gpu_sun.empty());
+    for (auto& pixel : gpu_sun) {
+      double nearest = 1e9;
+      for (auto& point : cpu_sun) {
+        nearest = std::min(nearest, cv::norm(pixel - point));
+      }
+      EXPECT_LT(nearest, reach) << "The sun pixel " << pixel.x << ", " << pixel.y << " is far from the sun found by the CPU";
+    }
+    for (auto& point : cpu_sun) {
+      double nearest = 1e9;
+      for (auto& pixel : gpu_sun) {
+        nearest = std::min(nearest, cv::norm(pixel - point));
+      }
+      EXPECT_LT(nearest, reach) << "The sun point " << point.x << ", " << point.y << " is far from the sun found by the shader";
+    }
+    expectSameMarkers(cpu_points, gpu_points);
+  }
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  setenv("LIBGL_ALWAYS_SOFTWARE", "1", 0); //llvmpipe even on machines with a GPU, unless requested otherwise
+  return RUN_ALL_TESTS();
+}
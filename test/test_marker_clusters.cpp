@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "detect/marker_clusters.h"
+#include "detect/synthetic_frames.h"
+
+/*
+ * Checks that the grid merge of the raw marker points of the GPU detector (MarkerClusters) retrieves the same points in the same order as the former merge, which sorted the points by qsort and compared every point with every cluster
+ */
+
+namespace {
+
+  using uvdar::MarkerClusters;
+
+  const cv::Size image_size(752, 480);
+
+  struct FormerCluster {
+    int32_t x;
+    int32_t y;
+    int32_t z; ///< the number of the points
+  };
+
+  extern "C" int compare_fast_det_pt_xy1d(const void* a, const void* b) {
+    fast_det_pt_t* pt1 = (fast_det_pt_t*) a;
+    fast_det_pt_t* pt2 = (fast_det_pt_t*) b;
+    int res = pt1->y - pt2->y;
+    if (res == 0) res = pt1->x - pt2->x;
+    return res;
+  }
+
+  /**
+   * @brief The merge formerly used by the GPU detector, kept as the reference
+   */
+  uint32_t formerFindCentroids(fast_det_pt_t* markers, uint32_t init_cnt, uint32_t distance_px, std::vector<cv::Point2i>& detected_points) {
+    std::vector<FormerCluster> filtered_markers(init_cnt);
+    uint32_t filtered_cnt = 0;
+    uint32_t max_dist2 = (distance_px * distance_px);
+    uint32_t min_dist2, dist2;
+    int32_t closest_marker;
+    uint32_t i, j;
+    int32_t x2, y2, n;
+    fast_det_pt_t pt;
+
+    qsort(markers, init_cnt, sizeof(fast_det_pt_t), compare_fast_det_pt_xy1d);
+
+    for (i = 0; i < init_cnt; i++) {
+      pt = markers[i];
+
+      min_dist2 = max_dist2;
+      closest_marker = -1;
+
+      for (j = 0; j < filtered_cnt; j++) {
+        n = filtered_markers[j].z;
+        x2 = filtered_markers[j].x / n;
+        y2 = filtered_markers[j].y / n;
+        dist2 = (x2 - pt.x)*(x2 - pt.x) + (y2 - pt.y)*(y2 - pt.y);
+        if (dist2 < min_dist2) {
+          min_dist2 = dist2;
+          closest_marker = j;
+        }
+      }
+
+      if (closest_marker != -1) {
+        filtered_markers[closest_marker].x += pt.x;
+        filtered_markers[closest_marker].y += pt.y;
+        filtered_markers[closest_marker].z += 1;
+      } else {
+        filtered_markers[filtered_cnt].x = pt.x;
+        filtered_markers[filtered_cnt].y = pt.y;
+        filtered_markers[filtered_cnt].z = 1;
+        filtered_cnt++;
+      }
+    }
+
+    for (i = 0; i < filtered_cnt; i++) {
+      detected_points.push_back(cv::Point(filtered_markers[i].x / filtered_markers[i].z, filtered_markers[i].y / filtered_markers[i].z));
+    }
+    return filtered_cnt;
+  }
+
+  /**
+   * @brief Merges the points by both merges and compares the results
+   */
+  void expectSameAsFormer(MarkerClusters& clusters, const std::vector<fast_det_pt_t>& hits, uint32_t distance, const std::string& description) {
+    std::vector<fast_det_pt_t> former_hits = hits; //the former merge sorts the points in place
+    std::vector<cv::Point2i> former_points, grid_points;
+    uint32_t former_count = formerFindCentroids(former_hits.data(), (uint32_t)(former_hits.size()), distance, former_points);
+    uint32_t grid_count = clusters.findCentroids(hits.data(), (uint32_t)(hits.size()), distance, image_size, grid_points);
+    EXPECT_EQ(grid_count, former_count) << description;
+    EXPECT_EQ(grid_points, former_points) << description;
+  }
+
+  class MarkerClustersTest : public testing::TestWithParam<int> {};
+}
+
+//random frames of raw points, merged repeatedly by the same instance as in the detector, so that the reused buffers are covered as well
+TEST_P(MarkerClustersTest, SameAsFormerMerge) {
+  int hit_count = GetParam();
+  int frames = (hit_count > 4096) ? 3 : 20; //the former merge compares every point with every cluster, so the largest frames take long
+  MarkerClusters clusters;
+  std::vector<fast_det_pt_t> hits;
+  for (int distance : {1, 5, 8}) {
+    std::mt19937 rng(hit_count + distance);
+    for (int f = 0; f < frames; f++) {
+      uvdar::synthetic::markerHits(hit_count, image_size, distance, rng, hits);
+      expectSameAsFormer(clusters, hits, distance, "distance " + std::to_string(distance) + ", frame " + std::to_string(f));
+    }
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(Hits, MarkerClustersTest, testing::Values(0, 1, 300, 4096, 20000), [](const testing::TestParamInfo<int>& info) {
+  return "Hits" + std::to_string(info.param);
+});
+
+//points in the corners of the image, where the grid cells are cut by the image borders
+TEST(MarkerClusters, Corners) {
+  MarkerClusters clusters;
+  std::vector<fast_det_pt_t> hits;
+  for (int x : {0, 1, image_size.width - 2, image_size.width - 1}) {
+    for (int y : {0, 1, image_size.height - 2, image_size.height - 1}) {
+      hits.push_back({(uint16_t)(y), (uint16_t)(x)});
+    }
+  }
+  expectSameAsFormer(clusters, hits, 5, "corners");
+}
+
+//points at the same distance from two clusters join the older one
+TEST(MarkerClusters, Ties) {
+  MarkerClusters clusters;
+  std::vector<fast_det_pt_t> hits = {{100, 100}, {100, 108}, {100, 104}, {104, 104}, {96, 104}};
+  expectSameAsFormer(clusters, hits, 5, "ties");
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,250 @@
+#include <gtest/gtest.h>
+#include <Eigen/Dense>
+#include <cmath>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "omta/omta.h"
+
+/*
+ * Checks the prediction and the confidence interval of the OMTA (OMTA::selectStatisticsValues), computed from the incrementally updated sums of the sequences, against the former computation, which fitted the "on"-points of a sequence from scratch in every frame (polyReg, calcNormalizedWeightVect and calcWSSR).
+ * The former computation is kept here as the reference together with its quirks, which the current one reproduces on purpose - the integer division 1 / n, the time term of the standard error not being squared, and the predicted coordinate starting at -1 before the polynomial is added
+ */
+
+namespace uvdar {
+
+  /**
+   * @brief Fixture over the orders of the regression, with access to the statistics of the OMTA
+   */
+  class OMTAStatisticsTest : public testing::TestWithParam<int> {
+    protected:
+      void selectStatisticsValues(OMTA& omta, const Sequence& sequence, int axis, double insert_time, int max_pix_shift, PredictionStatistics& o_statistics) {
+        omta.selectStatisticsValues(sequence, axis, insert_time, max_pix_shift, o_statistics);
+      }
+  };
+
+}
+
+namespace {
+
+  using uvdar::OMTAStatisticsTest;
+  using uvdar::PredictionStatistics;
+
+  constexpr double frame_period = 1.0 / 60.0;
+  constexpr double start_time = 1.0; //the former regression used the powers of the time itself, which lose all precision with epoch time stamps - close to zero, its results are exact enough to be compared
+  constexpr double decay_factor = 0.1;
+  constexpr int conf_probab_percent = 75;
+  constexpr int max_pix_shift = 2;
+
+  /* the former computation //{ */
+  std::vector<double> formerNormalizedWeightVect(const std::vector<double>& time) {
+    std::vector<double> weights;
+    double sum_weights = 0.0;
+    double reference_time = time.end()[-1];
+    for (int i = 0; i < (int)time.size(); ++i) {
+      double weight = exp(-decay_factor * (reference_time - time[i]));
+      sum_weights += weight;
+      weights.push_back(weight);
+    }
+    for (auto& weight : weights) {
+      weight /= sum_weights;
+    }
+    return weights;
+  }
+
+  double formerWeightedMean(const std::vector<double>& values, const std::vector<double>& weights) {
+    double weighted_sum = 0.0;
+    for (int i = 0; i < (int)values.size(); i++) {
+      weighted_sum += (values[i] * weights[i]);
+    }
+    return weighted_sum;
+  }
+
+  double formerWSTD(const std::vector<double>& values, const std::vector<double>& weights, const double& mean) {
+    double ss = 0.0;
+    int n = (int)values.size();
+    for (int i = 0; i < n; ++i) {
+      ss += (weights[i] * pow(values[i] - mean, 2));
+    }
+    if (n == 1)
+      return -1.0;
+    return sqrt(ss / (n - 1));
+  }
+
+  std::tuple<std::vector<double>, Eigen::VectorXd> formerPolyReg(const std::vector<double>& coordinate, const std::vector<double>& time, const std::vector<double>& weights, const int& poly_order) {
+    Eigen::MatrixXd design_mat(time.size(), poly_order + 1);
+    Eigen::VectorXd pixel_vect = Eigen::VectorXd::Map(&coordinate.front(), coordinate.size());
+    Eigen::VectorXd weight_vect = Eigen::VectorXd::Map(&weights.front(), weights.size());
+    Eigen::MatrixXd weight_mat = weight_vect.asDiagonal();
+
+    for (int i = 0; i < (int)time.size(); ++i) {
+      for (int j = 0; j < poly_order + 1; ++j) {
+        design_mat(i, j) = (j == 0) ? 1 : pow(time[i], j);
+      }
+    }
+
+    Eigen::VectorXd result = (weight_mat * design_mat).householderQr().solve(weight_mat * pixel_vect);
+    std::vector<double> coeff(result.data(), result.data() + result.size());
+    Eigen::VectorXd prediction = design_mat * result;
+    return {coeff, prediction};
+  }
+
+  double formerWSSR(const Eigen::VectorXd& predictions, const std::vector<double>& values, const std::vector<double>& weights) {
+    double sum_squared_residuals = 0;
+    for (int i = 0; i < (int)values.size(); i++) {
+      sum_squared_residuals += (weights[i] * pow((predictions(i) - values[i]), 2));
+    }
+    return sum_squared_residuals;
+  }
+
+  double formerConfidenceInterval(const PredictionStatistics& prediction_vals, const Eigen::VectorXd& predicted_vals_past, const std::vector<double>& time, const std::vector<double>& values, const std::vector<double>& weights) {
+    double w_ssr = formerWSSR(predicted_vals_past, values, weights);
+
+    const int n = (int)values.size();
+    const int dof = n - (int)prediction_vals.coeff.size();
+    if (prediction_vals.mean_independent == -1.0 || prediction_vals.mean_dependent == -1.0 || dof <= 0) {
+      return -1;
+    }
+
+    double unb_estimate_error_var = w_ssr / dof;
+    double var_time = 0.0;
+    for (auto t : time) {
+      var_time += pow((t - prediction_vals.mean_independent), 2);
+    }
+
+    double standard_error = sqrt(unb_estimate_error_var + (1 + 1 / n + ((prediction_vals.time_pred - prediction_vals.mean_independent) / var_time)));
+
+    double percentage_scaled = (100.0 - double(conf_probab_percent)) / 100.0;
+    boost::math::students_t dist(dof);
+    double t = quantile(complement(dist, percentage_scaled / 2.0));
+    return t * standard_error;
+  }
+
+  /**
+   * @brief The former OMTA::selectStatisticsValues, on the coordinates and times of the "on"-points of a sequence
+   */
+  PredictionStatistics formerSelectStatisticsValues(const std::vector<double>& values, const std::vector<double>& time, const double& insert_time, int poly_order) {
+    auto weight_vect = formerNormalizedWeightVect(time);
+
+    PredictionStatistics statistics;
+    statistics.mean_dependent = formerWeightedMean(values, weight_vect);
+    statistics.mean_independent = formerWeightedMean(time, weight_vect);
+    statistics.time_pred = insert_time;
+    statistics.poly_reg_computed = false;
+
+    auto std = formerWSTD(values, weight_vect, statistics.mean_dependent);
+
+    bool conf_interval_bool = false;
+
+    if ((int)values.size() < poly_order && values.size() > 0) {
+      poly_order = values.size();
+    }
+
+    if ((int)values.size() > 1) {
+      auto [coeff, predicted_vals_past] = formerPolyReg(values, time, weight_vect, poly_order);
+      statistics.coeff = coeff;
+
+      bool all_coeff_zero = std::all_of(coeff.begin(), coeff.end(), [](double coeff){return coeff == 0.0;});
+      if (!all_coeff_zero) {
+        for (int i = 0; i < (int)coeff.size(); ++i) {
+          statistics.predicted_coordinate += coeff[i]*pow(insert_time, i);
+        }
+        statistics.poly_reg_computed = true;
+      }
+
+      statistics.confidence_interval = formerConfidenceInterval(statistics, predicted_vals_past, time, values, weight_vect);
+      conf_interval_bool = (statistics.confidence_interval == -1.0) ? false : true;
+    }
+
+    if (!statistics.poly_reg_computed) {
+      statistics.predicted_coordinate = statistics.mean_dependent;
+    }
+
+    if (!conf_interval_bool) {
+      statistics.confidence_interval = (std < max_pix_shift) ? max_pix_shift : std*2;
+    }
+
+    statistics.extended_search = true;
+    return statistics;
+  }
+  //}
+
+  uvdar::loadedParamsForOMTA omtaParams(int poly_order) {
+    uvdar::loadedParamsForOMTA params;
+    params.max_px_shift = cv::Point(max_pix_shift, max_pix_shift);
+    params.max_zeros_consecutive = 4;
+    params.max_ones_consecutive = 4;
+    params.stored_seq_len_factor = 3;
+    params.max_buffer_length = 100;
+    params.poly_order = poly_order;
+    params.decay_factor = decay_factor;
+    params.conf_probab_percent = conf_probab_percent;
+    params.allowed_BER_per_seq = 0;
+    params.std_threshold_poly_reg = 0.0;
+    return params;
+  }
+
+  /**
+   * @brief A point moving along a smooth curve with noise in its detected position
+   */
+  cv::Point2d trajectoryPoint(int frame, std::mt19937& rng) {
+    std::normal_distribution<double> noise(0.0, 0.5);
+    double s = frame * frame_period;
+    return cv::Point2d(300.0 + (40.0 * s) + (25.0 * std::sin(3.0 * s)) + noise(rng), 200.0 - (15.0 * s) + (10.0 * s * s) + noise(rng));
+  }
+}
+
+//a blinking point is added to sequences of different lengths frame by frame, and the statistics for the next frames are compared after each point - from the single first point, over the interpolated ones with no more points than the order, to the full sequences dropping their oldest points
+TEST_P(OMTAStatisticsTest, SameAsFormerRegression) {
+  int order = GetParam();
+  uvdar::OMTA omta(omtaParams(order));
+  for (int capacity : {order + 2, 15, 40}) {
+    std::mt19937 rng(order * 100 + capacity);
+    uvdar::Sequence sequence(capacity, decay_factor, order);
+    PredictionStatistics statistics;
+    for (int f = 0; f < capacity * 6; f++) {
+      double time = start_time + (f * frame_period);
+      bool on = ((rng() % 4) != 0);
+      sequence.push(trajectoryPoint(f, rng), time, on);
+      if (sequence.fit().size() == 0) {
+        continue;
+      }
+
+      std::vector<double> x, y, times;
+      for (int i = 0; i < sequence.size(); i++) {
+        if (sequence.ledState(i)) {
+          x.push_back(sequence.x(i));
+          y.push_back(sequence.y(i));
+          times.push_back(sequence.time(i));
+        }
+      }
+
+      for (int frames_ahead : {1, 3}) {
+        double insert_time = time + (frames_ahead * frame_period);
+        for (int axis = 0; axis < 2; axis++) {
+          std::string description = "capacity " + std::to_string(capacity) + ", frame " + std::to_string(f) + ", " + std::to_string(x.size()) + " points, axis " + std::to_string(axis) + ", " + std::to_string(frames_ahead) + " frames ahead";
+          PredictionStatistics former = formerSelectStatisticsValues((axis == 0) ? x : y, times, insert_time, order);
+          selectStatisticsValues(omta, sequence, axis, insert_time, max_pix_shift, statistics);
+
+          EXPECT_EQ(statistics.poly_reg_computed, former.poly_reg_computed) << description;
+          EXPECT_NEAR(statistics.confidence_interval, former.confidence_interval, 1e-6 * (1.0 + std::abs(former.confidence_interval))) << description;
+          //with no more points than the order, the former regression solved an underdetermined system and picked an arbitrary one of the interpolating polynomials, while the current one interpolates by the lowest order - the predictions differ, but the confidence interval falls back to the deviation in both
+          if ((int)(x.size()) > order) {
+            EXPECT_NEAR(statistics.predicted_coordinate, former.predicted_coordinate, 1e-6 * (1.0 + std::abs(former.predicted_coordinate))) << description;
+          }
+        }
+      }
+    }
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(Orders, OMTAStatisticsTest, testing::Range(0, uvdar::SlidingPolyFit::max_poly_order + 1), [](const testing::TestParamInfo<int>& info) {
+  return "Order" + std::to_string(info.param);
+});
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
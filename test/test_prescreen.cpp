@@ -0,0 +1,177 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "detect/uv_led_detect_fast_cpu.h"
+#include "detect/synthetic_frames.h"
+#include "test_common.h"
+
+/*
+ * Checks that the pre-screen of the CPU detector and each of the pre-scan kernels find exactly the same marker and sun points as the exhaustive scalar scan of every row
+ */
+
+namespace {
+
+  using uvdar::UVDARLedDetectFASTCPU;
+  using uvdar::test::Kernel;
+
+  using uvdar::test::threshold;
+  using uvdar::test::threshold_diff;
+  using uvdar::test::threshold_sun;
+
+  /**
+   * @brief A detector configuration compared with the exhaustive scan
+   */
+  struct Setup {
+    int threads = 1;
+    bool stripes = false; ///< with a point limit, the rows are processed in stripes, which moves the borders of the bands and the row groups
+    int mask_id = -1;
+  };
+
+  std::string describe(const Setup& setup) {
+    return "threads " + std::to_string(setup.threads) + ", stripes " + std::to_string(setup.stripes) + ", mask " + std::to_string(setup.mask_id);
+  }
+
+  /**
+   * @brief Compares the detection with the pre-screen of the given kernel with the exhaustive scalar scan on a single frame, in all the setups
+   */
+  void compareWithExhaustive(Kernel kernel, const cv::Mat& frame, const std::vector<cv::Mat>& masks, const std::vector<cv::Rect>& regions = {}) {
+    std::vector<Setup> setups;
+    for (int mask_id = -1; mask_id < (int)(masks.size()); mask_id++) {
+      for (int threads : {1, 2, 3, 5}) {
+        for (bool stripes : {false, true}) {
+          setups.push_back({threads, stripes, mask_id});
+        }
+      }
+    }
+
+    for (auto& setup : setups) {
+      UVDARLedDetectFASTCPU exhaustive(false, false, threshold, threshold_diff, threshold_sun, masks);
+      exhaustive.setPrescanKernel(Kernel::SCALAR);
+      exhaustive.setPrescreen(false);
+
+      UVDARLedDetectFASTCPU screened(false, false, threshold, threshold_diff, threshold_sun, masks);
+      screened.setPrescanKernel(kernel);
+      screened.setPrescreen(true);
+      screened.setThreadCount(setup.threads);
+      if (setup.stripes) { //a limit that is never reached
+        exhaustive.setPointLimit(100000, false);
+        screened.setPointLimit(100000, false);
+      }
+
+      std::vector<cv::Point2i> expected_points, expected_sun, points, sun;
+      if (regions.empty()) {
+        ASSERT_TRUE(exhaustive.processImage(frame, expected_points, expected_sun, setup.mask_id));
+        ASSERT_TRUE(screened.processImage(frame, points, sun, setup.mask_id));
+      } else {
+        ASSERT_TRUE(exhaustive.processImageRegions(frame, regions, expected_points, expected_sun, setup.mask_id));
+        ASSERT_TRUE(screened.processImageRegions(frame, regions, points, sun, setup.mask_id));
+      }
+      EXPECT_EQ(points, expected_points) << describe(setup);
+      EXPECT_EQ(sun, expected_sun) << describe(setup);
+    }
+  }
+
+  class PrescreenTest : public uvdar::test::KernelTest {};
+}
+
+TEST_P(PrescreenTest, RandomFrames) {
+  std::mt19937 rng(1);
+  std::vector<cv::Size> sizes = {cv::Size(752, 480), cv::Size(640, 483), cv::Size(97, 61), cv::Size(33, 17), cv::Size(13, 9)};
+  for (auto& size : sizes) {
+    std::vector<cv::Mat> masks = {uvdar::synthetic::mask(size, 0.1, false, rng), uvdar::synthetic::mask(size, 0.0, true, rng)};
+    for (int f = 0; f < 4; f++) {
+      cv::Mat frame = uvdar::synthetic::background(size, 10, 30, rng);
+      std::uniform_int_distribution<int> x(-3, size.width + 2);
+      std::uniform_int_distribution<int> y(-3, size.height + 2);
+      int markers = (int)(size.area() / 2000) + 3;
+      for (int m = 0; m < markers; m++) {
+        uvdar::synthetic::drawMarker(frame, cv::Point(x(rng), y(rng)), 110 + (int)(rng() % 146), (int)(rng() % 4));
+      }
+      if ((f % 2) == 1) {
+        uvdar::synthetic::drawSun(frame, cv::Point(x(rng), y(rng)), 3 + (int)(rng() % 30));
+      }
+      SCOPED_TRACE(std::to_string(size.width) + "x" + std::to_string(size.height) + ", frame " + std::to_string(f));
+      compareWithExhaustive(GetParam(), frame, masks);
+    }
+  }
+}
+
+//markers on the first and the last rows of the groups of pre-screened rows, on the borders of the bands and on the borders of the image
+TEST_P(PrescreenTest, GroupAndBandEdges) {
+  std::mt19937 rng(2);
+  for (int height : {480, 483, 61}) {
+    cv::Size size(752, height);
+    cv::Mat frame = uvdar::synthetic::background(size, 10, 20, rng);
+    int column = 0;
+    for (int j = 0; j < height; j++) {
+      bool group_edge = ((j % 4) == 0) || ((j % 4) == 3) || (j == (height - 1));
+      bool band_edge = false;
+      for (int bands : {2, 3, 5, 8}) {
+        for (int b = 1; b < bands; b++) {
+          int edge = (height * b) / bands;
+          band_edge = band_edge || (std::abs(j - edge) <= 1);
+        }
+      }
+      if (group_edge || band_edge) {
+        uvdar::synthetic::drawMarker(frame, cv::Point(column, j), 200, 0);
+        column = (column + 9) % size.width; //far enough apart for the markers not to suppress each other
+      }
+    }
+    uvdar::synthetic::drawMarker(frame, cv::Point(size.width - 1, 0), 200, 0);
+    uvdar::synthetic::drawMarker(frame, cv::Point(0, height - 1), 200, 0);
+    uvdar::synthetic::drawMarker(frame, cv::Point(size.width - 1, height - 1), 200, 0);
+    std::vector<cv::Mat> masks = {uvdar::synthetic::mask(size, 0.05, false, rng)};
+    SCOPED_TRACE("height " + std::to_string(height));
+    compareWithExhaustive(GetParam(), frame, masks);
+  }
+}
+
+//groups of rows with more bright columns than prescreen_dense_fraction allows fall back to the pre-scan of each row
+TEST_P(PrescreenTest, DenseGroups) {
+  std::mt19937 rng(3);
+  cv::Size size(752, 480);
+  cv::Mat frame = uvdar::synthetic::background(size, 10, 20, rng);
+  std::uniform_int_distribution<int> bright(threshold + 1, 255);
+  for (int j = 200; j < 206; j++) { //starts and ends inside of row groups
+    for (int i = 0; i < size.width; i++) {
+      if ((rng() % 3) == 0) {
+        frame.data[(j * size.width) + i] = (unsigned char)(bright(rng));
+      }
+    }
+  }
+  for (int i = 0; i < size.width; i += 7) { //a single row of many isolated markers
+    uvdar::synthetic::drawMarker(frame, cv::Point(i, 301), 180, 0);
+  }
+  for (int m = 0; m < 20; m++) {
+    uvdar::synthetic::drawMarker(frame, cv::Point((int)(rng() % size.width), 190 + (int)(rng() % 30)), 200, 1);
+  }
+  uvdar::synthetic::drawSun(frame, cv::Point(400, 100), 40); //a sun makes the pooled rows bright over its whole width
+  std::vector<cv::Mat> masks = {uvdar::synthetic::mask(size, 0.0, true, rng)};
+  compareWithExhaustive(GetParam(), frame, masks);
+}
+
+//in processImageRegions, the pre-screen is used for the search for the sun outside of the regions
+TEST_P(PrescreenTest, Regions) {
+  std::mt19937 rng(4);
+  cv::Size size(752, 480);
+  cv::Mat frame = uvdar::synthetic::background(size, 10, 20, rng);
+  std::vector<cv::Rect> regions;
+  for (int m = 0; m < 15; m++) {
+    cv::Point center((int)(rng() % size.width), (int)(rng() % size.height));
+    uvdar::synthetic::drawMarker(frame, center, 200, (int)(rng() % 3));
+    regions.push_back(cv::Rect(center.x - 30, center.y - 30, 61, 61));
+  }
+  uvdar::synthetic::drawSun(frame, cv::Point(150, 300), 25);
+  uvdar::synthetic::drawSun(frame, cv::Point(600, 2), 10);
+  std::vector<cv::Mat> masks = {uvdar::synthetic::mask(size, 0.1, false, rng)};
+  compareWithExhaustive(GetParam(), frame, masks, regions);
+}
+
+INSTANTIATE_TEST_SUITE_P(Kernels, PrescreenTest, uvdar::test::allKernels(), uvdar::test::kernelName);
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
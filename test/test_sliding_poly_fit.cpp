@@ -0,0 +1,242 @@
+#include <gtest/gtest.h>
+#include <Eigen/Dense>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "omta/extended_search.h"
+#include "omta/sequence.h"
+
+/*
+ * Checks the incrementally updated regression of the OMTA sequences (SlidingPolyFit) against a weighted least-squares fit computed from scratch by a QR decomposition in extended precision, for all the supported orders - while the window fills up, while the points leave it, when the Sequence rebuilds the sums, and with no more points than the order
+ */
+
+namespace {
+
+  using uvdar::SlidingPolyFit;
+  using LongMatrix = Eigen::Matrix<long double, Eigen::Dynamic, Eigen::Dynamic>;
+  using LongVector = Eigen::Matrix<long double, Eigen::Dynamic, 1>;
+
+  constexpr double frame_period = 1.0 / 60.0;
+  constexpr double horizon = 0.1;          //the predictions are checked up to this far after the newest point
+  constexpr double base_time = 1.7e9;      //epoch time stamps, as received from ROS
+  constexpr double tolerance = 1e-3;       //the predictions may differ by the effect of moving the points by this many pixels, or by this many pixels if that is more
+
+  struct Sample {
+    double t;
+    double x;
+    double y;
+  };
+
+  /**
+   * @brief The reference fit - the coefficients in powers of the time since the newest point, and the weighted sum of the squared residuals normalized like SlidingPolyFit::weightedSSR
+   */
+  struct Reference {
+    LongVector coeff;
+    LongMatrix influence; ///< the change of the coefficients by a unit change of the coordinate of each point
+    long double w_ssr;
+  };
+
+  /**
+   * @brief Minimizes the sum of the squared residuals weighted by the squares of exp(-decay*age) by a QR decomposition of the weighted design matrix. With no more points than the order, the interpolating polynomial of a lower order is used, as by SlidingPolyFit
+   */
+  Reference referenceFit(const std::vector<Sample>& window, double decay, int order, int axis) {
+    int n = (int)(window.size());
+    int fitted_order = std::min(order, n - 1);
+    long double t_newest = window.back().t;
+
+    LongMatrix design(n, fitted_order + 1);
+    LongVector values(n);
+    std::vector<long double> weights(n);
+    for (int i = 0; i < n; i++) {
+      long double s = (long double)(window[i].t) - t_newest;
+      weights[i] = std::exp((long double)(decay) * s);
+      long double power = 1.0L;
+      for (int k = 0; k <= fitted_order; k++) {
+        design(i, k) = weights[i] * power;
+        power *= s;
+      }
+      values(i) = weights[i] * (long double)((axis == 0) ? window[i].x : window[i].y);
+    }
+
+    Reference result;
+    auto qr = design.colPivHouseholderQr();
+    result.coeff = LongVector::Zero(order + 1);
+    result.coeff.head(fitted_order + 1) = qr.solve(values);
+    result.influence = LongMatrix::Zero(order + 1, n);
+    result.influence.topRows(fitted_order + 1) = qr.solve(LongMatrix(LongVector(Eigen::Map<LongVector>(weights.data(), n)).asDiagonal()));
+
+    long double ssr = 0.0L, weight_sum = 0.0L;
+    for (int i = 0; i < n; i++) {
+      long double s = (long double)(window[i].t) - t_newest;
+      long double predicted = 0.0L;
+      for (int k = order; k >= 0; k--) {
+        predicted = (predicted * s) + result.coeff(k);
+      }
+      long double residual = (long double)((axis == 0) ? window[i].x : window[i].y) - predicted;
+      ssr += weights[i] * residual * residual;
+      weight_sum += weights[i];
+    }
+    result.w_ssr = ssr / weight_sum;
+    return result;
+  }
+
+  /**
+   * @brief Compares the fit of both coordinates with the reference on the given window of points
+   */
+  void expectMatchesReference(const SlidingPolyFit& fit, const std::vector<Sample>& window, double decay, int order, const std::string& description) {
+    ASSERT_EQ(fit.size(), (int)(window.size())) << description;
+    double t_newest = window.back().t;
+    for (int axis = 0; axis < 2; axis++) {
+      SlidingPolyFit::Vector coeff;
+      fit.fit(axis, order, coeff);
+      std::vector<double> coeff_local;
+      fit.shiftCoefficients(coeff, t_newest, coeff_local);
+      Reference reference = referenceFit(window, decay, order, axis);
+      ASSERT_EQ(coeff_local.size(), (size_t)(order + 1)) << description;
+
+      //the predictions are compared instead of the coefficients - the higher coefficients of a nearly degenerate fit are poorly determined, but so is their effect on the prediction
+      for (double s : {-horizon, 0.0, 0.5 * horizon, horizon}) {
+        long double expected = 0.0L;
+        double predicted = 0.0;
+        LongVector gains = LongVector::Zero(window.size()); //the change of the prediction by a unit change of the coordinate of each point
+        for (int k = order; k >= 0; k--) {
+          expected = (expected * s) + reference.coeff(k);
+          predicted = (predicted * s) + coeff_local[k];
+          gains = (gains * s) + reference.influence.row(k).transpose();
+        }
+        EXPECT_NEAR(predicted, (double)(expected), tolerance * (1.0 + (double)(gains.norm()))) << description << ", axis " << axis << ", " << s << " s after the newest point";
+      }
+      for (int k = std::min(order, (int)(window.size()) - 1) + 1; k <= order; k++) {
+        EXPECT_EQ(coeff(k), 0.0) << description << ", axis " << axis << ", coefficient " << k << " is above the interpolated order";
+      }
+      //the sum is expanded into the sums kept by the fit, which cancel against the squares of the coordinates - the residuals have to match to about a hundredth of a pixel
+      EXPECT_NEAR(fit.weightedSSR(axis, coeff), (double)(reference.w_ssr), 1e-4 + (1e-6 * (double)(reference.w_ssr))) << description << ", axis " << axis;
+    }
+  }
+
+  /**
+   * @brief A point moving along a smooth curve with noise in its detected position
+   */
+  Sample trajectoryPoint(int frame, std::mt19937& rng) {
+    std::normal_distribution<double> noise(0.0, 0.5);
+    double t = base_time + (frame * frame_period);
+    double s = frame * frame_period;
+    return {t, 300.0 + (40.0 * s) + (25.0 * std::sin(3.0 * s)) + noise(rng), 200.0 - (15.0 * s) + (10.0 * s * s) + noise(rng)};
+  }
+
+  class SlidingPolyFitTest : public testing::TestWithParam<int> {};
+}
+
+//the points are added one by one, starting with fewer points than the order, which are interpolated by a polynomial of a lower order
+TEST_P(SlidingPolyFitTest, GrowingWindow) {
+  int order = GetParam();
+  for (double decay : {0.0, 0.1, 0.5}) {
+    std::mt19937 rng(order);
+    SlidingPolyFit fit(decay, order);
+    std::vector<Sample> window;
+    for (int f = 0; f < 60; f++) {
+      Sample sample = trajectoryPoint(f, rng);
+      fit.add(sample.t, sample.x, sample.y);
+      window.push_back(sample);
+      expectMatchesReference(fit, window, decay, order, "decay " + std::to_string(decay) + ", " + std::to_string(window.size()) + " points");
+    }
+  }
+}
+
+//a window of a fixed length slides over the trajectory, with the oldest point removed for each new one and some points missing, as with a blinking LED. The removals are exact only as long as the origin of the times stays close to the window, so the fit is rebuilt after every length removals, as by the Sequence
+TEST_P(SlidingPolyFitTest, SlidingWindow) {
+  int order = GetParam();
+  for (int length : {1, order, order + 1, 20}) {
+    if (length < 1) {
+      continue;
+    }
+    std::mt19937 rng(10 + order);
+    double decay = 0.1;
+    SlidingPolyFit fit(decay, order);
+    std::vector<Sample> window;
+    int removals = 0;
+    for (int f = 0; f < 300; f++) {
+      if ((rng() % 3) == 0) { //the LED is off
+        continue;
+      }
+      Sample sample = trajectoryPoint(f, rng);
+      fit.add(sample.t, sample.x, sample.y);
+      window.push_back(sample);
+      if ((int)(window.size()) > length) {
+        fit.remove(window.front().t, window.front().x, window.front().y);
+        window.erase(window.begin());
+        removals++;
+      }
+      expectMatchesReference(fit, window, decay, order, "length " + std::to_string(length) + ", frame " + std::to_string(f));
+      if (removals >= length) {
+        fit.clear();
+        for (auto& point : window) {
+          fit.add(point.t, point.x, point.y);
+        }
+        removals = 0;
+      }
+    }
+  }
+}
+
+//after every point has left the window, the fit starts anew
+TEST_P(SlidingPolyFitTest, EmptiedWindow) {
+  int order = GetParam();
+  std::mt19937 rng(20 + order);
+  SlidingPolyFit fit(0.1, order);
+  std::vector<Sample> window;
+  for (int f = 0; f < 10; f++) {
+    Sample sample = trajectoryPoint(f, rng);
+    fit.add(sample.t, sample.x, sample.y);
+    window.push_back(sample);
+  }
+  for (auto& sample : window) {
+    fit.remove(sample.t, sample.x, sample.y);
+  }
+  EXPECT_EQ(fit.size(), 0);
+  window.clear();
+  for (int f = 100; f < 110; f++) {
+    Sample sample = trajectoryPoint(f, rng);
+    fit.add(sample.t, sample.x, sample.y);
+    window.push_back(sample);
+    expectMatchesReference(fit, window, 0.1, order, std::to_string(window.size()) + " points after emptying");
+  }
+}
+
+//the Sequence removes the points overwritten in its ring buffer from the fit and rebuilds the sums after every capacity removals - the fit has to match the "on"-points in the buffer before and after each rebuild
+TEST_P(SlidingPolyFitTest, SequenceRebuilds) {
+  int order = GetParam();
+  double decay = 0.1;
+  for (int capacity : {order + 1, 15, 40}) {
+    std::mt19937 rng(30 + order);
+    uvdar::Sequence sequence(capacity, decay, order);
+    for (int f = 0; f < (capacity * 20) + 7; f++) {
+      Sample sample = trajectoryPoint(f, rng);
+      bool on = ((rng() % 4) != 0);
+      sequence.push(cv::Point2d(sample.x, sample.y), sample.t, on);
+
+      std::vector<Sample> window;
+      for (int i = 0; i < sequence.size(); i++) {
+        if (sequence.ledState(i)) {
+          window.push_back({sequence.time(i), sequence.x(i), sequence.y(i)});
+        }
+      }
+      if (window.empty()) {
+        EXPECT_EQ(sequence.fit().size(), 0);
+        continue;
+      }
+      expectMatchesReference(sequence.fit(), window, decay, order, "capacity " + std::to_string(capacity) + ", frame " + std::to_string(f));
+    }
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(Orders, SlidingPolyFitTest, testing::Range(0, SlidingPolyFit::max_poly_order + 1), [](const testing::TestParamInfo<int>& info) {
+  return "Order" + std::to_string(info.param);
+});
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,173 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "detect/uv_led_detect_fast_cpu.h"
+#include "detect/synthetic_frames.h"
+#include "test_common.h"
+
+/*
+ * Checks the temporal mode of the CPU detector on sequences of synthetic frames - static bright objects are left out once their history fills up, while blinking and moving markers are still retrieved
+ */
+
+namespace {
+
+  using uvdar::UVDARLedDetectFASTCPU;
+
+  using uvdar::test::threshold;
+  using uvdar::test::threshold_diff;
+  using uvdar::test::threshold_sun;
+  constexpr int background     = 10;
+  constexpr int brightness     = 200; //of the markers and the lamps
+  constexpr int min_change     = 50;
+
+  bool contains(const std::vector<cv::Point2i>& points, cv::Point2i point) {
+    return std::find(points.begin(), points.end(), point) != points.end();
+  }
+
+  class TemporalTest : public uvdar::test::KernelTest {
+    protected:
+      /**
+       * @brief A temporal detector using the kernel under test for the history
+       */
+      std::unique_ptr<UVDARLedDetectFASTCPU> makeDetector(int decay) {
+        auto detector = std::make_unique<UVDARLedDetectFASTCPU>(false, false, threshold, threshold_diff, threshold_sun, std::vector<cv::Mat>());
+        detector->setPrescanKernel(GetParam());
+        EXPECT_TRUE(detector->setTemporalMode(true, decay, min_change));
+        return detector;
+      }
+
+      static cv::Mat emptyFrame() {
+        cv::Mat frame(cv::Size(752, 480), CV_8UC1);
+        frame = cv::Scalar(background);
+        return frame;
+      }
+  };
+}
+
+//the darkest value of a static lamp rises by the decay with each image, starting from zero - the lamp is retrieved while its brightness minus that value is at least min_change
+TEST_P(TemporalTest, StaticLampDecays) {
+  for (int decay : {4, 8, 30}) {
+    auto detector = makeDetector(decay);
+    cv::Point2i lamp(300, 200);
+    cv::Mat frame = emptyFrame();
+    uvdar::synthetic::drawMarker(frame, lamp, brightness, 0);
+
+    int last_reported = (brightness - min_change) / decay;
+    for (int f = 0; f < last_reported + 10; f++) {
+      std::vector<cv::Point2i> points, sun;
+      ASSERT_TRUE(detector->processImage(frame, points, sun));
+      EXPECT_EQ(contains(points, lamp), f <= last_reported) << "decay " << decay << ", frame " << f;
+      EXPECT_LE(points.size(), 1u);
+    }
+  }
+}
+
+//once the history fills up, only the blinking marker is retrieved - in every image it is lit in, and never at the place of the lamps
+TEST_P(TemporalTest, BlinkingMarkerAmongLamps) {
+  auto detector = makeDetector(8);
+  std::vector<cv::Point2i> lamps = {{100, 100}, {400, 50}, {700, 400}};
+  cv::Point2i marker(250, 300);
+  int warmup = 40;
+
+  for (int half_period : {1, 3, 5}) {
+    for (int f = 0; f < warmup + 60; f++) {
+      cv::Mat frame = emptyFrame();
+      for (auto& lamp : lamps) {
+        uvdar::synthetic::drawMarker(frame, lamp, brightness, (lamp.x == 400) ? 1 : 0);
+      }
+      bool lit = ((f / half_period) % 2) == 0;
+      if (lit) {
+        uvdar::synthetic::drawMarker(frame, marker, brightness, 0);
+      }
+
+      std::vector<cv::Point2i> points, sun;
+      ASSERT_TRUE(detector->processImage(frame, points, sun));
+      if (f < warmup) {
+        continue;
+      }
+      EXPECT_EQ(contains(points, marker), lit) << "half period " << half_period << ", frame " << f;
+      EXPECT_EQ(points.size(), lit ? 1u : 0u) << "half period " << half_period << ", frame " << f;
+    }
+  }
+}
+
+//a marker moving by a pixel every few images lights pixels that were dark shortly before, so it is retrieved in every image. Once it stops, it decays like a lamp
+TEST_P(TemporalTest, SlowMovingMarker) {
+  int decay = 8;
+  auto detector = makeDetector(decay);
+  int frames_per_pixel = 4;
+  int moving_frames = 120;
+  int last_reported = ((brightness - background - min_change) / decay) - 1; //the dark value of the pixel it stopped on rises from the background, already in the image it arrived in
+
+  cv::Point2i marker(200, 240);
+  for (int f = 0; f < moving_frames + last_reported + 10; f++) {
+    if ((f > 0) && (f <= moving_frames) && ((f % frames_per_pixel) == 0)) {
+      marker.x++;
+      if ((f % (2 * frames_per_pixel)) == 0) {
+        marker.y++;
+      }
+    }
+    cv::Mat frame = emptyFrame();
+    uvdar::synthetic::drawMarker(frame, marker, brightness, 0);
+
+    std::vector<cv::Point2i> points, sun;
+    ASSERT_TRUE(detector->processImage(frame, points, sun));
+    int stopped_for = f - (moving_frames - (moving_frames % frames_per_pixel)); //images since the last step
+    bool expected = (f <= moving_frames) || (stopped_for <= last_reported);
+    EXPECT_EQ(contains(points, marker), expected) << "frame " << f;
+  }
+}
+
+//the sun is retrieved in every image even though it does not change, so the glare filtering keeps working - the same sun as in the normal mode, and the blinking marker in its glare is discarded the same way
+TEST_P(TemporalTest, StaticSunIsKept) {
+  auto detector = makeDetector(8);
+  UVDARLedDetectFASTCPU normal(false, false, threshold, threshold_diff, threshold_sun, {});
+  std::vector<cv::Point2i> markers = {{322, 200}, {300, 222}, {500, 200}}; //the first two in the glare of the sun
+  for (int f = 0; f < 60; f++) {
+    cv::Mat frame = emptyFrame();
+    uvdar::synthetic::drawSun(frame, cv::Point(300, 200), 15);
+    bool lit = ((f % 2) == 0);
+    if (lit) {
+      for (auto& marker : markers) {
+        uvdar::synthetic::drawMarker(frame, marker, 255, 0);
+      }
+    }
+    std::vector<cv::Point2i> points, sun, normal_points, normal_sun;
+    ASSERT_TRUE(detector->processImage(frame, points, sun));
+    ASSERT_TRUE(normal.processImage(frame, normal_points, normal_sun));
+    EXPECT_FALSE(sun.empty()) << "frame " << f;
+    EXPECT_EQ(sun, normal_sun) << "frame " << f;
+    EXPECT_EQ(points, normal_points) << "frame " << f;
+    EXPECT_EQ(points, lit ? std::vector<cv::Point2i>{markers[2]} : std::vector<cv::Point2i>()) << "frame " << f;
+  }
+}
+
+//with the temporal mode disabled again, the lamps are retrieved as usual
+TEST_P(TemporalTest, Disabling) {
+  auto detector = makeDetector(8);
+  cv::Point2i lamp(300, 200);
+  cv::Mat frame = emptyFrame();
+  uvdar::synthetic::drawMarker(frame, lamp, brightness, 0);
+  std::vector<cv::Point2i> points, sun;
+  for (int f = 0; f < 40; f++) {
+    points.clear();
+    ASSERT_TRUE(detector->processImage(frame, points, sun));
+  }
+  EXPECT_FALSE(contains(points, lamp));
+
+  detector->setTemporalMode(false, 8, min_change);
+  points.clear();
+  ASSERT_TRUE(detector->processImage(frame, points, sun));
+  EXPECT_TRUE(contains(points, lamp));
+}
+
+INSTANTIATE_TEST_SUITE_P(Kernels, TemporalTest, uvdar::test::allKernels(), uvdar::test::kernelName);
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}